@@ -117,6 +117,25 @@ typedef void (*ensemblename_t)(std::string label, std::string abbr, int32_t, voi
 //	ensemble's id
 typedef void (*ensembleid_t)(int32_t, void *);
 //
+//	Changes in the database of the ensemble - as learned from the
+//	FIC - are reported once, numbered with the generation of the
+//	database they lead to. The generation increases with each change,
+//	so a consumer that missed nothing knows it is up to date.
+//	The reports are sent at the end of the FIC of a frame, after
+//	the change became visible to the queries
+enum dabChangeKind {
+  DAB_CHANGE_CLEARED = 1,  // id: 0, the database was emptied
+  DAB_CHANGE_ENSEMBLE,     // id: EId, the ensemble label
+  DAB_CHANGE_SERVICE,      // id: SId, new label or program type
+  DAB_CHANGE_COMPONENT,    // id: SId, component added or changed
+  DAB_CHANGE_SUBCHANNEL,   // id: SubChId, (re)configured subchannel
+  DAB_CHANGE_LINKAGE,      // id: LSN, linkage set (FIG 0/6)
+  DAB_CHANGE_FREQUENCY,    // id: EId (or PI), frequency list (FIG 0/21)
+  DAB_CHANGE_OE_SERVICE    // id: SId, ensembles with the service (FIG 0/24)
+};
+typedef void (*ensembleChange_t)(uint32_t generation, int16_t kind,
+                                 int32_t id, void *);
+//
 //	Each programname in the ensemble is sent once
 typedef void (*programname_t)(std::string label, std::string abbr, int32_t, void *);
 //
@@ -180,12 +199,154 @@ typedef void (*tii_ex_t)(int numOut, int *outTii, float *outAvgSNR,
 //	allows processing of FIB FIG/extensions, which are not parsed
 typedef void (*fibdata_t)(const uint8_t *fib, int crc_ok, void *);
 
+//	When decoding more than a single service, each service (i.e. its
+//	subchannel) may be given its own set of output handlers, together
+//	with its own context, that is passed as last parameter to these
+//	handlers - instead of the userData passed to dabInit.
+//	A NULL handler means that the output is not needed, for the
+//	errorReport_Handler NULL means: the one set with
+//	dab_setError_handler if ctx is the userData passed to dabInit.
+typedef struct {
+  audioOut_t audioOut_Handler;
+  dataOut_t dataOut_Handler;
+  bytesOut_t bytesOut_Handler;
+  programQuality_t programQuality_Handler;
+  motdata_t motdata_Handler;
+  decodeErrorReport_t errorReport_Handler;
+  void *ctx;
+} serviceSink;
+
+//	dab_decodeAll calls the sinkFactory for each (sub)service in the
+//	ensemble, with either the audiodata or the packetdata filled in
+//	(the other one is NULL). If the factory returns true, it has
+//	filled in the sink and the (sub)service will be decoded.
+typedef bool (*sinkFactory_t)(int32_t SId, const audiodata *,
+                              const packetdata *, serviceSink *, void *);
+
+//	The state of a channel watched by the ensemble monitor, as
+//	aggregated over the visits. The TII is that of the strongest
+//	transmitter seen on the last visit (Mode I only), -1 if none
+typedef struct {
+  char channel[8];
+  int32_t frequency;  // in Hz
+  int32_t visits;
+  int32_t syncedVisits;
+  int32_t secondsSinceSync;  // -1: never synced
+  bool ensembleFound;
+  int32_t EId;
+  char ensembleName[32];
+  uint32_t generation;  // of the database of the ensemble
+  int16_t nrServices;
+  int32_t SId[64];
+  float offset;  // frequency offset (Hz) found on the last visit
+  int16_t snr;
+  int16_t tiiMainId;
+  int16_t tiiSubId;
+} monitorState;
+
+//	called by the monitor after each visit of a channel
+typedef void (*monitorReport_t)(const monitorState *, void *);
+
+//	The thresholds of the AF follower. The reception is bad if,
+//	for badTime msec, the quality of the service is below minQuality
+//	or the SNR below minSnr, or if there is no sync at all. The
+//	quality is the lowest of the values passed to the programQuality
+//	handler; the RS and AAC values are 0 for MP2 services and for
+//	DAB+ until measured, a 0 there is not taken into account.
+//	The candidates are probed at most once per probeInterval msec,
+//	each for probeFrames frames after getting in sync within
+//	syncTime msec, one is kept if its SNR is at least snrMargin dB
+//	better.
+//	The defaults are 60, 8, 1000, 10000, 1000, 10 and 3.
+typedef struct {
+  int16_t minQuality;
+  int16_t minSnr;
+  int32_t badTime;
+  int32_t probeInterval;
+  int32_t syncTime;
+  int16_t probeFrames;
+  int16_t snrMargin;
+} followParams;
+
+//	called by the follower when the service moved, with the
+//	new frequency (Hz) and the SId (another one for a linked service)
+typedef void (*followReport_t)(int32_t frequency, int32_t SId, int16_t snr,
+                               void *);
+
+//	What the library learned of the frequency error of the device.
+//	The offset at a frequency f (in Hz) is ppm * f / 1000000, drift
+//	is the change of ppm per minute (e.g. when warming up).
+typedef struct {
+  bool valid;
+  float ppm;
+  float drift;
+  int32_t updates;  // the number of measurements it is based on
+} afcState;
+
+//	The result of scanning a single channel with dab_scanBand.
+//	All channels of the band are reported, signalPresent tells
+//	whether the channel passed the quick test on the presence of
+//	null symbols, only then the ensemble is looked for.
+typedef struct {
+  char channel[8];
+  int32_t frequency;  // in Hz
+  bool signalPresent;
+  float nullDepth;  // in dB, signal level relative to the deepest dip
+  bool ensembleFound;
+  int32_t EId;
+  char ensembleName[32];
+  int16_t nrServices;
+  int32_t SId[64];
+} scanResult;
+
+//	The handle is that of the library instance used for the scan,
+//	during the call it can be used to query the ensemble, e.g.
+//	with dab_getserviceName
+typedef void (*scanResult_t)(const scanResult *, void *handle, void *ctx);
+
+////////////////////////////// E V E N T S ///////////////////////////////
+//
+//	As an alternative to callbacks - which are executed in the
+//	threads of the library - the results can be queued as events,
+//	to be picked up by the application in its own thread.
+//	Payloads (PCM, labels, bytes, ...) are passed as a reference
+//	counted buffer, the buffer is owned by the receiver of the event,
+//	who should release it with dab_releaseBuffer.
+typedef struct dabBuffer dabBuffer;
+
+enum dabEventType {
+  DAB_EVENT_SYNC = 1,        // value [0]: sync ok
+  DAB_EVENT_SYSTEMDATA,      // value [0 .. 2]: sync, snr, freq offset
+  DAB_EVENT_FIB_QUALITY,     // value [0]: percentage
+  DAB_EVENT_ENSEMBLE_NAME,   // value [0]: EId, data: label \0 abbr \0
+  DAB_EVENT_PROGRAM_NAME,    // value [0]: SId, data: label \0 abbr \0
+  DAB_EVENT_AUDIO,           // value [0 .. 2]: size, rate, stereo
+  DAB_EVENT_DYNAMIC_LABEL,   // data: the label
+  DAB_EVENT_BYTES,           // value [0 .. 1]: length, type
+  DAB_EVENT_PROGRAM_DATA,    // data: audiodata
+  DAB_EVENT_PROGRAM_QUALITY, // value [0 .. 2]: as programQuality_t
+  DAB_EVENT_MOT,             // value [0]: contentsubType, data: filename
+  DAB_EVENT_ERROR,           // value [0 .. 2]: as decodeErrorReport_t
+  DAB_EVENT_FIB,             // value [0]: crc_ok, data: the 32 bytes
+  DAB_EVENT_CHANGE           // value [0 .. 2]: as ensembleChange_t
+};
+
+typedef struct {
+  int16_t type;      // a dabEventType
+  void *tag;         // the tag, given with dab_eventSink/dabInit_events
+  int32_t value[4];  // event specific
+  dabBuffer *buffer; // NULL if the event has no payload
+  const void *data;  // the contents of the buffer
+  int32_t length;    // in bytes
+} dabEvent;
+
 /////////////////////////////////////////////////////////////////////////
 //
 //	The API functions
 extern "C" {
 //	dabInit is called first, with a valid deviceHandler and a valid
-//	Mode.
+//	Mode. Mode 0 means that the mode is detected from the signal,
+//	dab_getMode tells the mode in use.
 //	The parameters "spectrumBuffer" and "iqBuffer" will contain
 //	-- if no NULL parameters are passed -- data to compute a
 //	spectrumbuffer	and a constellation diagram.
@@ -201,6 +362,15 @@ void *dabInit(
     programdata_t programdataHandler, programQuality_t program_qualityHandler,
     motdata_t motdata_Handler, RingBuffer<std::complex<float>> *spectrumBuffer,
     RingBuffer<std::complex<float>> *iqBuffer, void *userData);
+//
+//	dabInit_events is as dabInit, however, all results - including
+//	the error reports, the changes in the ensemble and, if withFIBs
+//	is set, the FIBs - are delivered as events (with the given tag)
+//	in the queue
+void *dabInit_events(deviceHandler *, uint8_t Mode, void *queue, void *tag,
+                     bool withFIBs,
+                     RingBuffer<std::complex<float>> *spectrumBuffer,
+                     RingBuffer<std::complex<float>> *iqBuffer);
 
 //	dabExit cleans up the library on termination
 void dabExit(void *);
@@ -210,11 +380,19 @@ void dabExit(void *);
 void dabStartProcessing(void *);
 //
 //	dabReset is as the name suggests for resetting the state of the library
+//	(the ensemble information and the active services), synchronization
+//	starts all over again.
 void dabReset(void *);
 //
 //	dabStop will stop operation of the functions in the library
 void dabStop(void *);
 //
+//	dabRetune switches the device to another frequency, with the
+//	library remaining active: the device buffers are flushed, and
+//	the state is reset as with dabReset.
+//	Returns the result of restarting the device.
+bool dabRetune(void *, int32_t frequency);
+//
 //	dabReset_msc will terminate the operation of active audio and/or data
 //	handlers (there may be more than one active!).
 //	If selecting a service (or services),
@@ -223,6 +401,14 @@ void dabStop(void *);
 //	the requested services
 void dabReset_msc(void *);
 //
+//	dab_setInstantSwitch (default off) makes the library keep
+//	track of the validity of the last 16 CIFs it received.
+//	A service selected after dabReset_msc is then deinterleaved
+//	from this history and the first frame is decoded with the next
+//	CIF, rather than after 15 CIFs (some 360 msec).
+//	Intended for frontends where the user zaps a lot.
+void dab_setInstantSwitch(void *, bool);
+//
 //	is_audioService will return true id the main service with the
 //	name is an audioservice
 bool is_audioService(void *, const char *);
@@ -269,6 +455,153 @@ void set_audioChannel(void *, audiodata *);
 //	to the list of active handlers
 void set_dataChannel(void *, packetdata *);
 //
+//	set_audioChannel_sink and set_dataChannel_sink are as
+//	set_audioChannel and set_dataChannel, however, the output of
+//	the service is sent to the handlers of the sink, rather than to
+//	the handlers passed to dabInit.
+//	They return a handle (> 0) for use with dab_removeChannel
+int set_audioChannel_sink(void *, audiodata *, const serviceSink *);
+int set_dataChannel_sink(void *, packetdata *, const serviceSink *);
+//
+//	dab_removeChannel terminates the handler with the given handle,
+//	other active handlers continue without interruption.
+//	Returns false if there is no such handler
+bool dab_removeChannel(void *, int);
+//
+//	dab_decodeAll walks over the services in the ensemble - as known
+//	at the moment of calling - and adds a handler for each (sub)service
+//	accepted by the sinkFactory. The function returns the number
+//	of handlers added.
+int dab_decodeAll(void *, sinkFactory_t, void *);
+//
+//	dab_scanBand walks over the channels of the band - BAND_III (0100)
+//	or L_BAND (0101) - using the device, which should not be in
+//	use otherwise. A channel is first checked - on a few frames
+//	of samples - for the presence of null symbols; only when found
+//	the library tries to synchronize and read the ensemble, for at most
+//	syncTime msec before an ensemble name is seen, and ensembleTime
+//	msec in total. Each channel is reported to the handler.
+//	The frequency error of the device is learned on the way; afc -
+//	if not null - gives what was known before (if valid) and gets
+//	what is known after the scan, e.g. for dab_setAFC.
+//	Returns the number of ensembles found.
+int dab_scanBand(deviceHandler *, uint8_t Mode, uint8_t band,
+                 int32_t syncTime, int32_t ensembleTime, afcState *afc,
+                 scanResult_t, void *ctx);
+//
+//	dab_setFicOnly switches FIC-only mode on or off. In FIC-only
+//	mode only the FIC is decoded - enough for monitoring and
+//	scanning - the MSC symbols are skipped and selected services
+//	are terminated. The switch takes effect at the next frame
+void dab_setFicOnly(void *, bool);
+//
+//	dab_setGuardSync selects how the start of a frame is found
+//	when (re)synchronizing: false (the default) looks for the dip
+//	of the null symbol in the envelope of the signal, true uses
+//	the correlation of the guard intervals of the symbols, which
+//	does not depend on the level of the signal and copes better
+//	with a fading signal
+void dab_setGuardSync(void *, bool);
+//
+//	dab_setCoherent selects the demodulation of the carriers:
+//	false (the default) is differential, true estimates the
+//	channel from the phase reference symbol and follows it over
+//	the frame. On the synthetic signals of dab-bench (example-10)
+//	it gains some 0.2 dB with white noise only, and some 2 dB with
+//	Rayleigh fading (10 Hz Doppler, a second path at -3 dB), the
+//	decoding then takes some 15 to 45 percent more CPU time.
+//	The switch takes effect at the next frame
+void dab_setCoherent(void *, bool);
+//
+//	dab_openCache opens - or creates - a file with what was learned
+//	of the ensembles seen before. The cache may be shared by
+//	several library instances; close it after dabExit
+void *dab_openCache(const char *fileName);
+void dab_closeCache(void *cache);
+//
+//	dab_setCache couples the cache to the library instance, the
+//	frequency is the one the device is tuned to (dabRetune keeps
+//	it up to date, and stores the ensemble left)
+void dab_setCache(void *, void *cache, int32_t frequency);
+//
+//	dab_preloadService selects the audio service with the
+//	parameters found in the cache, rather than waiting for the FIC.
+//	If the FIC contradicts the cache, the cache entry is dropped and
+//	the service is continued with the parameters from the FIC.
+//	If the ensemble is another one than cached, and its FIC does
+//	not list the service, the service is stopped (as with
+//	dab_removeChannel).
+//	With a null sink the handlers passed to dabInit are used.
+//	Returns a handle for dab_removeChannel, or -1 if the service
+//	is not in the cache
+int dab_preloadService(void *, int32_t SId, const serviceSink *);
+//
+//	dab_cacheEnsemble stores the audio services of the ensemble,
+//	as known at the moment of calling, in the cache
+bool dab_cacheEnsemble(void *);
+//
+//	dab_setFrequency tells the frequency the device is tuned to
+//	when starting, dabRetune keeps it up to date. With it, the
+//	frequency error of the device is learned and predicted for
+//	the next channel tuned to
+void dab_setFrequency(void *, int32_t frequency);
+//
+//	The ensemble monitor watches a number of channels with a
+//	single device, visiting them in turn (FIC only). Per channel
+//	the ensemble database is kept - and updated on each visit -
+//	together with the frequency offset found.
+//	dwellFrames is the number of frames per visit (in sync),
+//	syncTime (msec) the time given to get in sync.
+//	The device should not be used otherwise while monitoring.
+void *dab_createMonitor(deviceHandler *, uint8_t Mode, uint8_t band,
+                        const char *const *channels, int nrChannels,
+                        int dwellFrames, int syncTime);
+void dab_deleteMonitor(void *monitor);
+bool dab_startMonitor(void *monitor, monitorReport_t, void *ctx);
+void dab_stopMonitor(void *monitor);
+int dab_monitorChannels(void *monitor);
+bool dab_getMonitorState(void *monitor, int channel, monitorState *);
+//	the name of a service in the ensemble of the channel, false
+//	if not known
+bool dab_getMonitorServiceName(void *monitor, int channel, int32_t SId,
+                               char *name, int size);
+//
+//	dab_getAFC and dab_setAFC get and set what is learned of the
+//	frequency error, such that it can be kept between runs, or
+//	be passed to another library instance with the same device
+void dab_getAFC(void *, afcState *);
+void dab_setAFC(void *, const afcState *);
+//
+//	dab_createEventQueue creates a queue with room for poolSize
+//	pending events. Events that do not fit are dropped (and counted).
+void *dab_createEventQueue(int poolSize);
+//
+//	dab_deleteEventQueue should be called after dabExit, all
+//	buffers should be released before
+void dab_deleteEventQueue(void *queue);
+//
+//	dab_eventFd returns a file descriptor that becomes readable
+//	when events are pending (an eventfd on Linux, -1 elsewhere).
+//	After the fd became readable, read it and then call dab_nextEvent
+//	until it returns false
+int dab_eventFd(void *queue);
+//
+//	dab_nextEvent moves the oldest pending event, if any, to
+//	the caller
+bool dab_nextEvent(void *queue, dabEvent *);
+//
+//	the number of events dropped since the previous call
+int dab_droppedEvents(void *queue);
+//
+//	buffers can be shared, dab_retainBuffer adds a reference,
+//	dab_releaseBuffer removes one
+void dab_retainBuffer(dabBuffer *);
+void dab_releaseBuffer(dabBuffer *);
+//
+//	dab_eventSink fills in a serviceSink, such that the output of
+//	the (sub)service becomes events in the queue, with the given tag
+void dab_eventSink(void *queue, void *tag, serviceSink *);
+//
 //	mapping from a name to a Service identifier is done
 int32_t dab_getSId(void *, const char *);
 //
@@ -283,6 +616,52 @@ void dab_setTII_handler(void *, tii_t tii_Handler, tii_ex_t tii_ExHandler,
 //compatibility
 void dab_setEId_handler(void *, ensembleid_t EId_Handler);
 
+//	set/activate reporting of changes in the ensemble database,
+//	dab_getGeneration tells the generation the queries answer from
+void dab_setChange_handler(void *, ensembleChange_t change_Handler);
+uint32_t dab_getGeneration(void *);
+
+//	service linking and frequency information, as learned from
+//	FIG 0/6, 0/21 and 0/24. Each returns the number found, at most
+//	maxCount of them are copied.
+//	dab_getFrequencies: the frequencies (KHz) of the ensemble EId
+int dab_getFrequencies(void *, int32_t EId, int32_t *kHz, int maxCount);
+//	dab_getOtherEnsembles: the EIds of the other ensembles with SId
+int dab_getOtherEnsembles(void *, int32_t SId, int32_t *EIds, int maxCount);
+//	dab_getLinkedServices: the DAB services in an active linkage set
+//	with SId
+int dab_getLinkedServices(void *, int32_t SId, int32_t *SIds, int maxCount);
+//
+//	The AF follower selects the audio service SId - on the frequency
+//	the library instance is tuned to - and moves it to another
+//	frequency when the reception gets bad: another transmitter of
+//	the ensemble, another ensemble carrying the service or one with
+//	a linked service, as learned from the FIC. The output goes to
+//	the sink (NULL: the handlers passed to dabInit), a NULL params
+//	means the defaults. With a cache, the service is selected from
+//	it on a frequency visited for the first time.
+//	The follower keeps the ensemble databases of the frequencies
+//	visited, the library instance may refer to one of them, so
+//	delete the follower after dabExit
+void *dab_createFollower(void *, int32_t SId, const serviceSink *,
+                         void *cache, const followParams *);
+void dab_deleteFollower(void *follower);
+bool dab_startFollower(void *follower, followReport_t, void *ctx);
+void dab_stopFollower(void *follower);
+
+//	the transmission mode in use (1 .. 4)
+int16_t dab_getMode(void *);
+
+//	the offset (in ppm) of the sample clock of the device, as
+//	measured - and compensated - by the library
+float dab_getClockOffset(void *);
+
+//	the quality (0 .. 100) of the FIC of the last frame, from the
+//	soft decisions rather than the CRC, -1 if not known. Below 10
+//	the MSC is not decoded, when it stays there the library
+//	synchronizes again
+int16_t dab_getFicQuality(void *);
+
 //	set/activate reporting of errors
 void dab_setError_handler(void *, decodeErrorReport_t err_Handler);
 
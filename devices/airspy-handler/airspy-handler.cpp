@@ -297,6 +297,7 @@ int airspyHandler::data_available(void *buf, int buf_size) {
       }
 
       theBuffer->putDataIntoBuffer(temp, 2048);
+      notify();
       //
       //	shift the sample at the end to the beginning, it is needed
       //	as the starting sample for the next time
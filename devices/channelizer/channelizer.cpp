@@ -0,0 +1,241 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *	Splitting a wideband stream into a number of DAB channels
+ */
+#include "channelizer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cstring>
+
+#define OUTPUT_RATE 2048000
+//	half the bandwidth of a DAB signal
+#define DAB_HALF_BW 768000
+#define __BUFFERSIZE 16 * 32768
+
+channelHandler::channelHandler(channelizer *parent, int32_t bufferLength) {
+  this->parent = parent;
+  _I_Buffer = new RingBuffer<std::complex<float>>(__BUFFERSIZE);
+  active = false;
+  phasor = std::complex<float>(1, 0);
+  phaseStep = std::complex<float>(1, 0);
+  bufferRe.resize(bufferLength);
+  bufferIm.resize(bufferLength);
+  outBuffer.resize(bufferLength);
+  nextOut = 0;
+}
+
+channelHandler::~channelHandler(void) {
+  stopReader();
+  delete _I_Buffer;
+}
+
+bool channelHandler::restartReader(int32_t frequency) {
+  return parent->start_channel(this, frequency);
+}
+
+void channelHandler::stopReader(void) { parent->stop_channel(this); }
+
+int32_t channelHandler::getSamples(std::complex<float> *V, int32_t size) {
+  return _I_Buffer->getDataFromBuffer(V, size);
+}
+
+int32_t channelHandler::Samples(void) {
+  return _I_Buffer->GetRingBufferReadAvailable();
+}
+
+void channelHandler::resetBuffer(void) { _I_Buffer->FlushRingBuffer(); }
+
+//
+//	The filter passes the DAB signal (+/- 768 KHz), and suppresses
+//	everything that would alias into it after decimation to
+//	2048000, i.e. from 2048 - 768 = 1280 KHz on.
+//	A Blackman windowed sinc with a cutoff halfway the transition
+//	band, 24 taps per output sample.
+channelizer::channelizer(deviceHandler *wideband, int32_t inputRate,
+                         int32_t centerFrequency) {
+  this->wideband = wideband;
+  this->inputRate = inputRate;
+  this->centerFrequency = centerFrequency;
+  decimation = inputRate / OUTPUT_RATE;
+  if ((decimation < 1) || (decimation * OUTPUT_RATE != inputRate)) {
+    fprintf(stderr, "channelizer: rate %d is not a multiple of %d\n",
+            inputRate, OUTPUT_RATE);
+    throw(33);
+  }
+
+  int32_t taps = 24 * decimation + 1;
+  float cutoff = (float)(OUTPUT_RATE / 2) / inputRate;
+  float sum = 0;
+  filter.resize(taps);
+  for (int32_t i = 0; i < taps; i++) {
+    float n = i - (taps - 1) / 2.0;
+    float sinc = n == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * n) / (M_PI * n);
+    float window = 0.42 - 0.5 * cos(2 * M_PI * i / (taps - 1)) +
+                   0.08 * cos(4 * M_PI * i / (taps - 1));
+    filter[i] = sinc * window;
+    sum += filter[i];
+  }
+  for (int32_t i = 0; i < taps; i++) filter[i] /= sum;
+
+  blockSize = 4096 * decimation;
+  inBuffer.resize(blockSize);
+  activeChannels = 0;
+  running.store(false);
+}
+
+//	all channels are stopped before any of them is deleted, the
+//	worker might otherwise touch a deleted one
+channelizer::~channelizer(void) {
+  for (auto c : channels) stop_channel(c);
+  for (auto c : channels) delete c;
+}
+
+deviceHandler *channelizer::newChannel(void) {
+  channelHandler *c = new channelHandler(this, filter.size() - 1 + blockSize);
+  std::lock_guard<std::mutex> lock(locker);
+  channels.push_back(c);
+  return c;
+}
+
+//
+//	the channel is mixed with -offset to baseband, the offset should
+//	leave the whole DAB signal within the wideband stream.
+//	controlLock is held until the worker runs, a stop_channel
+//	cannot come in between
+bool channelizer::start_channel(channelHandler *c, int32_t frequency) {
+  int32_t offset = frequency - centerFrequency;
+
+  if (abs(offset) + DAB_HALF_BW > inputRate / 2) {
+    fprintf(stderr, "channelizer: %d is outside the band\n", frequency);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> control(controlLock);
+  std::lock_guard<std::mutex> lock(locker);
+  c->phasor = std::complex<float>(1, 0);
+  c->phaseStep = std::complex<float>(cos(2 * M_PI * offset / inputRate),
+                                     -sin(2 * M_PI * offset / inputRate));
+  std::fill(c->bufferRe.begin(), c->bufferRe.end(), 0);
+  std::fill(c->bufferIm.begin(), c->bufferIm.end(), 0);
+  c->nextOut = 0;
+  c->_I_Buffer->FlushRingBuffer();
+  if (!c->active) {
+    c->active = true;
+    activeChannels++;
+  }
+  if (!running.load()) {
+    if (!wideband->restartReader(centerFrequency)) {
+      c->active = false;
+      activeChannels--;
+      return false;
+    }
+    running.store(true);
+    workerHandle = std::thread(&channelizer::run, this);
+  }
+  return true;
+}
+
+//
+//	the wideband device keeps running as long as there are
+//	active channels. controlLock is held until the worker is
+//	joined and the device is stopped, a start_channel waits for that
+void channelizer::stop_channel(channelHandler *c) {
+  std::lock_guard<std::mutex> control(controlLock);
+  bool stopDevice = false;
+  {
+    std::lock_guard<std::mutex> lock(locker);
+    if (!c->active) return;
+    c->active = false;
+    activeChannels--;
+    stopDevice = (activeChannels == 0) && running.load();
+    if (stopDevice) running.store(false);
+  }
+  if (stopDevice) {
+    wideband->notify();
+    workerHandle.join();
+    wideband->stopReader();
+  }
+}
+
+void channelizer::run(void) {
+  while (running.load()) {
+    if (!wideband->waitSamples(blockSize, [this] { return !running.load(); }))
+      continue;
+    int32_t n = wideband->getSamples(inBuffer.data(), blockSize);
+    std::lock_guard<std::mutex> lock(locker);
+    for (auto c : channels)
+      if (c->active) process(c, inBuffer.data(), n);
+  }
+}
+
+//
+//	Down conversion followed by the decimating filter, where
+//	only the outputs that are kept are computed, so the costs
+//	per input sample are (taps / decimation) multiplications
+//	for I and Q. With I and Q in arrays of their own, and four
+//	partial sums per inner product, gcc -O3 turns the filter loops
+//	into vector code.
+void channelizer::process(channelHandler *c, const std::complex<float> *in,
+                          int32_t n) {
+  int32_t taps = filter.size();
+  int32_t hist = taps - 1;
+  float *re = c->bufferRe.data();
+  float *im = c->bufferIm.data();
+  const float *h = filter.data();
+  int32_t outCount = 0;
+  int32_t pos;
+
+  for (int32_t i = 0; i < n; i++) {
+    std::complex<float> s = in[i] * c->phasor;
+    c->phasor *= c->phaseStep;
+    re[hist + i] = real(s);
+    im[hist + i] = imag(s);
+  }
+  c->phasor /= std::abs(c->phasor);
+
+  for (pos = c->nextOut; pos + taps <= hist + n; pos += decimation) {
+    float r[4] = {0, 0, 0, 0};
+    float q[4] = {0, 0, 0, 0};
+    int32_t k;
+    for (k = 0; k + 4 <= taps; k += 4)
+      for (int j = 0; j < 4; j++) {
+        r[j] += h[k + j] * re[pos + k + j];
+        q[j] += h[k + j] * im[pos + k + j];
+      }
+    for (; k < taps; k++) {
+      r[0] += h[k] * re[pos + k];
+      q[0] += h[k] * im[pos + k];
+    }
+    c->outBuffer[outCount++] = std::complex<float>(r[0] + r[1] + r[2] + r[3],
+                                                   q[0] + q[1] + q[2] + q[3]);
+  }
+  c->nextOut = pos - n;
+
+  //	keep the last hist samples for the next block
+  memmove(re, &re[n], hist * sizeof(float));
+  memmove(im, &im[n], hist * sizeof(float));
+  c->_I_Buffer->putDataIntoBuffer(c->outBuffer.data(), outCount);
+  c->notify();
+}
@@ -0,0 +1,98 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __CHANNELIZER__
+#define __CHANNELIZER__
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "device-handler.h"
+#include "ringbuffer.h"
+
+class channelizer;
+
+//
+//	A channelHandler is a "virtual" device, delivering the
+//	2048000 samples/sec of a single DAB channel, taken from the
+//	wideband stream of the channelizer. Each one can be given to
+//	its own dabProcessor
+class channelHandler : public deviceHandler {
+ public:
+  channelHandler(channelizer *, int32_t);
+  ~channelHandler(void);
+  bool restartReader(int32_t);
+  void stopReader(void);
+  int32_t getSamples(std::complex<float> *, int32_t);
+  int32_t Samples(void);
+  void resetBuffer(void);
+
+ private:
+  friend class channelizer;
+  channelizer *parent;
+  RingBuffer<std::complex<float>> *_I_Buffer;
+  bool active;
+  //	state of the down converter
+  std::complex<float> phasor;
+  std::complex<float> phaseStep;
+  std::vector<float> bufferRe;
+  std::vector<float> bufferIm;
+  std::vector<std::complex<float>> outBuffer;
+  int32_t nextOut;
+};
+
+//
+//	The channelizer reads a wideband stream, with a samplerate that
+//	is a multiple of 2048000, from a device tuned to centerFrequency.
+//	For each active channel the stream is shifted to baseband and
+//	filtered and decimated with a polyphase decimator.
+class channelizer {
+ public:
+  channelizer(deviceHandler *, int32_t inputRate, int32_t centerFrequency);
+  ~channelizer(void);
+  deviceHandler *newChannel(void);
+
+ private:
+  friend class channelHandler;
+  bool start_channel(channelHandler *, int32_t);
+  void stop_channel(channelHandler *);
+  void run(void);
+  void process(channelHandler *, const std::complex<float> *, int32_t);
+  deviceHandler *wideband;
+  int32_t inputRate;
+  int32_t centerFrequency;
+  int32_t decimation;
+  int32_t blockSize;
+  std::vector<float> filter;
+  std::vector<channelHandler *> channels;
+  std::vector<std::complex<float>> inBuffer;
+  std::mutex locker;
+  //	starting and stopping channels - and with them the worker
+  //	and the device - is done one at the time
+  std::mutex controlLock;
+  std::thread workerHandle;
+  std::atomic<bool> running;
+  int activeChannels;
+};
+
+#endif
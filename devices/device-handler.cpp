@@ -56,3 +56,23 @@ void deviceHandler::set_autogain(bool b) { (void)b; }
 void deviceHandler::set_ifgainReduction(int x) { (void)x; }
 
 void deviceHandler::set_lnaState(int x) { (void)x; }
+
+//
+//	The lock is taken - and released - before notifying, a
+//	waiter is then either still before its test, or waiting
+void deviceHandler::notify(void) {
+  { std::lock_guard<std::mutex> lock(sampleLock); }
+  sampleReady.notify_all();
+}
+
+//
+//	stop is tested with the lock held, changing its outcome
+//	should be followed by notify. Devices that do not notify - e.g.
+//	implemented outside the library - are looked at every 100 msec
+bool deviceHandler::waitSamples(int32_t n,
+                                const std::function<bool(void)> &stop) {
+  std::unique_lock<std::mutex> lock(sampleLock);
+  while (!stop() && (Samples() < n))
+    sampleReady.wait_for(lock, std::chrono::milliseconds(100));
+  return Samples() >= n;
+}
@@ -29,6 +29,9 @@
 
 #include <stdint.h>
 #include <complex>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <thread>
 using namespace std;
 
@@ -49,6 +52,12 @@ class deviceHandler {
   virtual void set_autogain(bool);
   virtual double currentOffset() const { return -1.0; }  // in seconds; < 0 for undefined
   //
+  //	a device calls notify when it added samples, waitSamples
+  //	then waits - without polling - until there are enough, or
+  //	until the condition passed says to stop
+  void notify(void);
+  bool waitSamples(int32_t, const std::function<bool(void)> &);
+  //
   //	for the sdrplay
   virtual void set_ifgainReduction(int);
   virtual void set_lnaState(int);
@@ -58,5 +67,9 @@ class deviceHandler {
   int32_t vfoOffset;
   int theGain;
   virtual void run(void);
+
+ private:
+  std::mutex sampleLock;
+  std::condition_variable sampleReady;
 };
 #endif
@@ -125,6 +125,7 @@ static int callback(hackrf_transfer *transfer) {
     buffer[i] = std::complex<float>(re, im);
   }
   q->putDataIntoBuffer(buffer, transfer->valid_length / 2);
+  ctx->notify();
   return 0;
 }
 
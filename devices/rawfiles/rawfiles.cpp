@@ -163,6 +163,7 @@ void rawFiles::run(void) {
     }
 
     _I_Buffer->putDataIntoBuffer(bi, t);
+    notify();
     if (eofReached) {
       eofReached = false;
       if (eofHandler != nullptr) eofHandler(userData);
@@ -112,6 +112,7 @@ void rtl_tcp_client::run(void) {
     }
 
     theBuffer->putDataIntoBuffer(buffer, res);
+    notify();
   }
 }
 
@@ -47,6 +47,7 @@ static void RTLSDRCallBack(uint8_t *buf, uint32_t len, void *ctx) {
   if ((theStick == nullptr) || (len != READLEN_DEFAULT)) return;
 
   (void)theStick->_I_Buffer->putDataIntoBuffer(buf, len);
+  theStick->notify();
 }
 //
 //	for handling the events in libusb, we need a controlthread
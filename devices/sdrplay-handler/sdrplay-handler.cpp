@@ -116,6 +116,7 @@ static void myStreamCallback(int16_t *xi, int16_t *xq, uint32_t firstSampleNum,
     localBuf[i] = std::complex<float>(float(xi[i]) / denominator,
                                       float(xq[i]) / denominator);
   p->_I_Buffer->putDataIntoBuffer(localBuf, numSamples);
+  p->notify();
   (void)firstSampleNum;
   (void)grChanged;
   (void)rfChanged;
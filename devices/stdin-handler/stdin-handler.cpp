@@ -116,6 +116,7 @@ void stdinHandler::run(void) {
     }
 
     _I_Buffer->putDataIntoBuffer(bi, t);
+    notify();
     if (nextStop - getMyTime() > 0) usleep(nextStop - getMyTime());
   }
 
@@ -162,6 +162,7 @@ void wavFiles::run(void) {
       t = bufferSize;
     }
     _I_Buffer->putDataIntoBuffer(bi, bufferSize);
+    notify();
     if (eofReached) {
       if (eofHandler != nullptr) eofHandler(userData);
       eofReached = false;
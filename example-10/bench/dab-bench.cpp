@@ -0,0 +1,645 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *	dab-bench: the measurements behind the performance work on the
+ *	library, on synthetic signals, such that they can be repeated.
+ *	Each measurement is a command, see usage ().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "band-handler.h"
+#include "channelizer.h"
+#include "dab-api.h"
+#include "fib-decoder.h"
+#include "synthetic-signal.h"
+
+static double wallTime(void) {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+//	the CPU time of the process, all threads
+static double cpuTime(void) {
+  struct rusage r;
+  getrusage(RUSAGE_SELF, &r);
+  return r.ru_utime.tv_sec + r.ru_stime.tv_sec +
+         1e-6 * (r.ru_utime.tv_usec + r.ru_stime.tv_usec);
+}
+
+//	FIG 1/0 (ensemble label, id the EId) or 1/1 (service label,
+//	id the SId), 22 bytes
+static std::vector<uint8_t> labelFig(uint8_t ext, uint16_t id,
+                                     const char *label) {
+  std::vector<uint8_t> fig = {0x35, ext, (uint8_t)(id >> 8),
+                              (uint8_t)(id & 0xFF)};
+  char text[17];
+  snprintf(text, sizeof(text), "%-16s", label);
+  fig.insert(fig.end(), text, text + 16);
+  fig.push_back(0xFF);
+  fig.push_back(0x00);
+  return fig;
+}
+
+static void syncsignal(bool b, void *ctx) {
+  (void)b;
+  (void)ctx;
+}
+
+/////////////////////////////////////////////////////////////////////
+//
+//	scan: Band III with ensembles - at 12 dB - on 6 channels and
+//	noise on the others, in real time. dab_scanBand against the
+//	loop of example-10 -E: per channel a library instance, waiting
+//	for the ensemble name or the time out. With -p the device has a
+//	frequency error, what dab_scanBand learned of it is shown
+static const char *scanChannels[] = {"5C", "8D", "11C", "11D", "12B", "12C"};
+
+static void scanReport(const scanResult *r, void *handle, void *ctx) {
+  double *last = (double *)ctx;
+  (void)handle;
+  printf("%-4s signal %d ensemble %d %-16s %5.2f s\n", r->channel,
+         r->signalPresent, r->ensembleFound,
+         r->ensembleFound ? r->ensembleName : "", wallTime() - *last);
+  fflush(stdout);
+  *last = wallTime();
+}
+
+static std::atomic<bool> ensembleSeen;
+static void ensembleName(std::string label, std::string abbr, int32_t EId,
+                         void *ctx) {
+  (void)label;
+  (void)abbr;
+  (void)EId;
+  (void)ctx;
+  ensembleSeen.store(true);
+}
+
+static int scan(int argc, char **argv) {
+  bool baseline = false;
+  float ppm = 0;
+  for (int i = 0; i < argc; i++)
+    if (!strcmp(argv[i], "-b"))
+      baseline = true;
+    else if (!strcmp(argv[i], "-p") && (i + 1 < argc))
+      ppm = atof(argv[++i]);
+  const int32_t waitingTime = 10000;
+  bandHandler band;
+  syntheticDevice device(true, 1);
+  std::vector<syntheticSignal *> signals;
+
+  device.setFrequencyError(ppm);
+  for (uint16_t i = 0; i < 6; i++) {
+    syntheticSignal *s = new syntheticSignal(0x4001 + i, 10 + i);
+    std::string name = std::string("Ensemble ") + scanChannels[i];
+    s->addFig(labelFig(0, 0x4001 + i, name.c_str()));
+    device.addTransmitter(band.Frequency(BAND_III, scanChannels[i]), s,
+                          [](double) { return 12.0f; });
+    signals.push_back(s);
+  }
+
+  double start = wallTime();
+  double last = start;
+  int found = 0;
+  if (!baseline) {
+    afcState afc;
+    memset(&afc, 0, sizeof(afc));
+    found = dab_scanBand(&device, 1, BAND_III, waitingTime, waitingTime,
+                         &afc, scanReport, &last);
+    printf("afc: valid %d, %.2f ppm, %d updates\n", afc.valid, afc.ppm,
+           afc.updates);
+  } else {
+    std::string first = band.firstChannel(BAND_III);
+    std::string channel = first;
+    do {
+      void *radio = dabInit(&device, 1, syncsignal, nullptr, ensembleName,
+                            nullptr, nullptr, nullptr, nullptr, nullptr,
+                            nullptr, nullptr, nullptr, nullptr, nullptr,
+                            nullptr);
+      ensembleSeen.store(false);
+      device.restartReader(band.Frequency(BAND_III, channel));
+      dabStartProcessing(radio);
+      int32_t waited = 0;
+      while (!ensembleSeen.load() && ((waited += 10) < waitingTime))
+        usleep(10000);
+      device.stopReader();
+      dabStop(radio);
+      dabExit(radio);
+      if (ensembleSeen.load()) found++;
+      printf("%-4s ensemble %d %5.2f s\n", channel.c_str(),
+             (int)ensembleSeen.load(), wallTime() - last);
+      fflush(stdout);
+      last = wallTime();
+      channel = band.nextChannel(BAND_III, channel);
+    } while ((channel != first) && (channel != ""));
+  }
+  printf("%s: %d ensembles in %.1f s\n",
+         baseline ? "example-10 -E loop" : "dab_scanBand", found,
+         wallTime() - start);
+  for (auto s : signals) delete s;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////
+//
+//	channelizer: the costs of a channel, i.e. the number of channels
+//	a core can handle, for a wideband input of 4 and 5 times 2048000.
+//	The wideband device delivers - as fast as it is asked - noise
+//	from a table, each channel is read by a thread of its own
+class widebandDevice : public deviceHandler {
+ public:
+  widebandDevice(void) : noise(65536) {
+    std::mt19937 rng(1);
+    std::normal_distribution<float> gauss;
+    for (auto &x : noise) x = std::complex<float>(gauss(rng), gauss(rng));
+    pos = 0;
+    running.store(false);
+    delivered.store(0);
+  }
+  bool restartReader(int32_t frequency) {
+    (void)frequency;
+    running.store(true);
+    return true;
+  }
+  void stopReader(void) { running.store(false); }
+  int32_t Samples(void) { return running.load() ? 1 << 20 : 0; }
+  int32_t getSamples(std::complex<float> *V, int32_t size) {
+    for (int32_t i = 0; i < size; i++) {
+      V[i] = noise[pos];
+      pos = (pos + 1) & (noise.size() - 1);
+    }
+    delivered += size;
+    return size;
+  }
+  std::atomic<int64_t> delivered;
+
+ private:
+  std::vector<std::complex<float>> noise;
+  size_t pos;
+  std::atomic<bool> running;
+};
+
+static int channels(int argc, char **argv) {
+  int32_t seconds = argc > 0 ? atoi(argv[0]) : 5;
+  for (int32_t decimation = 4; decimation <= 5; decimation++) {
+    int32_t rate = 2048000 * decimation;
+    int32_t center = 220000000;
+    for (int nrChannels = 1; nrChannels <= 3; nrChannels++) {
+      widebandDevice wideband;
+      channelizer theChannelizer(&wideband, rate, center);
+      std::vector<deviceHandler *> devices;
+      std::vector<std::thread> readers;
+      std::atomic<bool> reading(true);
+      for (int i = 0; i < nrChannels; i++) {
+        deviceHandler *d = theChannelizer.newChannel();
+        d->restartReader(center + 1712000 * (i - 1));
+        devices.push_back(d);
+      }
+      for (auto d : devices)
+        readers.emplace_back([d, &reading] {
+          std::vector<std::complex<float>> buffer(8192);
+          while (reading.load())
+            if (d->waitSamples(8192, [&reading] { return !reading.load(); }))
+              d->getSamples(buffer.data(), 8192);
+        });
+      double cpu = cpuTime();
+      int64_t start = wideband.delivered.load();
+      sleep(seconds);
+      cpu = cpuTime() - cpu;
+      double input = (double)(wideband.delivered.load() - start) / rate;
+      reading.store(false);
+      for (auto d : devices) {
+        d->stopReader();
+        d->notify();
+      }
+      for (auto &t : readers) t.join();
+      printf("%.3f MS/s, decimation %d, %d channel(s): "
+             "%.1f%% of a core per channel, %.1f channels per core\n",
+             rate / 1e6, decimation, nrChannels,
+             100 * cpu / input / nrChannels, nrChannels * input / cpu);
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////
+//
+//	ficonly: the CPU time per second of signal - at 15 dB - with
+//	FIC-only mode, with full decoding and no service, and with full
+//	decoding of a 96 kbit/s DAB+ service. The device repeats 10
+//	frames, as fast as it is read, such that generating the signal
+//	is not counted
+static void audioOut(int16_t *buffer, int size, int rate, bool stereo,
+                     void *ctx) {
+  (void)buffer;
+  (void)size;
+  (void)rate;
+  (void)stereo;
+  (void)ctx;
+}
+
+static int ficOnly(int argc, char **argv) {
+  int32_t seconds = argc > 0 ? atoi(argv[0]) : 30;
+  const char *names[] = {"FIC-only", "full, no service",
+                         "full, one 96 kbit/s DAB+"};
+  for (int mode = 0; mode < 3; mode++) {
+    syntheticSignal signal(0x4001, 1);
+    syntheticDevice device(false, 1);
+    signal.addFig(labelFig(0, 0x4001, "FIC only"));
+    device.addTransmitter(227360000, &signal, [](double) { return 15.0f; });
+    device.restartReader(227360000);
+    device.loop(10);
+    void *radio =
+        dabInit(&device, 1, syncsignal, nullptr, nullptr, nullptr, nullptr,
+                audioOut, nullptr, nullptr, nullptr, nullptr, nullptr,
+                nullptr, nullptr, nullptr);
+    dab_setFicOnly(radio, mode == 0);
+    if (mode == 2) {
+      audiodata ad;
+      memset(&ad, 0, sizeof(ad));
+      ad.defined = true;
+      ad.subchId = 1;
+      ad.startAddr = 0;
+      ad.shortForm = false;
+      ad.protLevel = 2;  // EEP 3-A
+      ad.length = 72;
+      ad.bitRate = 96;
+      ad.ASCTy = 077;
+      set_audioChannel(radio, &ad);
+    }
+    dabStartProcessing(radio);
+    //	a warming up of 2 seconds, for the synchronization
+    while (device.signalTime() < 2) usleep(1000);
+    double start = device.signalTime();
+    double cpu = cpuTime();
+    while (device.signalTime() - start < seconds) usleep(1000);
+    cpu = cpuTime() - cpu;
+    double signalSeconds = device.signalTime() - start;
+    printf("%-26s %5.1f ms CPU per second of signal (%.1f%% of a core)\n",
+           names[mode], 1000 * cpu / signalSeconds,
+           100 * cpu / signalSeconds);
+    fflush(stdout);
+    device.stopReader();
+    dabStop(radio);
+    dabExit(radio);
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////
+//
+//	fib: the steady state costs of the FIB processing, i.e. the FIC
+//	of an ensemble that does not change. The ensemble has 100
+//	services on 64 subchannels; per service a FIB with its label
+//	(FIG 1/1) and - for the first 64 - its subchannel (FIG 0/1), and
+//	a FIB with the service (FIG 0/2).
+//	The FIBs are given - as bits - to a fib_processor, in frames of
+//	12 FIBs, as the ficHandler does
+class fibWriter {
+ public:
+  fibWriter(void) { bits.reserve(256); }
+  void put(uint32_t v, int n) {
+    for (int i = n - 1; i >= 0; i--) bits.push_back((v >> i) & 1);
+  }
+  //	the end marker and padding
+  std::vector<uint8_t> fib(void) {
+    while (bits.size() < 256) bits.push_back(1);
+    std::vector<uint8_t> res;
+    res.swap(bits);
+    return res;
+  }
+
+ private:
+  std::vector<uint8_t> bits;
+};
+
+static void fibName(std::string label, std::string abbr, int32_t id,
+                    void *ctx) {
+  (void)label;
+  (void)abbr;
+  (void)id;
+  (void)ctx;
+}
+
+static int fibCosts(int argc, char **argv) {
+  int32_t seconds = argc > 0 ? atoi(argv[0]) : 5;
+  std::vector<std::vector<uint8_t>> feed;
+  fibWriter w;
+  for (int32_t svc = 0; svc < 100; svc++) {
+    char label[17];
+    snprintf(label, sizeof(label), "Radio %-10d", svc);
+    w.put(1, 3);  // FIG 1/1, 21 bytes
+    w.put(21, 5);
+    w.put(0, 4);
+    w.put(0, 1);
+    w.put(1, 3);
+    w.put(0x1000 + svc, 16);
+    for (int i = 0; i < 16; i++) w.put(label[i], 8);
+    w.put(0xF000, 16);
+    if (svc < 64) {  // FIG 0/1, short form
+      w.put(0, 3);
+      w.put(4, 5);
+      w.put(0, 3);
+      w.put(1, 5);
+      w.put(svc, 6);
+      w.put(svc * 10, 10);
+      w.put(0, 2);
+      w.put(14, 6);
+    }
+    feed.push_back(w.fib());
+    w.put(0, 3);  // FIG 0/2, one audio component
+    w.put(6, 5);
+    w.put(0, 3);
+    w.put(2, 5);
+    w.put(0x1000 + svc, 16);
+    w.put(0, 4);
+    w.put(1, 4);
+    w.put(0, 2);
+    w.put(63, 6);
+    w.put(svc % 64, 6);
+    w.put(2, 2);
+    feed.push_back(w.fib());
+  }
+
+  fib_processor fibs(fibName, fibName, nullptr);
+  int64_t frames = 0;
+  size_t next = 0;
+  auto frame = [&] {
+    fibs.newFrame();
+    for (int i = 0; i < 12; i++) {
+      fibs.process_FIB(feed[next].data(), (frames * 4 + i / 3) % 5000);
+      next = (next + 1) % feed.size();
+    }
+    fibs.publishSnapshot();
+    frames++;
+  };
+  //	the first rounds build the database
+  while (frames * 12 < 4 * (int64_t)feed.size()) frame();
+  printf("%d services\n", (int)fibs.serviceIds().size());
+
+  double cpu = cpuTime();
+  int64_t start = frames;
+  while (cpuTime() - cpu < seconds)
+    for (int i = 0; i < 1000; i++) frame();
+  cpu = cpuTime() - cpu;
+  double perFib = 1e9 * cpu / ((frames - start) * 12);
+  printf("%.0f ns per FIB, %.3f ms CPU per second of FIC (125 FIBs)\n",
+         perFib, perFib * 125 / 1e6);
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////
+//
+//	follow: two transmitters of ensemble 4001 carry service 5001,
+//	A on 13B and B on 12C, in real time. A is at 15 dB for 5 s
+//	and then fades - 4 dB per second - to -5 dB, B stays at 12 dB.
+//	The follower starts on A and should move to B. The MSC carries
+//	random bits, the quality of the service means nothing here, so
+//	minQuality is 0: the SNR and the sync decide
+static const int32_t followA = 239200000;
+static const int32_t followB = 227360000;
+
+static float snrA(double t) {
+  return t < 5 ? 15 : t < 10 ? 15 - 4 * (t - 5) : -5;
+}
+
+static syntheticDevice *followDevice;
+static double followMoved;
+static void followReport(int32_t frequency, int32_t SId, int16_t snr,
+                         void *ctx) {
+  (void)ctx;
+  followMoved = followDevice->signalTime();
+  printf("t = %5.1f s: moved to %d, SId %X, snr %d\n", followMoved,
+         frequency, SId, snr);
+  fflush(stdout);
+}
+
+static std::atomic<int16_t> followSnr;
+static void followSystemdata(bool sync, int16_t snr, int32_t offset,
+                             void *ctx) {
+  (void)sync;
+  (void)offset;
+  (void)ctx;
+  followSnr.store(snr);
+}
+
+static int follow(int argc, char **argv) {
+  int32_t seconds = argc > 0 ? atoi(argv[0]) : 20;
+  syntheticSignal signal(0x4001, 1);
+  syntheticDevice device(true, 1);
+  uint32_t fA = followA / 16000;
+  uint32_t fB = followB / 16000;
+
+  //	FIG 0/1: subchannel 1, long form EEP 3-A, 72 CUs
+  signal.addFig({0x05, 0x01, 0x04, 0x00, 0x88, 0x48});
+  //	FIG 0/2: service 5001, DAB+ in subchannel 1
+  signal.addFig({0x06, 0x02, 0x50, 0x01, 0x01, 0x3F, 0x06});
+  //	FIG 0/21: ensemble 4001 on both frequencies
+  signal.addFig({0x0C, 0x15, 0x00, 0x09, 0x40, 0x01, (1 << 3) | 6,
+                 (uint8_t)(fA >> 16), (uint8_t)(fA >> 8), (uint8_t)fA,
+                 (uint8_t)(fB >> 16), (uint8_t)(fB >> 8), (uint8_t)fB});
+  signal.addFig(labelFig(0, 0x4001, "Follow test"));
+  signal.addFig(labelFig(1, 0x5001, "Follow me"));
+  device.addTransmitter(followA, &signal, snrA);
+  device.addTransmitter(followB, &signal, [](double) { return 12.0f; });
+  followDevice = &device;
+  followMoved = -1;
+
+  void *radio =
+      dabInit(&device, 1, syncsignal, followSystemdata, nullptr, nullptr,
+              nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+              nullptr, nullptr, nullptr);
+  dab_setFicOnly(radio, true);
+  device.restartReader(followA);
+  dab_setFrequency(radio, followA);
+  dabStartProcessing(radio);
+  followParams params = {0, 8, 1000, 10000, 1000, 10, 3};
+  void *follower = dab_createFollower(radio, 0x5001, nullptr, nullptr, &params);
+  dab_startFollower(follower, followReport, nullptr);
+  for (int32_t s = 1; s <= seconds; s++) {
+    sleep(1);
+    printf("t = %5.1f s: A at %5.1f dB, snr %d\n", device.signalTime(),
+           snrA(device.signalTime()), followSnr.load());
+    fflush(stdout);
+  }
+  dab_stopFollower(follower);
+  dabStop(radio);
+  dabExit(radio);
+  dab_deleteFollower(follower);
+  if (followMoved < 0)
+    printf("the follower did not move\n");
+  else
+    printf("moved %.1f s after A dropped below 8 dB (t = 6.75 s)\n",
+           followMoved - 6.75);
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////
+//
+//	coherent: differential against coherent demodulation. The FIC
+//	carries only FIG 0/0 and the ensemble label, so all FIBs are
+//	equal apart from the CIF count (bytes 4 and 5) and the CRC: the
+//	bits of the FIBs as decoded - CRC right or wrong - are compared
+//	with those sent, giving the bit error rate after the Viterbi.
+//	Per channel - white noise only, and Rayleigh fading with two
+//	paths - and SNR, seconds of signal as fast as it is decoded.
+//	Then the CPU time per second of signal, for both, on a clean
+//	channel (10 frames repeated)
+struct cohCounts {
+  uint8_t reference[32];
+  std::atomic<bool> counting;
+  std::atomic<int64_t> fibs;
+  std::atomic<int64_t> good;
+  std::atomic<int64_t> bitErrors;
+};
+
+static void cohFib(const uint8_t *fib, int crc_ok, void *ctx) {
+  cohCounts *c = (cohCounts *)ctx;
+  int errors = 0;
+  if (!c->counting.load()) return;
+  for (int i = 0; i < 30; i++)
+    if ((i != 4) && (i != 5))
+      errors += __builtin_popcount(fib[i] ^ c->reference[i]);
+  c->fibs++;
+  if (crc_ok) c->good++;
+  c->bitErrors += errors;
+}
+
+static void cohRun(bool coherent, float snr, float doppler, int32_t seconds) {
+  syntheticSignal signal(0x4001, 1);
+  syntheticDevice device(false, 1);
+  cohCounts counts;
+  signal.addFig(labelFig(0, 0x4001, "Coherent test"));
+  signal.makeFib(counts.reference, 0);
+  counts.counting.store(false);
+  counts.fibs.store(0);
+  counts.good.store(0);
+  counts.bitErrors.store(0);
+  device.addTransmitter(227360000, &signal, [snr](double) { return snr; });
+  if (doppler > 0) device.setFading(doppler, 20, -3);
+  device.restartReader(227360000);
+  void *radio =
+      dabInit(&device, 1, syncsignal, nullptr, nullptr, nullptr, nullptr,
+              nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+              nullptr, &counts);
+  dab_setFIB_handler(radio, cohFib);
+  dab_setCoherent(radio, coherent);
+  dabStartProcessing(radio);
+  //	2 seconds for the synchronization
+  while (device.signalTime() < 2) usleep(10000);
+  counts.counting.store(true);
+  while (device.signalTime() < 2 + seconds) usleep(10000);
+  device.stopReader();
+  dabStop(radio);
+  dabExit(radio);
+  int64_t fibs = counts.fibs.load();
+  printf("%-12s %-12s %5.1f dB: %6lld FIBs, CRC ok %5.1f%%, BER %.2e\n",
+         doppler > 0 ? "fading" : "white noise",
+         coherent ? "coherent" : "differential", snr, (long long)fibs,
+         fibs > 0 ? 100.0 * counts.good.load() / fibs : 0,
+         fibs > 0 ? (double)counts.bitErrors.load() / (fibs * 28 * 8) : 1);
+  fflush(stdout);
+}
+
+static int coherent(int argc, char **argv) {
+  int32_t seconds = argc > 0 ? atoi(argv[0]) : 20;
+  const float white[] = {2, 3, 4};
+  const float fading[] = {8, 10, 12};
+  for (float snr : white)
+    for (int c = 0; c < 2; c++) cohRun(c == 1, snr, 0, seconds);
+  for (float snr : fading)
+    for (int c = 0; c < 2; c++) cohRun(c == 1, snr, 10, seconds);
+
+  for (int c = 0; c < 2; c++) {
+    syntheticSignal signal(0x4001, 1);
+    syntheticDevice device(false, 1);
+    signal.addFig(labelFig(0, 0x4001, "Coherent test"));
+    device.addTransmitter(227360000, &signal, [](double) { return 15.0f; });
+    device.restartReader(227360000);
+    device.loop(10);
+    void *radio =
+        dabInit(&device, 1, syncsignal, nullptr, nullptr, nullptr, nullptr,
+                nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+                nullptr, nullptr, nullptr);
+    dab_setCoherent(radio, c == 1);
+    dabStartProcessing(radio);
+    while (device.signalTime() < 2) usleep(1000);
+    double start = device.signalTime();
+    double cpu = cpuTime();
+    while (device.signalTime() - start < 3 * seconds) usleep(1000);
+    cpu = cpuTime() - cpu;
+    printf("%-12s %5.1f ms CPU per second of signal\n",
+           c == 1 ? "coherent" : "differential",
+           1000 * cpu / (device.signalTime() - start));
+    fflush(stdout);
+    device.stopReader();
+    dabStop(radio);
+    dabExit(radio);
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////
+
+static void usage(void) {
+  fprintf(stderr,
+          "dab-bench <command> [options], the commands:\n"
+          "  scan [-b] [-p ppm]\n"
+          "              time to scan Band III in real time, with -b\n"
+          "              the example-10 -E loop instead of dab_scanBand,\n"
+          "              with -p a frequency error of the device\n"
+          "  channelizer [seconds]\n"
+          "              the costs of a channel of the channelizer\n"
+          "  ficonly [seconds]\n"
+          "              CPU time with FIC-only mode and full decoding\n"
+          "  fib [seconds]\n"
+          "              the steady state costs of the FIB processing\n"
+          "  follow [seconds]\n"
+          "              the AF follower, with a transmitter fading away\n"
+          "  coherent [seconds]\n"
+          "              bit errors and CPU time, differential and coherent\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+  if (!strcmp(argv[1], "scan")) return scan(argc - 2, argv + 2);
+  if (!strcmp(argv[1], "channelizer")) return channels(argc - 2, argv + 2);
+  if (!strcmp(argv[1], "ficonly")) return ficOnly(argc - 2, argv + 2);
+  if (!strcmp(argv[1], "fib")) return fibCosts(argc - 2, argv + 2);
+  if (!strcmp(argv[1], "follow")) return follow(argc - 2, argv + 2);
+  if (!strcmp(argv[1], "coherent")) return coherent(argc - 2, argv + 2);
+  usage();
+  return 1;
+}
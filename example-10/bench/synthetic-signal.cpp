@@ -0,0 +1,344 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#include "synthetic-signal.h"
+#include <math.h>
+#include <unistd.h>
+#include <cstring>
+#include "protTables.h"
+
+//	Mode I
+#define T_NULL 2656
+#define T_U 2048
+#define T_G 504
+#define CARRIERS 1536
+#define SYMBOLS 76
+#define SAMPLE_RATE 2048000
+
+//	three FIBs per codeword, four codewords per frame
+#define FIB_BITS 256
+#define CODEWORD_BITS (3 * FIB_BITS)
+
+syntheticSignal::syntheticSignal(uint16_t EId, int32_t seed)
+    : rng(seed), fft(1), interleaver(1), phases(1) {
+  this->EId = EId;
+  nextFig = 0;
+  frameCount = 0;
+  framePos = 0;
+  //	energy dispersal: x^9 + x^5 + 1, all ones to start with
+  uint8_t shiftRegister[9];
+  memset(shiftRegister, 1, 9);
+  prbs.resize(CODEWORD_BITS);
+  for (int i = 0; i < CODEWORD_BITS; i++) {
+    prbs[i] = shiftRegister[8] ^ shiftRegister[4];
+    for (int j = 8; j > 0; j--) shiftRegister[j] = shiftRegister[j - 1];
+    shiftRegister[0] = prbs[i];
+  }
+  //	the FIC puncturing: 21 blocks with PI 16, 3 with PI 15 and
+  //	the tail with PI 8
+  puncture.assign(4 * CODEWORD_BITS + 24, false);
+  int32_t local = 0;
+  for (int i = 0; i < 21; i++)
+    for (int k = 0; k < 128; k++) puncture[local++] = get_PCodes(16 - 1)[k % 32];
+  for (int i = 0; i < 3; i++)
+    for (int k = 0; k < 128; k++) puncture[local++] = get_PCodes(15 - 1)[k % 32];
+  for (int k = 0; k < 24; k++) puncture[local++] = get_PCodes(8 - 1)[k];
+  frame.resize(frameSize);
+  framePos = frameSize;
+}
+
+syntheticSignal::~syntheticSignal(void) {}
+
+//	a FIG - header included - of at most 24 bytes, such that it
+//	fits in a FIB after the FIG 0/0
+void syntheticSignal::addFig(const std::vector<uint8_t> &fig) {
+  if ((fig.size() > 0) && (fig.size() <= 24)) figs.push_back(fig);
+}
+
+void syntheticSignal::fillFib(uint8_t *fib, int32_t cif) {
+  int32_t pos = 6;
+  fib[0] = 0x05;  // FIG 0, length 5
+  fib[1] = 0x00;  // extension 0
+  fib[2] = EId >> 8;
+  fib[3] = EId & 0xFF;
+  fib[4] = (cif / 250) & 0x1F;
+  fib[5] = cif % 250;
+  for (size_t tried = 0; tried < figs.size(); tried++) {
+    const std::vector<uint8_t> &fig = figs[nextFig];
+    if (pos + (int32_t)fig.size() > 30) break;
+    memcpy(&fib[pos], fig.data(), fig.size());
+    pos += fig.size();
+    nextFig = (nextFig + 1) % figs.size();
+  }
+  memset(&fib[pos], 0xFF, 30 - pos);
+  uint16_t crc = 0xFFFF;
+  for (int i = 0; i < 30; i++) {
+    crc ^= fib[i] << 8;
+    for (int k = 0; k < 8; k++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  crc = ~crc;
+  fib[30] = crc >> 8;
+  fib[31] = crc & 0xFF;
+}
+
+void syntheticSignal::makeFib(uint8_t *fib, int32_t cif) {
+  size_t saved = nextFig;
+  nextFig = 0;
+  fillFib(fib, cif);
+  nextFig = saved;
+}
+
+//	the 4 codewords of the frame, each 3 FIBs, convolutionally
+//	encoded and punctured to 2304 bits
+void syntheticSignal::encodeFic(void) {
+  static const int polys[4] = {0133, 0171, 0145, 0133};
+  ficBits.clear();
+  for (int c = 0; c < 4; c++) {
+    std::vector<uint8_t> in(CODEWORD_BITS + 6, 0);
+    for (int f = 0; f < 3; f++) {
+      uint8_t fib[32];
+      fillFib(fib, (frameCount * 4 + c) % 5000);
+      for (int i = 0; i < FIB_BITS; i++)
+        in[f * FIB_BITS + i] = (fib[i / 8] >> (7 - i % 8)) & 1;
+    }
+    for (int i = 0; i < CODEWORD_BITS; i++) in[i] ^= prbs[i];
+    int reg = 0;
+    for (int i = 0; i < CODEWORD_BITS + 6; i++) {
+      reg = (reg >> 1) | (in[i] << 6);
+      for (int q = 0; q < 4; q++) {
+        int v = 0;
+        for (int t = 0; t < 7; t++) v ^= ((reg & polys[q]) >> t) & 1;
+        if (puncture[i * 4 + q]) ficBits.push_back(v);
+      }
+    }
+  }
+}
+
+//	null symbol, phase reference and 75 differentially modulated
+//	symbols, the first 3 of which carry the FIC
+void syntheticSignal::generateFrame(void) {
+  std::vector<std::complex<float>> Z(T_U, 0);
+  std::uniform_int_distribution<int> bit(0, 1);
+  std::complex<float> *v = fft.getVector();
+  int32_t out = 0;
+
+  encodeFic();
+  for (int i = 0; i < T_NULL; i++) frame[out++] = 0;
+  for (int l = 0; l < SYMBOLS; l++) {
+    if (l == 0) {
+      for (int k = -CARRIERS / 2; k <= CARRIERS / 2; k++)
+        if (k != 0) {
+          float phi = phases.get_Phi(k);
+          Z[(k + T_U) % T_U] = std::complex<float>(cosf(phi), sinf(phi));
+        }
+    } else
+      for (int i = 0; i < CARRIERS; i++) {
+        int k = interleaver.mapIn(i);
+        int b0, b1;
+        if (l <= 3) {
+          b0 = ficBits[(l - 1) * 2 * CARRIERS + i];
+          b1 = ficBits[(l - 1) * 2 * CARRIERS + CARRIERS + i];
+        } else {
+          b0 = bit(rng);
+          b1 = bit(rng);
+        }
+        Z[(k + T_U) % T_U] *=
+            std::complex<float>(b0 ? -1 : 1, b1 ? -1 : 1) / sqrtf(2);
+      }
+    for (int i = 0; i < T_U; i++) v[i] = Z[i];
+    fft.do_IFFT();
+    for (int i = 0; i < T_G; i++) frame[out++] = v[T_U - T_G + i] / sqrtf(CARRIERS);
+    for (int i = 0; i < T_U; i++) frame[out++] = v[i] / sqrtf(CARRIERS);
+  }
+  frameCount++;
+  framePos = 0;
+}
+
+void syntheticSignal::getSamples(std::complex<float> *v, int32_t n) {
+  while (n > 0) {
+    if (framePos >= frameSize) generateFrame();
+    int32_t amount = std::min(n, frameSize - framePos);
+    memcpy(v, &frame[framePos], amount * sizeof(std::complex<float>));
+    framePos += amount;
+    v += amount;
+    n -= amount;
+  }
+}
+
+//
+//	The device. Paced, it delivers the samples in real time, and
+//	notifies the reader each msec.
+syntheticDevice::syntheticDevice(bool paced, int32_t seed)
+    : rng(seed), gauss(0, sqrtf(0.5)) {
+  this->paced = paced;
+  frequency.store(0);
+  running.store(false);
+  delivered.store(0);
+  startMark = 0;
+  doppler = 0;
+  pathDelay = 0;
+  pathGain = 0;
+  ppm = 0;
+  phase = 0;
+  loopPos = 0;
+  ticking.store(paced);
+  if (paced)
+    ticker = std::thread([this] {
+      while (ticking.load()) {
+        usleep(1000);
+        if (running.load()) notify();
+      }
+    });
+}
+
+syntheticDevice::~syntheticDevice(void) {
+  if (paced) {
+    ticking.store(false);
+    ticker.join();
+  }
+}
+
+void syntheticDevice::addTransmitter(int32_t frequency, syntheticSignal *s,
+                                     std::function<float(double)> snr) {
+  transmitters.push_back({frequency, s, snr});
+}
+
+void syntheticDevice::setFading(float doppler, int32_t delay, float gain) {
+  std::uniform_real_distribution<double> uniform(0, 2 * M_PI);
+  this->doppler = doppler;
+  pathDelay = delay;
+  pathGain = delay > 0 ? powf(10, gain / 20) : 0;
+  for (int p = 0; p < 2; p++) {
+    fadeFreq[p].clear();
+    fadePhase[p].clear();
+    for (int i = 0; i < 16; i++) {
+      fadeFreq[p].push_back(doppler * cos(uniform(rng)) / SAMPLE_RATE);
+      fadePhase[p].push_back(uniform(rng));
+    }
+  }
+}
+
+void syntheticDevice::setFrequencyError(float ppm) { this->ppm = ppm; }
+
+void syntheticDevice::loop(int32_t frames) {
+  loopBuffer.resize((size_t)frames * syntheticSignal::frameSize);
+  generate(loopBuffer.data(), loopBuffer.size());
+  loopPos = 0;
+}
+
+double syntheticDevice::signalTime(void) {
+  return delivered.load() / (double)SAMPLE_RATE;
+}
+
+//	Rayleigh fading, as a sum of sinusoids with random angles
+std::complex<float> syntheticDevice::fade(int path, int64_t n) {
+  std::complex<double> g = 0;
+  if (doppler == 0) return 1;
+  for (size_t i = 0; i < fadeFreq[path].size(); i++)
+    g += std::polar(1.0, 2 * M_PI * fadeFreq[path][i] * n + fadePhase[path][i]);
+  return std::complex<float>(g / sqrt((double)fadeFreq[path].size()));
+}
+
+//	the channel changes slowly compared to the sample rate, the
+//	fading is computed once per 64 samples
+void syntheticDevice::generate(std::complex<float> *v, int32_t n) {
+  const syntheticTransmitter *tx = nullptr;
+  int64_t now = delivered.load();
+  for (auto &t : transmitters)
+    if (t.frequency == frequency.load()) tx = &t;
+  if (tx != nullptr) {
+    float amplitude = powf(10, tx->snr(now / (double)SAMPLE_RATE) / 20);
+    std::vector<std::complex<float>> s(n);
+    tx->signal->getSamples(s.data(), n);
+    if ((doppler == 0) && (pathDelay == 0))
+      for (int i = 0; i < n; i++) v[i] = amplitude * s[i];
+    else {
+      float norm = amplitude / sqrtf(1 + pathGain * pathGain);
+      if ((int32_t)history.size() != pathDelay) history.assign(pathDelay, 0);
+      std::complex<float> h0 = 1, h1 = 1;
+      for (int i = 0; i < n; i++) {
+        if ((now + i) % 64 == 0 || i == 0) {
+          h0 = fade(0, now + i);
+          h1 = fade(1, now + i);
+        }
+        std::complex<float> x = h0 * s[i];
+        if (pathDelay > 0) {
+          x += pathGain * h1 * history[(now + i) % pathDelay];
+          history[(now + i) % pathDelay] = s[i];
+        }
+        v[i] = norm * x;
+      }
+    }
+    if (ppm != 0) {
+      double step = 2 * M_PI * ppm * 1e-6 * tx->frequency / SAMPLE_RATE;
+      for (int i = 0; i < n; i++) {
+        v[i] *= std::complex<float>(cos(phase), sin(phase));
+        phase = fmod(phase + step, 2 * M_PI);
+      }
+    }
+  } else
+    for (int i = 0; i < n; i++) v[i] = 0;
+  for (int i = 0; i < n; i++)
+    v[i] += std::complex<float>(gauss(rng), gauss(rng));
+}
+
+int32_t syntheticDevice::getSamples(std::complex<float> *v, int32_t n) {
+  n = std::min(n, Samples());
+  if (loopBuffer.empty())
+    generate(v, n);
+  else
+    for (int i = 0; i < n; i++) {
+      v[i] = loopBuffer[loopPos];
+      if (++loopPos >= loopBuffer.size()) loopPos = 0;
+    }
+  delivered.fetch_add(n);
+  return n;
+}
+
+//	paced, the samples are available as time goes by since the
+//	(last) start
+int32_t syntheticDevice::Samples(void) {
+  if (!running.load()) return 0;
+  if (!paced) return 1 << 20;
+  double elapsed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count();
+  int64_t available =
+      (int64_t)(elapsed * SAMPLE_RATE) - (delivered.load() - startMark);
+  return available < 0 ? 0 : available > (1 << 20) ? (1 << 20) : available;
+}
+
+bool syntheticDevice::restartReader(int32_t frequency) {
+  this->frequency.store(frequency);
+  if (!running.load()) {
+    startTime = std::chrono::steady_clock::now();
+    startMark = delivered.load();
+    running.store(true);
+  }
+  return true;
+}
+
+void syntheticDevice::stopReader(void) { running.store(false); }
+
+void syntheticDevice::resetBuffer(void) {}
@@ -0,0 +1,133 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#ifndef __SYNTHETIC_SIGNAL__
+#define __SYNTHETIC_SIGNAL__
+//
+//	The signals for dab-bench. A syntheticSignal is a Mode I
+//	ensemble: the FIC carries a FIG 0/0 and the FIGs added, with
+//	the real coding (CRC, energy dispersal, convolutional code and
+//	puncturing), the MSC carries random bits. The power of the
+//	signal is 1.
+//	The syntheticDevice tunes to the frequencies of the signals
+//	added, with white noise of power 1 - the level of a signal is
+//	its SNR - and optionally fading.
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+#include "device-handler.h"
+#include "fft_handler.h"
+#include "freq-interleaver.h"
+#include "phasetable.h"
+
+class syntheticSignal {
+ public:
+  syntheticSignal(uint16_t EId, int32_t seed);
+  ~syntheticSignal(void);
+  void addFig(const std::vector<uint8_t> &);
+  void getSamples(std::complex<float> *, int32_t);
+  //	the FIB - 32 bytes, CRC included - as transmitted in the CIF
+  //	with the given count, when the FIGs are sent in the order added
+  void makeFib(uint8_t *, int32_t cif);
+  static const int32_t frameSize = 196608;
+
+ private:
+  uint16_t EId;
+  std::mt19937 rng;
+  std::vector<std::vector<uint8_t>> figs;
+  size_t nextFig;
+  int32_t frameCount;
+  std::vector<std::complex<float>> frame;
+  int32_t framePos;
+  fft_handler fft;
+  interLeaver interleaver;
+  phaseTable phases;
+  std::vector<uint8_t> prbs;
+  std::vector<bool> puncture;
+  std::vector<uint8_t> ficBits;
+  void fillFib(uint8_t *, int32_t);
+  void encodeFic(void);
+  void generateFrame(void);
+};
+
+//	a signal on the air: its frequency, and its SNR (in dB) as a
+//	function of the time (in seconds) since the device started
+struct syntheticTransmitter {
+  int32_t frequency;
+  syntheticSignal *signal;
+  std::function<float(double)> snr;
+};
+
+class syntheticDevice : public deviceHandler {
+ public:
+  syntheticDevice(bool paced, int32_t seed);
+  ~syntheticDevice(void);
+  void addTransmitter(int32_t, syntheticSignal *, std::function<float(double)>);
+  //	flat fading with the given Doppler (Hz), optionally a second
+  //	path delayed by delay samples, gain in dB relative to the first
+  void setFading(float doppler, int32_t delay, float gain);
+  //	the frequency error of the "tuner", in ppm of the frequency
+  void setFrequencyError(float ppm);
+  //	from now on the given number of frames - generated once - is
+  //	repeated, such that generating costs nothing
+  void loop(int32_t frames);
+  double signalTime(void);
+  int32_t getSamples(std::complex<float> *, int32_t);
+  int32_t Samples(void);
+  bool restartReader(int32_t);
+  void stopReader(void);
+  void resetBuffer(void);
+
+ private:
+  bool paced;
+  std::mt19937 rng;
+  std::normal_distribution<float> gauss;
+  std::vector<syntheticTransmitter> transmitters;
+  std::atomic<int32_t> frequency;
+  std::atomic<bool> running;
+  std::atomic<int64_t> delivered;
+  std::chrono::steady_clock::time_point startTime;
+  int64_t startMark;
+  std::atomic<bool> ticking;
+  std::thread ticker;
+  //	fading: per path a sum of sinusoids
+  float doppler;
+  int32_t pathDelay;
+  float pathGain;
+  float ppm;
+  double phase;
+  std::vector<double> fadeFreq[2];
+  std::vector<double> fadePhase[2];
+  std::vector<std::complex<float>> history;
+  std::vector<std::complex<float>> loopBuffer;
+  size_t loopPos;
+  std::complex<float> fade(int, int64_t);
+  void generate(std::complex<float> *, int32_t);
+};
+
+#endif
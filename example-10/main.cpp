@@ -73,12 +73,8 @@ using std::endl;
 #include <unordered_map>
 #include <vector>
 
-#include "fibbits.h"
-#include "proc_fig0ext6.h"
-
 #define LOG_EX_TII_SPECTRUM 0
 #define MAX_EX_TII_BUFFER_SIZE 16
-#define FIB_PROCESSING_IN_MAIN 0
 #define PRINT_DBG_ALL_SERVICES 1
 #define CSV_PRINT_PROTECTION_COLS 0
 
@@ -259,6 +255,7 @@ static std::string ensembleAbbr;
 static uint32_t ensembleIdentifier = -1;
 
 static bool scanOnly = false;
+static bool bandScan = false;
 static int16_t minSNRtoExit = -32768;
 static deviceHandler *theDevice = nullptr;
 
@@ -350,6 +347,26 @@ static void ensembleIdHandler(int EId, void *userData) {
   ensembleIdentifier = (uint32_t)EId;
 }
 
+//
+//	with -L, each channel of the band is reported here
+static void bandScanHandler(const scanResult *r, void *handle, void *ctx) {
+  (void)ctx;
+  fprintf(infoStrm, "%-4s %7d kHz: ", r->channel, r->frequency / 1000);
+  if (!r->signalPresent) {
+    fprintf(infoStrm, "no signal\n");
+    return;
+  }
+  if (!r->ensembleFound) {
+    fprintf(infoStrm, "null depth %4.1f dB, no ensemble\n", r->nullDepth);
+    return;
+  }
+  fprintf(infoStrm, "null depth %4.1f dB, ensemble '%s' (EId %X), %d services\n",
+          r->nullDepth, r->ensembleName, (uint32_t)r->EId, r->nrServices);
+  for (int i = 0; i < r->nrServices; i++)
+    fprintf(infoStrm, "\t%X\t%s\n", (uint32_t)r->SId[i],
+            dab_getserviceName(handle, r->SId[i]).c_str());
+}
+
 static void programnameHandler(std::string s, std::string abbr, int SId, void *userdata) {
   fprintf(stderr, "programnameHandler: '%s' / '%s' (SId %X) is part of the ensemble\n",
           s.c_str(), abbr.c_str(), SId);
@@ -752,12 +769,6 @@ void printCollectedCallbackStat(const char *txt, int out) {
   }
 }
 
-void flush_fig_processings() {
-#if FIB_PROCESSING_IN_MAIN
-  flush_fig0_ext6();
-#endif
-}
-
 static bool repeater = false;
 
 void device_eof_callback(void *userData) {
@@ -770,44 +781,19 @@ void device_eof_callback(void *userData) {
       printCollectedErrorStat("End-of-File reached");
     }
 
-    flush_fig_processings();
     run.store(false);
     exit(30);
   }
 }
 
 static FILE *ficFile = NULL;
-static unsigned fibCallbackNo = 0;
 
+//	the service linking (FIG 0/6) and frequency information (FIG 0/21)
+//	are kept by the library, the FIBs are only needed for the file
 static void fib_dataHandler(const uint8_t *fib, int crc_ok, void *ud) {
   (void)crc_ok;
+  (void)ud;
   if (ficFile) fwrite(fib, 32, 1, ficFile);
-  ++fibCallbackNo;
-
-#if FIB_PROCESSING_IN_MAIN
-  if (!crc_ok) return;
-  const uint8_t *d = fib;
-  int processed = 0;
-  while (processed < 30) {
-    if (d[0] == 0xFF)  // end marker?
-      break;
-    const int FIGtype = getMax8Bits(3, 0, d);     // getBits_3 (d, 0);
-    const int FIGlen = getMax8Bits(5, 3, d) + 1;  // getBits_5 (d, 3) + 1;
-    switch (FIGtype) {
-      case 0: {
-        int extension = getMax8Bits(5, 8 + 3, d);  // getBits_5 (d, 8 + 3);  //
-                                                   // FIG0
-        if (extension == 6) proc_fig0_ext6(d + 1, FIGlen - 1, fibCallbackNo);
-        break;
-      }
-      case 1:
-      default:
-        break;
-    }
-    processed += FIGlen;
-    d = fib + processed;
-  }
-#endif
 }
 
 void allocateDevice(bool openDevice = false, int32_t frequency = 0,
@@ -951,7 +937,7 @@ int main(int argc, char **argv) {
 
   while (
       (opt = getopt(argc, argv,
-                    "W:A:M:B:P:p:T:S:E:cft:a:r:xO:w:n:" FILE_OPTS NON_FILE_OPTS
+                    "W:A:M:B:P:p:T:S:E:Lcft:a:r:xO:w:n:" FILE_OPTS NON_FILE_OPTS
                         RTLSDR_OPTS RTL_TCP_OPTS)) != -1) {
     fprintf(stderr, "opt = %c\n", opt);
     switch (opt) {
@@ -978,6 +964,12 @@ int main(int argc, char **argv) {
                 minSNRtoExit);
         break;
 
+      case 'L':
+        bandScan = true;
+        infoStrm = stdout;
+        fprintf(stderr, "read option -L : scan the band\n");
+        break;
+
       case 'c':
         printAsCSV = true;
         break;
@@ -1010,7 +1002,7 @@ int main(int argc, char **argv) {
 
       case 'M':
         theMode = atoi(optarg);
-        if (!((theMode == 1) || (theMode == 2) || (theMode == 4))) theMode = 1;
+        if (theMode > 4) theMode = 1;
         break;
 
       case 'B':
@@ -1141,6 +1133,16 @@ int main(int argc, char **argv) {
     exit(32);
   }
 
+  if (bandScan) {
+    int found = dab_scanBand(
+        theDevice, theMode, theBand, waitingTime,
+        waitingTime + (waitAfterEnsemble > 0 ? waitAfterEnsemble : 0),
+        nullptr, bandScanHandler, nullptr);
+    fprintf(stderr, "\n" FMT_DURATION "found %d ensembles\n" SINCE_START, found);
+    delete theDevice;
+    exit(found > 0 ? 0 : 22);
+  }
+
   //
   //	and with a sound device we now can create a "backend"
   theRadio =
@@ -1171,11 +1173,12 @@ int main(int argc, char **argv) {
 
   dab_setEId_handler(theRadio, ensembleIdHandler);
   dab_setError_handler(theRadio, decodeErrorReportHandler);
-  dab_setFIB_handler(theRadio, fib_dataHandler);
+  if (ficFile) dab_setFIB_handler(theRadio, fib_dataHandler);
 
   theDevice->setGain(theGain);
   if (autogain) theDevice->set_autogain(autogain);
   theDevice->restartReader(frequency);
+  dab_setFrequency(theRadio, frequency);
   //
   //	The device should be working right now
 
@@ -1412,7 +1415,6 @@ int main(int argc, char **argv) {
       if (useExTii) writeTiiExBuffer();
 #endif
     }
-    flush_fig_processings();
   } else {  // scan only
     uint64_t secsEpoch = msecs_progStart / 1000;
     bool gotECC = false;
@@ -1801,8 +1803,6 @@ int main(int argc, char **argv) {
   dabExit(theRadio);
   delete theDevice;
 
-  flush_fig_processings();
-
 #if PRINT_DURATION
   fprintf(stderr, "\n" FMT_DURATION "end of main()\n" SINCE_START);
 #endif
@@ -1821,13 +1821,15 @@ void printOptions(void) {
 	-A number   amount of time to look for an ensemble in %s\n\
 	-E minSNR   activates scan mode: if set, quit after loading scan data\n\
 	            also quit, if SNR is below minSNR\n\
+	-L          scan all channels of the band (see -B), -W and -A\n\
+	            limit the time spent on each channel with a signal\n\
 	-t number   determine tii every number frames. default is 10\n\
 	-a alfa     update tii spectral power with factor alfa in 0 to 1. default: 0.9\n\
 	-r number   reset tii spectral power every number frames. default: 10\n\
 	            tii statistics is output in scan mode\n\
 	-x          switch tii algorithm to extended one\n\
 	-c          activates CSV output mode\n\
-	-M Mode     Mode is 1, 2 or 4. Default is Mode 1\n\
+	-M Mode     Mode is 1, 2, 3 or 4, 0 detects the mode. Default is Mode 1\n\
 	-B Band     Band is either L_BAND or BAND_III (default)\n\
 	-P name     program to be selected in the ensemble\n\
 	-p ppmCorr  ppm correction\n\
@@ -44,7 +44,7 @@ class audioBackend : public virtualBackend {
                void *);
   ~audioBackend(void);
   virtual void setError_handler(decodeErrorReport_t err_Handler);
-  int32_t process(int16_t *, int16_t);
+  int32_t process(const int16_t *const *, int16_t);
   void stopRunning(void);
   void start(void);
 
@@ -61,10 +61,6 @@ class audioBackend : public virtualBackend {
   int16_t protLevel;
   std::vector<uint8_t> outV;
   std::vector<uint8_t> disperseVector;
-  int16_t **interleaveData;
-  int16_t interleaverIndex;
-  int16_t countforInterleaver;
-  std::vector<int16_t> tempX;
 
   Semaphore freeSlots;
   Semaphore usedSlots;
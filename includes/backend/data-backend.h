@@ -41,7 +41,7 @@ class dataBackend : public virtualBackend {
   dataBackend(packetdata *, bytesOut_t bytesOut, motdata_t motdataHandler,
               void *userData);
   ~dataBackend(void);
-  int32_t process(int16_t *, int16_t);
+  int32_t process(const int16_t *const *, int16_t);
   void stopRunning(void);
   void start(void);
 
@@ -58,12 +58,8 @@ class dataBackend : public virtualBackend {
   void run(void);
   std::atomic<bool> running;
   std::thread threadHandle;
-  int16_t interleaverIndex;
-  int16_t countforInterleaver;
   std::vector<uint8_t> outV;
-  std::vector<int16_t> tempX;
   std::vector<uint8_t> disperseVector;
-  int16_t **interleaveData;
   Semaphore freeSlots;
   Semaphore usedSlots;
 
@@ -30,9 +30,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <thread>
 #include <vector>
+#include "channel-estimator.h"
 #include "dab-api.h"
 #include "dab-constants.h"
 #include "dab-params.h"
@@ -49,18 +51,33 @@ class mscHandler {
              motdata_t, void *);
   ~mscHandler(void);
   void setError_handler(decodeErrorReport_t err_Handler);
-  void process_mscBlock(std::complex<float> *, int16_t);
+  void process_mscBlock(std::complex<float> *, int16_t, int32_t);
   void set_audioChannel(audiodata *);
   void set_dataChannel(packetdata *);
+  int32_t set_audioChannel(audiodata *, const serviceSink *);
+  int32_t set_dataChannel(packetdata *, const serviceSink *);
+  bool remove_channel(int32_t);
+  bool replace_audioChannel(int32_t, audiodata *, const serviceSink *);
+  void get_defaultSink(serviceSink *);
   void reset(void);
   void stop(void);
   void start(void);
+  void set_instantSwitch(bool);
+  void signal_frameGap(void);
+  void set_mode(uint8_t);
+  void set_coherent(bool);
 
  private:
   virtual void run(void);
   void process_mscBlock(std::vector<int16_t>, int16_t);
+  int32_t add_backend(virtualBackend *, const serviceSink *);
+  void prepare_backend(virtualBackend *, const serviceSink *, int32_t);
+  void lockList(std::unique_lock<std::mutex> &);
+  void publish(std::unique_lock<std::mutex> &, std::vector<virtualBackend *> &);
   dabParams params;
-  fft_handler my_fftHandler;
+  fft_handler *my_fftHandler;
+  channelEstimator *myEstimator;
+  std::atomic<bool> coherent;
   interLeaver myMapper;
   audioOut_t soundOut;
   dataOut_t dataOut;
@@ -71,20 +88,45 @@ class mscHandler {
   void *userData;
   Semaphore freeSlots;
   Semaphore usedSlots;
+  //	the slots are used in turn, each one carries the number of
+  //	its block, such that the msc thread follows the processor
+  //	when a frame was cut short
   std::complex<float> **theData;
+  std::vector<int16_t> theBlock;
+  std::vector<int32_t> theDamage;
+  //	set in the slot of block 0 when frames were lost before it
+  std::vector<uint8_t> theGap;
+  int16_t inSlot;
   std::atomic<bool> running;
 
   std::thread threadHandle;
   std::vector<complex<float> > phaseReference;
   bool audioService;
+  //	the list of backends is double buffered: the dispatcher
+  //	reads backendList [activeList] without locking, changes are
+  //	made - under mutexer - in the other one, and published
   std::mutex mutexer;
-  std::vector<virtualBackend *> theBackends;
-  //	std::vector<int16_t> cifVector;
+  //	signalled when a dispatch ends while a publisher waits for it
+  std::condition_variable dispatchDone;
+  std::atomic<bool> publishWaiting;
+  bool publishing;
+  std::vector<virtualBackend *> backendList[2];
+  std::atomic<int> activeList;
+  std::atomic<uint32_t> dispatchSeq;
+  int32_t nextHandle;
+  //	the last 16 CIFs, shared by all backends for deinterleaving
+  int16_t *cifRing[16];
+  int16_t cifIndex;
+  //	number of consecutive valid CIFs in the ring (max 16)
+  std::atomic<int16_t> cifValid;
+  std::atomic<bool> instantSwitch;
+  std::atomic<bool> frameGap;
   int16_t cifCount;
   int16_t blkCount;
   std::atomic<bool> work_to_do;
   int16_t BitsperBlock;
   int16_t numberofblocksperCIF;
+  int16_t firstMSCblock;
   int16_t blockCount;
 };
 
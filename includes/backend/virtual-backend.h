@@ -35,14 +35,23 @@ class virtualBackend {
   virtualBackend(int16_t, int16_t);
   virtual ~virtualBackend(void);
   virtual void setError_handler(decodeErrorReport_t err_Handler);
-  virtual int32_t process(int16_t *, int16_t);
+  virtual int32_t process(const int16_t *const *, int16_t);
   virtual void stopRunning(void);
   virtual void stop(void);
   int16_t startAddr(void);
   int16_t Length(void);
+  void set_interleaverFilled(void);
+  void set_handle(int32_t);
+  int32_t get_handle(void);
+  void set_sharedContext(bool);
+  bool sharedContext(void);
 
  protected:
+  void deinterleave(const int16_t *const *, int16_t, int16_t *);
   int16_t startAddress;
   int16_t segmentLength;
+  int16_t countforInterleaver;
+  int32_t handle;
+  bool shared;
 };
 #endif
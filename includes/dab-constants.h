@@ -77,6 +77,8 @@ using namespace std;
 
 #define DIFF_LENGTH 42
 #define THRESHOLD 3
+//	the range (in KHz) of the wide coarse frequency acquisition
+#define ACQUIRE_RANGE 250
 
 static inline bool isIndeterminate(float x) { return x != x; }
 
@@ -105,6 +107,16 @@ static inline float jan_abs(std::complex<float> z) {
   float im = imag(z);
   return (re < 0 ? -re : re) + (im < 0 ? -im : im);
 }
+
+//
+//	The soft bits of a block with samples blanked or clipped - by
+//	the sampleReader - are weighted down, with half of the
+//	samples damaged they are erased (made 0), the Viterbi decoder
+//	then ignores them
+static inline float erasureWeight(int32_t damaged, int32_t T_u) {
+  float w = 1 - 2.0F * damaged / T_u;
+  return w < 0 ? 0 : w;
+}
 //
 
 //	These are defined elsewhere
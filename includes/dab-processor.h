@@ -27,12 +27,16 @@
  */
 #include <stdint.h>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 #include <vector>
 #include "dab-api.h"
 #include "dab-constants.h"
+#include "afc-model.h"
 #include "dab-params.h"
 #include "fic-handler.h"
+#include "mode-detector.h"
 #include "msc-handler.h"
 #include "ofdm-decoder.h"
 #include "phasereference.h"
@@ -41,6 +45,7 @@
 #include "tii_detector.h"
 //
 class deviceHandler;
+class ensembleCache;
 
 class dabProcessor {
  public:
@@ -72,13 +77,44 @@ class dabProcessor {
   void printAll_metaInfo(FILE *out);
   void set_audioChannel(audiodata *);
   void set_dataChannel(packetdata *);
+  int32_t set_audioChannel(audiodata *, const serviceSink *);
+  int32_t set_dataChannel(packetdata *, const serviceSink *);
+  bool remove_channel(int32_t);
+  int decodeAll(sinkFactory_t, void *);
+  std::vector<int32_t> serviceIds(void);
   std::string get_ensembleName();
   void clearEnsemble();
   void reset_msc();
+  bool retune(int32_t);
+  bool switch_channel(int32_t, fib_processor *, bool, float);
+  uint32_t get_frameCount(void);
+  float get_offset(void);
+  int16_t get_snr(void);
+  int16_t get_ficQuality(void);
+  int32_t get_frequency(void);
+  int32_t get_EId(bool *);
+  void get_defaultSink(serviceSink *);
+  float get_clockOffset(void);
+  void set_instantSwitch(bool);
+  void set_ficOnly(bool);
+  void set_guardSync(bool);
+  void set_coherent(bool);
+  void set_cache(ensembleCache *, int32_t);
+  int32_t preload_audioService(int32_t, const serviceSink *);
+  bool cache_ensemble(void);
+  void set_frequency(int32_t);
+  void get_afcState(afcState *);
+  void set_afcState(const afcState *);
 
   void setTII_handler(tii_t tii_Handler, tii_ex_t tii_ExHandler,
                       int tii_framedelay, float alfa, int resetFrameCount);
   void setEId_handler(ensembleid_t EId_Handler);
+  void setChange_handler(ensembleChange_t change_Handler);
+  uint32_t get_generation(void);
+  std::vector<int32_t> frequenciesFor(int32_t);
+  std::vector<int32_t> ensemblesFor(int32_t);
+  std::vector<int32_t> linkedServices(int32_t);
+  int16_t get_mode(void);
   void setError_handler(decodeErrorReport_t err_Handler);
   void setFIB_handler(fibdata_t fib_Handler);
 
@@ -101,9 +137,12 @@ class dabProcessor {
   deviceHandler *inputDevice;
   dabParams params;
   sampleReader myReader;
-  phaseReference phaseSynchronizer;
-  TII_Detector my_TII_Detector;
-  ofdmDecoder my_ofdmDecoder;
+  RingBuffer<std::complex<float>> *iqBuffer;
+  //	the mode dependent parts of the DSP chain, recreated
+  //	by the processing thread when another mode is detected
+  phaseReference *phaseSynchronizer;
+  TII_Detector *my_TII_Detector;
+  ofdmDecoder *my_ofdmDecoder;
   ficHandler my_ficHandler;
   mscHandler my_mscHandler;
   syncsignal_t syncsignalHandler;
@@ -113,7 +152,53 @@ class dabProcessor {
   std::thread threadHandle;
   void *userData;
   std::atomic<bool> running;
+  std::atomic<bool> ficOnly;
+  std::atomic<bool> guardSync;
+  std::atomic<bool> coherent;
+  std::mutex retuneLock;
+  std::condition_variable retuneSignal;
+  bool parked;
+  void park(std::unique_lock<std::mutex> &);
+  void unpark(void);
+  void wait_forRetune(void);
+  //	services selected from the cache, until confirmed by the FIC
+  struct preloadedService {
+    int32_t SId;
+    int32_t handle;
+    int32_t EId;
+    audiodata ad;
+    serviceSink sink;
+  };
+  ensembleCache *theCache;
+  int32_t cacheFrequency;
+  std::mutex cacheLock;
+  std::vector<preloadedService> preloaded;
+  std::atomic<bool> checkCache;
+  void check_cache(void);
+  //	the checks are done by a thread of their own, replacing a
+  //	backend waits for the msc thread
+  std::thread cacheThread;
+  std::mutex cacheWakeLock;
+  std::condition_variable cacheWake;
+  bool cacheRequest;
+  void run_cacheCheck(void);
+  //	the frequency error of the device, learned while locked
+  afcModel theAFC;
+  std::atomic<int32_t> tunedFrequency;
+  //	the offset to start with after a switch of channel
+  bool haveOffsetHint;
+  float offsetHint;
+  float startOffset(void);
+  std::atomic<uint32_t> frameCount;
+  std::atomic<float> lockedOffset;
+  std::atomic<int16_t> frameSnr;
+  std::atomic<float> clockOffset;
   bool isSynced;
+  bool autoMode;
+  std::atomic<int16_t> currentMode;
+  modeDetector myModeDetector;
+  void setup_mode(uint8_t);
+  uint8_t detect_mode(float);
   int32_t T_null;
   int32_t T_u;
   int32_t T_s;
@@ -122,6 +207,7 @@ class dabProcessor {
   int32_t nrBlocks;
   int32_t carriers;
   int32_t carrierDiff;
+  int32_t ficSymbols;
 
   bool wasSecond(int16_t, dabParams *);
 
@@ -0,0 +1,66 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#ifndef __CHANNEL_ESTIMATOR__
+#define __CHANNEL_ESTIMATOR__
+
+#include <stdint.h>
+#include <complex>
+#include <vector>
+#include "dab-constants.h"
+#include "dab-params.h"
+#include "freq-interleaver.h"
+
+//
+//	The channelEstimator is the alternative for the differential
+//	demodulation: the channel is estimated per carrier from the
+//	phase reference symbol (block 0), and tracked over the blocks
+//	of the frame with the decided symbols. The phase difference is
+//	then taken against the decided symbol of the previous block
+//	rather than against the noisy carrier itself
+class channelEstimator {
+ public:
+  channelEstimator(uint8_t dabMode);
+  ~channelEstimator(void);
+  void start(const std::complex<float> *);
+  void demap(const std::complex<float> *, int16_t *);
+
+ private:
+  void update(std::complex<float>, float);
+  dabParams params;
+  interLeaver myMapper;
+  int32_t T_u;
+  int32_t carriers;
+  //	per carrier, from the lowest to the highest frequency
+  std::vector<int32_t> fftIndex;
+  std::vector<int32_t> bitIndex;
+  std::vector<std::complex<float>> reference;
+  std::vector<std::complex<float>> estimate;
+  std::vector<std::complex<float>> raw;
+  std::vector<std::complex<float>> previous;
+  std::vector<std::complex<float>> phaseDiff;
+  std::vector<float> margin;
+  float power;
+};
+
+#endif
@@ -28,8 +28,13 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "dab-api.h"
 #include "dab-constants.h"
 #include "tii_table.h"
@@ -177,6 +182,60 @@ struct channelMap {
   int16_t FEC_scheme;
 };
 
+//	from FIG 0/6, the services - DAB, RDS or DRM/AMSS - carrying
+//	the same program. A linkage set is identified by its LSN
+struct linkedId {
+  uint8_t IdLQ;  // 0: DAB SId, 1: RDS PI, 3: DRM/AMSS service id
+  uint8_t ecc;   // for the international ids (ILS), 0 otherwise
+  uint32_t id;
+};
+
+struct linkageSet {
+  uint16_t LSN;
+  bool active;         // LA
+  bool hard;           // S/H
+  bool international;  // ILS
+  std::vector<linkedId> ids;
+};
+
+//	from FIG 0/21, the frequencies (in KHz) of an ensemble (R&M 0,
+//	the id is the EId) or of a FM or AM service (the id is the PI)
+struct frequencyList {
+  uint16_t id;
+  uint8_t RandM;
+  bool continuity;
+  bool otherEnsemble;
+  std::vector<int32_t> frequencies;
+};
+
+//
+//	The API does not look into the tables above, these are
+//	changed all the time by the FIC thread. It sees an immutable
+//	snapshot, with the data of the components already resolved,
+//	which is replaced whenever the tables changed
+struct fibComponent {
+  int16_t componentNr;
+  int8_t TMid;
+  audiodata ad;   // TMid == 0
+  packetdata pd;  // TMid == 3
+};
+
+struct fibService {
+  int32_t SId;
+  std::string label;
+  std::vector<fibComponent> components;
+};
+
+struct fibSnapshot {
+  uint32_t generation;  // of the database the snapshot was taken from
+  std::vector<fibService> services;  // with a name, in the order found
+  std::unordered_map<int32_t, int32_t> bySId;
+  std::unordered_map<std::string, int32_t> byLabel;  // trailing spaces removed
+  std::map<uint16_t, linkageSet> linkage;         // by LSN
+  std::map<uint32_t, frequencyList> frequencies;  // by (R&M << 16) | id
+  std::unordered_map<int32_t, std::vector<int32_t>> otherEnsembles;  // by SId
+};
+
 class fib_processor {
  public:
   fib_processor(ensemblename_t, programname_t, void *);
@@ -186,6 +245,7 @@ class fib_processor {
   void clearEnsemble(void);
   bool syncReached(void);
   std::string nameFor(int32_t);
+  std::vector<int32_t> serviceIds(void);
   int32_t SIdFor(std::string &);
   uint8_t kindofService(std::string &);
   uint8_t kindofService(int32_t SId);
@@ -199,9 +259,11 @@ class fib_processor {
   void printAll_metaInfo(FILE *out);
 
   void reset(void);
+  void revisit(void);
   int32_t get_CIFcount(void) const;
   bool has_CIFcount(void) const;
   void newFrame(void);
+  void publishSnapshot(void);
 
   //	Extended functions, contributed by Hayati Ayguen
   std::complex<float> get_coordinates(int16_t, int16_t, bool *,
@@ -209,11 +271,20 @@ class fib_processor {
                                       int16_t *pTD);
   uint8_t getECC(bool *);
   uint8_t getInterTabId(bool *);
+  int32_t get_EId(bool *);
 
   void setEId_handler(ensembleid_t EId_Handler);
+  void setChange_handler(ensembleChange_t change_Handler);
+  uint32_t get_generation(void);
+
+  //	service linking and frequency information, from the snapshot
+  std::vector<int32_t> frequenciesFor(int32_t EId);
+  std::vector<int32_t> ensemblesFor(int32_t SId);
+  std::vector<int32_t> linkedServices(int32_t SId);
 
  private:
   ensembleid_t ensembleidHandler;
+  ensembleChange_t changeHandler;
   ensemblename_t ensemblenameHandler;
   programname_t programnameHandler;
   void *userData;
@@ -221,12 +292,18 @@ class fib_processor {
   serviceComponent *find_packetComponent(int16_t SubChId, int16_t SCId);
   serviceComponent *find_serviceComponent(int32_t SId, int16_t SCId);
   serviceComponent *find_serviceComponentNr(int32_t SId, int16_t componentNr);
-  serviceId *findServiceId(std::string, bool fullMatchOnly = false);
 
   void bind_audioService(int8_t, uint32_t, int16_t, int16_t, int16_t, int16_t);
   void bind_packetService(int8_t, uint32_t, int16_t, int16_t, int16_t, int16_t);
-  void dataforAudioService(serviceId *selectedService, audiodata *, int16_t);
-  void dataforDataService(serviceId *selectedService, packetdata *, int16_t);
+  void fill_audioData(const serviceId *, const serviceComponent *, audiodata *);
+  void fill_packetData(const serviceComponent *, packetdata *);
+  std::shared_ptr<const fibSnapshot> snapshot(void) const;
+  void buildSnapshot(void);
+  void noteChange(void);
+  void noteChange(int16_t, int32_t);
+  bool seenFIG(const uint8_t *, int16_t *, uint64_t *);
+  void rememberFIG(int16_t, uint64_t);
+  void forgetFIGs(void);
 
   std::atomic<int32_t> CIFcount;
   std::atomic<bool> hasCIFcount;
@@ -264,18 +341,51 @@ class fib_processor {
   int16_t HandleFIG0Extension2(const uint8_t *, int16_t, uint8_t, uint8_t, uint8_t);
   int16_t HandleFIG0Extension3(const uint8_t *, int16_t, uint8_t, uint8_t, uint8_t);
   int16_t HandleFIG0Extension5(const uint8_t *, uint8_t, uint8_t, uint8_t, int16_t);
+  int16_t HandleFIG0Extension6(const uint8_t *, int16_t, int16_t, uint8_t, uint8_t);
   int16_t HandleFIG0Extension8(const uint8_t *, int16_t, uint8_t, uint8_t, uint8_t);
   int16_t HandleFIG0Extension13(const uint8_t *, int16_t, uint8_t, uint8_t, uint8_t);
   int16_t HandleFIG0Extension21(const uint8_t *, uint8_t, uint8_t, uint8_t, int16_t);
   int16_t HandleFIG0Extension22(const uint8_t *, uint8_t, uint8_t, uint8_t, int16_t);
+  int16_t HandleFIG0Extension24(const uint8_t *, int16_t, int16_t, uint8_t);
+  void addFrequencies(uint16_t, uint8_t, bool, bool, const std::vector<int32_t> &);
 
   bool FIG0processingOutput[32];
   uint8_t FIBrawCompressed[32];
 
   int32_t dateTime[8];
   channelMap subChannels[64];
-  serviceComponent ServiceComps[64];
-  serviceId listofServices[64+1];
+  //	deques, since the components refer to their service, and
+  //	the indices refer to both
+  std::deque<serviceComponent> ServiceComps;
+  std::deque<serviceId> listofServices;
+  std::unordered_map<int32_t, serviceId *> serviceIndex;
+  std::unordered_map<int32_t, std::vector<serviceComponent *>> componentIndex;
+  std::unordered_map<int16_t, serviceComponent *> packetIndex;
+  //	FIG 0/6, 0/21 and 0/24 are repeated - and extended - in
+  //	pieces, what is learned is merged into these
+  std::map<uint16_t, linkageSet> linkageSets;
+  std::map<uint32_t, frequencyList> frequencyLists;
+  std::unordered_map<int32_t, std::vector<int32_t>> oeServices;
+  std::shared_ptr<const fibSnapshot> currentSnapshot;
+  bool dirty;
+  //
+  //	Each change of the tables above increments the generation.
+  //	The FIGs repeat all the time, a FIG that was processed
+  //	before without changing anything is recognized by its
+  //	hash, and skipped, until something changes
+  uint32_t generation;
+  struct fibChange {
+    uint32_t generation;
+    int16_t kind;
+    int32_t id;
+  };
+  std::vector<fibChange> pendingChanges;
+#define FIG_KEYS (32 + 8)  // FIG 0/0 .. 0/31, FIG 1/0 .. 1/7
+#define FIG_HISTORY 64
+  uint64_t figHashes[FIG_KEYS][FIG_HISTORY];
+  int16_t figFill[FIG_KEYS];
+  int16_t figNext[FIG_KEYS];
+  std::string ensembleLabel;
   tii_table coordinates;
 
   std::atomic<uint8_t> ecc_byte;
@@ -286,6 +396,8 @@ class fib_processor {
   bool firstTimeEName;
   std::atomic<bool> ecc_Present;
   std::atomic<bool> interTab_Present;
+  std::atomic<int32_t> ensembleId;
+  std::atomic<bool> ensembleId_Present;
 
   bool isSynced;
   mutex fibLocker;
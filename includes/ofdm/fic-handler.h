@@ -28,23 +28,54 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include "dab-api.h"
 #include "dab-params.h"
 #include "fib-decoder.h"
+#include "semaphore.h"
 #include "viterbi-handler.h"
 
-class ficHandler : public viterbiHandler {
+//	The FIC is coded in codewords of 3 FIBs (Mode I, II and IV) or
+//	4 FIBs (Mode III), the sizes below are for the largest one
+#define FIC_MAXFIBS 4
+//	the codewords of a frame (4 in Mode I) are decoded in parallel,
+//	there is room for the codewords of two frames
+#define FIC_WORKERS 4
+#define FIC_JOBS 8
+//	the agreement of random soft bits with the path found
+#define FIC_NOISEFLOOR 0.69
+
+//	a codeword, from the soft bits to the bits of its FIBs
+struct ficJob {
+  int16_t ficno;
+  bool first;  // the first codeword of a frame
+  bool last;   // the last codeword of a frame
+  bool done;
+  //	the metric of the path found by the viterbi decoder, and
+  //	the sum of the magnitudes of the soft bits
+  int32_t metric;
+  int32_t magnitude;
+  int16_t softBits[FIC_MAXFIBS * 768];
+  uint8_t bits[FIC_MAXFIBS * 256];
+};
+
+class ficHandler {
  public:
   ficHandler(uint8_t,  // dabMode
              ensemblename_t, programname_t, fib_quality_t, void *);
   ~ficHandler(void);
-  void process_ficBlock(std::vector<int16_t>, int16_t);
+  void set_mode(uint8_t);
+  void process_ficBlock(const int16_t *, int32_t, int16_t);
   void clearEnsemble(void);
   bool syncReached(void);
+  int16_t get_ficQuality(void);
   std::string nameFor(int32_t);
+  std::vector<int32_t> serviceIds(void);
   int32_t SIdFor(std::string &);
   uint8_t kindofService(std::string &);
   uint8_t kindofService(int SId);
@@ -62,10 +93,17 @@ class ficHandler : public viterbiHandler {
                                       int16_t *pMainId, int16_t *,
                                       int16_t *pTD);
   void reset(void);
+  void set_database(fib_processor *);
   uint8_t getECC(bool *);
   uint8_t getInterTabId(bool *);
+  int32_t get_EId(bool *);
 
   void setEId_handler(ensembleid_t EId_Handler);
+  void setChange_handler(ensembleChange_t change_Handler);
+  uint32_t get_generation(void);
+  std::vector<int32_t> frequenciesFor(int32_t);
+  std::vector<int32_t> ensemblesFor(int32_t);
+  std::vector<int32_t> linkedServices(int32_t);
   void setError_handler(decodeErrorReport_t err_Handler);
   void setFIB_handler(fibdata_t fib_Handler);
 
@@ -75,18 +113,48 @@ class ficHandler : public viterbiHandler {
   decodeErrorReport_t errorReportHandler;
   fibdata_t fib_dataHandler;
   void *userData;
-  void process_ficInput(int16_t);
-  uint8_t bitBuffer_out[768];
-  int16_t ofdm_input[2304];
-  bool punctureTable[4 * 768 + 24];
+  void submit(bool);
+  void worker(int16_t);
+  void decode(ficJob *, int16_t);
+  void process_fibs(ficJob *);
+  void drain(void);
+  viterbiHandler *viterbi[FIC_WORKERS];
+  //	the depunctured codeword, per worker
+  int16_t viterbiBlock[FIC_WORKERS][FIC_MAXFIBS * 1024 + 24];
+  int16_t ofdm_input[FIC_MAXFIBS * 768];
+  bool punctureTable[FIC_MAXFIBS * 1024 + 24];
 
   int16_t index;
   int16_t BitsperBlock;
+  int16_t fibsperCodeword;
   int16_t ficno;
-  mutable mutex fibProtector;
-  fib_processor fibProcessor;
-  uint8_t PRBS[768];
+  bool frameStart;
+  //	the jobs are filled in order by the thread delivering the
+  //	FIC blocks, taken in order by the workers, and their FIBs are
+  //	processed in order, by the worker that completes the job
+  //	that is next in line
+  ficJob jobs[FIC_JOBS];
+  int16_t jobIn;
+  std::atomic<uint32_t> jobNext;
+  int16_t jobOut;
+  int16_t pending;
+  Semaphore freeJobs;
+  Semaphore usedJobs;
+  std::mutex orderLock;
+  std::condition_variable idle;
+  std::atomic<bool> running;
+  std::thread workers[FIC_WORKERS];
+  fib_processor ownProcessor;
+  std::atomic<fib_processor *> fibProcessor;
+  fib_processor *database(void) const { return fibProcessor.load(); }
+  uint8_t PRBS[FIC_MAXFIBS * 256];
   uint8_t shiftRegister[9];
+  //	the soft decision quality of the last frame, -1 if not known
+  int64_t frameMetric;
+  int64_t frameMagnitude;
+  std::atomic<int16_t> ficQuality;
+  int16_t crcGood;
+  int16_t crcCount;
   void show_ficCRC(bool);
 };
 
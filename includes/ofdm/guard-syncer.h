@@ -0,0 +1,60 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#ifndef __GUARD_SYNCER__
+#define __GUARD_SYNCER__
+
+#include <vector>
+#include "dab-constants.h"
+#include "dab-params.h"
+#include "timesyncer.h"
+
+class sampleReader;
+
+//
+//	The guardSyncer is an alternative for the timeSyncer, it does
+//	not look at the envelope of the signal. The correlation between
+//	the guard interval of the symbols and the end of their useful
+//	part gives the symbol timing and the frequency offset within a
+//	carrier, the null symbol is then the symbol without that
+//	correlation. Since the correlation is normalized, it does not
+//	depend on the level of the signal, a fading signal does not
+//	disturb it.
+//	sync returns the same values as the timeSyncer, on success
+//	the next sample read is the first sample of block 0 and offset
+//	tells the (remaining) frequency offset in Hz
+class guardSyncer {
+ public:
+  guardSyncer(sampleReader *mr);
+  ~guardSyncer();
+  int sync(dabParams *, int32_t phase, float *offset);
+
+ private:
+  sampleReader *myReader;
+  std::vector<std::complex<float>> buffer;
+  std::vector<float> prodRe;
+  std::vector<float> prodIm;
+  std::vector<float> power;
+  float slotCorrelation(const std::complex<float> *, int32_t, int32_t);
+};
+#endif
@@ -0,0 +1,57 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#ifndef __MODE_DETECTOR__
+#define __MODE_DETECTOR__
+
+#include <stdint.h>
+#include <complex>
+#include <vector>
+#include "dab-params.h"
+
+//
+//	The modeDetector tells - from a stretch of samples - the
+//	transmission mode of the ensemble, or 0 if it cannot tell.
+//	Two observations are combined:
+//	a. the distance between the null symbols (the frame length)
+//	   and the length of a null symbol,
+//	b. the correlation between the guard interval of the symbols
+//	   and the end of their useful part, for each candidate T_u.
+//	The first one selects the candidates - if there is a clear
+//	null symbol at all -, the second one decides. The correlation
+//	does not depend on the frequency offset, so detection can
+//	precede any synchronization
+class modeDetector {
+ public:
+  modeDetector(void);
+  ~modeDetector(void);
+  static int32_t bufferSize(void);
+  uint8_t detect(const std::complex<float> *, int32_t);
+
+ private:
+  void nullVotes(const std::complex<float> *, int32_t, int16_t *);
+  float guardScore(const std::complex<float> *, int32_t, dabParams &);
+  std::vector<float> envelope;
+};
+
+#endif
@@ -25,6 +25,7 @@
 #include <stdint.h>
 #include <atomic>
 #include <vector>
+#include "channel-estimator.h"
 #include "dab-constants.h"
 #include "fft_handler.h"
 #include "freq-interleaver.h"
@@ -38,13 +39,18 @@ class ofdmDecoder {
   ofdmDecoder(uint8_t dabMode, RingBuffer<std::complex<float>> *);
   ~ofdmDecoder(void);
   void processBlock_0(std::complex<float> *);
-  void decode(std::complex<float> *, int32_t n, int16_t *);
+  void decode(std::complex<float> *, int32_t n, int16_t *, int32_t);
   int16_t get_snr(void);
+  float get_clockOffset(bool *);
+  void set_coherent(bool);
 
  private:
   dabParams params;
   fft_handler my_fftHandler;
   interLeaver myMapper;
+  channelEstimator myEstimator;
+  std::atomic<bool> coherent;
+  bool coherentFrame;
   int16_t get_snr(std::complex<float> *);
   RingBuffer<std::complex<float>> *iqBuffer;
   int cnt;
@@ -58,6 +64,11 @@ class ofdmDecoder {
   std::complex<float> *fft_buffer;
   int32_t blockIndex;
   float current_snr;
+  //	for the clock offset: the (4th power of the) phase differences
+  //	summed per quarter of the carriers, from low to high, and
+  //	the sum of their magnitudes
+  std::complex<float> clockSums[4];
+  float clockWeight;
 };
 
 #endif
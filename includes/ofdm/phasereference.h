@@ -37,6 +37,7 @@ class phaseReference : public phaseTable {
   ~phaseReference();
   int32_t findIndex(const std::complex<float> *);
   int16_t estimateOffset(const std::complex<float> *);
+  int16_t acquireOffset(const std::complex<float> *, bool *);
 
  private:
   std::vector<std::complex<float>> refTable;
@@ -45,6 +46,13 @@ class phaseReference : public phaseTable {
   int32_t T_u;
   int16_t threshold;
   int16_t diff_length;
+  //	for the wide range acquisition: the phase differences of the
+  //	reference, and of the measured spectrum, as separate I and Q
+  int16_t acquireRange;
+  std::vector<float> refDiffRe;
+  std::vector<float> refDiffIm;
+  std::vector<float> diffRe;
+  std::vector<float> diffIm;
 
   fft_handler my_fftHandler;
 };
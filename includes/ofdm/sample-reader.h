@@ -35,6 +35,10 @@
 
 class deviceHandler;
 class dabProcessor;
+//
+//	values thrown by getSample(s)
+#define READER_STOPPED 20
+#define READER_INTERRUPTED 22
 
 class sampleReader {
  public:
@@ -43,24 +47,50 @@ class sampleReader {
 
   ~sampleReader();
   void setRunning(bool b);
+  void interrupt(bool b);
   float get_sLevel();
   std::complex<float> getSample(int32_t);
   void getSamples(std::complex<float> *v, int32_t n, int32_t phase);
+  void skipSamples(int32_t n, int32_t phase);
+  void set_clockOffset(float);
+  void flush(void);
+  int32_t get_damaged(void);
 
  private:
   dabProcessor *theParent;
   deviceHandler *theRig;
   RingBuffer<std::complex<float>> *spectrumBuffer;
   std::vector<std::complex<float>> localBuffer;
+  std::vector<std::complex<float>> skipBuffer;
   int32_t localCounter;
   int32_t bufferSize;
   int32_t currentPhase;
   std::complex<float> *oscillatorTable;
   std::atomic<bool> running;
+  std::atomic<bool> interrupted;
   int32_t bufferContent;
   float sLevel;
   int32_t sampleCount;
   int32_t corrector;
+  void waitFor(int32_t);
+  int32_t fetch(std::complex<float> *, int32_t);
+  //	the resampler, compensating the offset (in ppm) of the
+  //	sample clock of the device. Once switched on, it stays on
+  float clockOffset;
+  bool resampling;
+  double resamplePos;
+  std::vector<std::complex<float>> inBuffer;
+  int32_t inFill;
+  std::vector<int32_t> inIndex;
+  std::vector<float> inMu;
+  int32_t resample(std::complex<float> *, int32_t);
+  //	the impulse blanker, damaged is the number of samples
+  //	blanked - or clipped - by the last getSamples
+  float blankLevel;
+  float clipPeak;
+  float clipRate;
+  int32_t damaged;
+  void blank(std::complex<float> *, int32_t);
 };
 
 #endif
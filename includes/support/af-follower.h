@@ -0,0 +1,112 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#ifndef __AF_FOLLOWER__
+#define __AF_FOLLOWER__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dab-api.h"
+
+class dabProcessor;
+class ensembleCache;
+class fib_processor;
+
+//
+//	The afFollower keeps a service going when the reception gets
+//	bad, by moving it to another frequency carrying it: another
+//	transmitter of the ensemble (FIG 0/21), another ensemble with the
+//	service (FIG 0/24) or one with a linked service (FIG 0/6).
+//	The follower selects the service itself, with a sink passing
+//	everything on to the sink of the caller, such that it sees the
+//	quality reports. When the reception is bad for a while, the
+//	candidates are probed - with the dabProcessor, switching
+//	channels - and the first one that is better by a margin is kept,
+//	otherwise the follower returns. As with the ensembleMonitor, the
+//	database and the offset found are kept per frequency, a next
+//	visit does not start from scratch.
+class afFollower {
+ public:
+  afFollower(dabProcessor *, int32_t, const serviceSink *, ensembleCache *,
+             const followParams *);
+  ~afFollower(void);
+  bool start(followReport_t, void *);
+  void stop(void);
+
+ private:
+  struct channel {
+    int32_t frequency;  // in Hz
+    fib_processor *database;  // nullptr: the one of the dabProcessor
+    bool haveOffset;
+    float offset;
+  };
+  struct candidate {
+    int32_t frequency;
+    int32_t SId;
+  };
+  void run(void);
+  bool receptionBad(void);
+  std::vector<candidate> candidates(void);
+  void probeAll(void);
+  bool probe(const candidate &, int16_t *);
+  bool visit(channel *, int32_t);
+  bool select(int32_t, int32_t);
+  channel *channelFor(int32_t);
+
+  static void audioOut(int16_t *, int, int, bool, void *);
+  static void dataOut(std::string, void *);
+  static void bytesOut(uint8_t *, int16_t, uint8_t, void *);
+  static void programQuality(int16_t, int16_t, int16_t, void *);
+  static void motdata(std::string, int, void *);
+  static void errorReport(int16_t, int16_t, int32_t, void *);
+  static void programname(std::string, std::string, int32_t, void *);
+
+  dabProcessor *theRadio;
+  ensembleCache *theCache;
+  followParams params;
+  serviceSink userSink;
+  serviceSink ownSink;
+  std::map<int32_t, channel> channels;
+  channel *current;
+  int32_t currentSId;
+  int32_t handle;
+  //	the last time the frame count moved, no sync for a while
+  //	is bad reception too
+  uint32_t lastFrames;
+  std::chrono::steady_clock::time_point lastFrameTime;
+  std::thread threadHandle;
+  std::atomic<bool> running;
+  followReport_t reportHandler;
+  void *reportCtx;
+  //	the quality as reported by the decoder of the service
+  std::atomic<int16_t> quality;
+  std::atomic<bool> haveQuality;
+};
+
+#endif
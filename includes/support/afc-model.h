@@ -0,0 +1,62 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#ifndef __AFC_MODEL__
+#define __AFC_MODEL__
+
+#include <stdint.h>
+#include <chrono>
+#include <mutex>
+#include "dab-api.h"
+
+//
+//	The afcModel remembers the frequency error of the oscillator
+//	of the device. The error is - nearly - proportional to the
+//	frequency, so it is kept in ppm, the offset measured on one
+//	channel predicts the offset on all others.
+//	Warming up makes the error drift, the model follows with an
+//	alpha-beta tracker on the ppm and its change per minute.
+class afcModel {
+ public:
+  afcModel(void);
+  ~afcModel(void);
+  float predict(int32_t);
+  void update(int32_t, float);
+  void get_state(afcState *);
+  void set_state(const afcState *);
+  void reset(void);
+
+ private:
+  std::mutex locker;
+  bool valid;
+  float ppm;
+  float drift;
+  int32_t updates;
+  //	the measurements since the last update
+  float sum;
+  int32_t count;
+  std::chrono::steady_clock::time_point lastUpdate;
+  float minutesSince(std::chrono::steady_clock::time_point);
+};
+
+#endif
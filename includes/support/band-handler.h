@@ -37,5 +37,6 @@ class bandHandler {
   ~bandHandler(void);
   int32_t Frequency(uint8_t band, std::string Channel);
   std::string nextChannel(uint8_t dabBand, std::string Channel);
+  std::string firstChannel(uint8_t dabBand);
 };
 #endif
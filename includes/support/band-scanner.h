@@ -0,0 +1,73 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#ifndef __BAND_SCANNER__
+#define __BAND_SCANNER__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "band-handler.h"
+#include "dab-api.h"
+#include "dab-params.h"
+
+class dabProcessor;
+class deviceHandler;
+
+//
+//	The bandScanner walks over the channels of a band, with a
+//	single device and a single dabProcessor. A channel is only
+//	given to the dabProcessor if a quick look at the samples shows
+//	null symbols.
+class bandScanner {
+ public:
+  bandScanner(deviceHandler *, uint8_t);
+  ~bandScanner(void);
+  int scan(uint8_t, int32_t, int32_t, afcState *, scanResult_t, void *);
+
+ private:
+  bool readSamples(int32_t);
+  bool signalPresent(float *);
+  void collectEnsemble(int32_t, int32_t, scanResult *);
+  static void syncsignal(bool, void *);
+  static void ensemblename(std::string, std::string, int32_t, void *);
+  static void programname(std::string, std::string, int32_t, void *);
+
+  deviceHandler *theDevice;
+  dabParams params;
+  bandHandler theBand;
+  dabProcessor *theProcessor;
+  std::vector<std::complex<float>> buffer;
+  std::atomic<bool> noSignal;
+  std::atomic<bool> ensembleSeen;
+  std::atomic<int32_t> ensembleId;
+  std::mutex nameLock;
+  std::string ensembleName;
+  std::chrono::steady_clock::time_point lastNewService;
+};
+
+#endif
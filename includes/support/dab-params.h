@@ -39,6 +39,10 @@ class dabParams {
   int16_t get_T_g()      { return T_g; }
   int32_t get_T_F()      { return T_F; }
   int32_t get_carrierDiff() { return carrierDiff; }
+  int16_t get_ficSymbols() { return ficSymbols; }
+  int16_t get_CIFs()     { return CIFs; }
+  //	the MSC symbols follow block 0 and the FIC symbols
+  int16_t get_mscBlocksperCIF() { return (L - 1 - ficSymbols) / CIFs; }
 
  private:
   uint8_t dabMode;
@@ -50,6 +54,8 @@ class dabParams {
   int16_t T_u;
   int16_t T_g;
   int16_t carrierDiff;
+  int16_t ficSymbols;
+  int16_t CIFs;
 };
 
 #endif
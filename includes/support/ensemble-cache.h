@@ -0,0 +1,70 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#ifndef __ENSEMBLE_CACHE__
+#define __ENSEMBLE_CACHE__
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "dab-api.h"
+
+//	the subchannel data of the main component of an audio
+//	service, as learned from FIG 0/1 and 0/2
+struct cachedService {
+  int32_t SId;
+  audiodata ad;
+};
+
+struct cachedEnsemble {
+  int32_t frequency;
+  int32_t EId;
+  std::vector<cachedService> services;
+};
+
+//
+//	The ensembleCache keeps - in a file - what was learned from
+//	the FIC of the ensembles seen before, per channel (frequency),
+//	such that a service can be selected before the FIC is
+//	decoded. The file starts with a version stamp, a file with
+//	another version is ignored.
+class ensembleCache {
+ public:
+  ensembleCache(const std::string &);
+  ~ensembleCache(void);
+  void store(int32_t, int32_t, const std::vector<cachedService> &);
+  bool lookup(int32_t, int32_t, audiodata *, int32_t *);
+  void invalidate(int32_t);
+  static bool sameSubchannel(const audiodata *, const audiodata *);
+
+ private:
+  bool load(void);
+  bool save(void);
+  std::string fileName;
+  std::mutex locker;
+  std::map<int32_t, cachedEnsemble> ensembles;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#ifndef __ENSEMBLE_MONITOR__
+#define __ENSEMBLE_MONITOR__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "band-handler.h"
+#include "dab-api.h"
+
+class dabProcessor;
+class deviceHandler;
+class fib_processor;
+
+//
+//	The ensembleMonitor watches a number of channels with a single
+//	device and a single dabProcessor (in FIC-only mode), visiting
+//	the channels round robin. Each channel has its own ensemble
+//	database, the dabProcessor is switched to it on a visit, so
+//	the database is updated - not rebuilt - and changes are seen
+//	as such. The offset found on a visit is used on the next one.
+class ensembleMonitor {
+ public:
+  ensembleMonitor(deviceHandler *, uint8_t, uint8_t,
+                  const std::vector<std::string> &, int32_t, int32_t);
+  ~ensembleMonitor(void);
+  bool start(monitorReport_t, void *);
+  void stop(void);
+  int32_t channelCount(void);
+  bool get_state(int32_t, monitorState *);
+  bool get_serviceName(int32_t, int32_t, std::string *);
+
+ private:
+  struct monitoredChannel {
+    ensembleMonitor *parent;
+    fib_processor *database;
+    bool haveOffset;
+    bool everSynced;
+    std::chrono::steady_clock::time_point lastSync;
+    monitorState state;
+  };
+  void run(void);
+  void visit(monitoredChannel *);
+  static void syncsignal(bool, void *);
+  static void systemdata(bool, int16_t, int32_t, void *);
+  static void tiidata(int16_t, int16_t, unsigned int, void *);
+  static void ensemblename(std::string, std::string, int32_t, void *);
+  static void programname(std::string, std::string, int32_t, void *);
+
+  deviceHandler *theDevice;
+  dabProcessor *theProcessor;
+  bandHandler theBand;
+  std::vector<monitoredChannel *> channels;
+  int32_t dwellFrames;
+  int32_t syncTime;
+  std::mutex stateLock;
+  std::thread threadHandle;
+  std::atomic<bool> running;
+  bool processorRunning;
+  monitorReport_t reportHandler;
+  void *reportCtx;
+  //	what the dabProcessor tells during a visit
+  std::atomic<bool> noSignal;
+  std::atomic<int16_t> snr;
+  std::atomic<int16_t> tiiMainId;
+  std::atomic<int16_t> tiiSubId;
+};
+
+#endif
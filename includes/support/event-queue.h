@@ -0,0 +1,108 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#ifndef __EVENT_QUEUE__
+#define __EVENT_QUEUE__
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "dab-api.h"
+
+class eventQueue;
+
+//	a buffer from the pool of a queue returns there when released,
+//	pool is nullptr for a (large) buffer from the heap
+struct dabBuffer {
+  std::atomic<int> refCount;
+  int32_t size;
+  int32_t capacity;
+  uint8_t *data;
+  eventQueue *pool;
+};
+
+//
+//	an eventSource binds a tag to the queue, it is passed as
+//	context to the callbacks below
+struct eventSource {
+  eventQueue *queue;
+  void *tag;
+};
+
+//
+//	The eventQueue is a fixed size ring of events, filled by the
+//	threads of the library through the (static) callbacks, and
+//	emptied by the application. The payload buffers come from a
+//	pool, allocated with the queue
+class eventQueue {
+ public:
+  eventQueue(int);
+  ~eventQueue(void);
+  int eventFd(void);
+  bool nextEvent(dabEvent *);
+  int droppedEvents(void);
+  eventSource *newSource(void *);
+  static void retainBuffer(dabBuffer *);
+  static void releaseBuffer(dabBuffer *);
+
+  //	callbacks, the context is an eventSource
+  static void syncsignal(bool, void *);
+  static void systemdata(bool, int16_t, int32_t, void *);
+  static void fib_quality(int16_t, void *);
+  static void ensemblename(std::string, std::string, int32_t, void *);
+  static void programname(std::string, std::string, int32_t, void *);
+  static void audioOut(int16_t *, int, int, bool, void *);
+  static void dataOut(std::string, void *);
+  static void bytesOut(uint8_t *, int16_t, uint8_t, void *);
+  static void programdata(audiodata *, void *);
+  static void programQuality(int16_t, int16_t, int16_t, void *);
+  static void motdata(std::string, int, void *);
+  static void errorReport(int16_t, int16_t, int32_t, void *);
+  static void fibdata(const uint8_t *, int, void *);
+  static void ensembleChange(uint32_t, int16_t, int32_t, void *);
+
+ private:
+  dabBuffer *newBuffer(const void *, int32_t);
+  void enqueue(eventSource *, int16_t, int32_t, int32_t, int32_t, dabBuffer *);
+  static void post(void *, int16_t, int32_t, int32_t, int32_t);
+  static void post(void *, int16_t, int32_t, int32_t, int32_t, const void *,
+                   int32_t);
+  static void postLabel(void *, int16_t, int32_t, const std::string &,
+                        const std::string &);
+  void recycle(dabBuffer *);
+  std::mutex locker;
+  std::vector<dabEvent> ring;
+  int32_t head;
+  int32_t count;
+  std::vector<eventSource *> sources;
+  int32_t poolSize;
+  dabBuffer *bufferPool;
+  uint8_t *poolData;
+  std::vector<dabBuffer *> freeBuffers;
+  std::atomic<int> dropped;
+  int fd;
+};
+
+#endif
@@ -11,9 +11,10 @@ class Semaphore {
   std::mutex mtx;
   std::condition_variable cv;
   int count;
+  bool interrupted;
 
  public:
-  Semaphore(int count_ = 0) : count{count_} {}
+  Semaphore(int count_ = 0) : count{count_}, interrupted{false} {}
 
   void Release(void) {
     std::unique_lock<std::mutex> lck(mtx);
@@ -31,13 +32,29 @@ class Semaphore {
 
   bool tryAcquire(int delay) {
     std::unique_lock<std::mutex> lck(mtx);
-    if (count == 0) {
+    if ((count == 0) && !interrupted) {
       auto now = std::chrono::system_clock::now();
-      cv.wait_until(lck, now + std::chrono::milliseconds(delay));
+      cv.wait_until(lck, now + std::chrono::milliseconds(delay),
+                    [this] { return (count > 0) || interrupted; });
     }
     if (count == 0) return false;
     --count;
     return true;
   }
+
+  //	setCount is for (re)starting, no one should be waiting
+  void setCount(int count_) {
+    std::unique_lock<std::mutex> lck(mtx);
+    count = count_;
+  }
+
+  //	interrupt makes waiting in tryAcquire return immediately
+  //	(until cleared), such that a thread, waiting for a slot,
+  //	can see that it has to stop
+  void interrupt(bool b) {
+    std::unique_lock<std::mutex> lck(mtx);
+    interrupted = b;
+    if (b) cv.notify_all();
+  }
 };
 #endif
@@ -32,8 +32,8 @@
 //	that will be running in a separate thread. Might be
 //	useful for multicore processors.
 //
-//	Interleaving is - for reasons of simplicity - done
-//	inline rather than through a special class-object
+//	Deinterleaving is done on the CIF history kept by the mscHandler,
+//	the segments in theData are already deinterleaved
 //
 //	fragmentsize == Length * CUSize
 audioBackend::audioBackend(audiodata *d, audioOut_t soundOut, dataOut_t dataOut,
@@ -50,14 +50,6 @@ audioBackend::audioBackend(audiodata *d, audioOut_t soundOut, dataOut_t dataOut,
   this->shortForm = d->shortForm;
   this->protLevel = d->protLevel;
 
-  interleaveData = new int16_t *[16];  // max size
-  for (i = 0; i < 16; i++) {
-    interleaveData[i] = new int16_t[fragmentSize];
-    memset(interleaveData[i], 0, fragmentSize * sizeof(int16_t));
-  }
-
-  interleaverIndex = 0;
-  countforInterleaver = 0;
 
   if (shortForm)
     protectionHandler = new uep_protection(bitRate, protLevel);
@@ -76,7 +68,6 @@ audioBackend::audioBackend(audiodata *d, audioOut_t soundOut, dataOut_t dataOut,
     our_backendBase = new backendBase();
 
   fprintf(stderr, "we have now %s\n", dabModus == DAB_PLUS ? "DAB+" : "DAB");
-  tempX.resize(fragmentSize);
   nextIn = 0;
   nextOut = 0;
   for (i = 0; i < 20; i++) theData[i] = new int16_t[fragmentSize];
@@ -96,15 +87,9 @@ audioBackend::audioBackend(audiodata *d, audioOut_t soundOut, dataOut_t dataOut,
 
 audioBackend::~audioBackend(void) {
   int16_t i;
-  if (running.load()) {
-    running.store(false);
-    threadHandle.join();
-  }
+  stopRunning();
   delete protectionHandler;
   delete our_backendBase;
-  for (i = 0; i < 16; i++) delete[] interleaveData[i];
-  delete[] interleaveData;
-
   for (i = 0; i < 20; i++) delete[] theData[i];
 }
 
@@ -117,37 +102,31 @@ void audioBackend::start(void) {
   threadHandle = std::thread(&audioBackend::run, this);
 }
 
-int32_t audioBackend::process(int16_t *v, int16_t cnt) {
+int32_t audioBackend::process(const int16_t *const *cifRing,
+                              int16_t cifIndex) {
   while (!freeSlots.tryAcquire(200))
     if (!running.load()) return 0;
-  memcpy(theData[nextIn], v, fragmentSize * sizeof(int16_t));
+  deinterleave(cifRing, cifIndex, theData[nextIn]);
   nextIn = (nextIn + 1) % 20;
   usedSlots.Release();
   return 1;
 }
 
-const int16_t interleaveMap[] = {0, 8, 4, 12, 2, 10, 6, 14,
-                                 1, 9, 5, 13, 3, 11, 7, 15};
 void audioBackend::processSegment(int16_t *Data) {
   int16_t i;
 
-  for (i = 0; i < fragmentSize; i++) {
-    tempX[i] =
-        interleaveData[(interleaverIndex + interleaveMap[i & 017]) & 017][i];
-    interleaveData[interleaverIndex][i] = Data[i];
-  }
-
-  interleaverIndex = (interleaverIndex + 1) & 0x0F;
-  nextOut = (nextOut + 1) % 20;
-  freeSlots.Release();
-
-  //      only continue when de-interleaver is filled
-  if (countforInterleaver <= 15) {
+  //      only continue when de-interleaver is filled,
+  //	the oldest element used is 15 CIFs back
+  if (countforInterleaver < 15) {
     countforInterleaver++;
+    nextOut = (nextOut + 1) % 20;
+    freeSlots.Release();
     return;
   }
 
-  protectionHandler->deconvolve(tempX.data(), fragmentSize, outV.data());
+  protectionHandler->deconvolve(Data, fragmentSize, outV.data());
+  nextOut = (nextOut + 1) % 20;
+  freeSlots.Release();
   //
   //      and the energy dispersal
   for (i = 0; i < bitRate * 24; i++) outV[i] ^= disperseVector[i];
@@ -168,6 +147,8 @@ void audioBackend::run(void) {
 void audioBackend::stopRunning(void) {
   if (running.load()) {
     running.store(false);
+    freeSlots.interrupt(true);
+    usedSlots.interrupt(true);
     threadHandle.join();
   }
 }
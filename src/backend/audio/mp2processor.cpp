@@ -583,7 +583,8 @@ void mp2Processor::addtoFrame(uint8_t *v) {
         if (totalFrameCount < 0)
           totalFrameCount = 1;  // keep positive - even at overflow
 #ifdef AAC_OUT
-        soundOut((int16_t *)(&MP2frame[0]), MP2bitCount, 0, false, nullptr);
+        if (soundOut != nullptr)
+          soundOut((int16_t *)(&MP2frame[0]), MP2bitCount, 0, false, ctx);
 #else
         if (mp2decodeFrame(MP2frame, sample_buf, &stereo)) {
           output(sample_buf, 2 * (int32_t)KJMP2_SAMPLES_PER_FRAME, baudRate,
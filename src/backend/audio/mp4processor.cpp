@@ -241,7 +241,7 @@ bool mp4Processor::processSuperframe(uint8_t frameBytes[], int16_t base) {
       memcpy(&fileBuffer[7], &outVector[au_start[i]], aac_frame_length);
       if (soundOut != nullptr)
         (soundOut)((int16_t *)(&fileBuffer[0]), aac_frame_length + 7, 0, false,
-                   nullptr);
+                   ctx);
 #else
       //	we handle the aac -> PMC conversion here
 
@@ -46,13 +46,6 @@ dataBackend::dataBackend(packetdata *d, bytesOut_t bytesOut,
   nextOut = 0;
   for (i = 0; i < 20; i++) theData[i] = new int16_t[fragmentSize];
 
-  tempX.resize(fragmentSize);
-  interleaveData = new int16_t *[16];  // the size
-  for (i = 0; i < 16; i++) {
-    interleaveData[i] = new int16_t[fragmentSize];
-    memset(interleaveData[i], 0, fragmentSize * sizeof(int16_t));
-  }
-  countforInterleaver = 0;
   //
   //	The handling of the depuncturing and deconvolution is
   //	shared with that of the audio
@@ -78,62 +71,51 @@ dataBackend::dataBackend(packetdata *d, bytesOut_t bytesOut,
 
 dataBackend::~dataBackend(void) {
   int16_t i;
-  if (running.load()) {
-    threadHandle.join();
-    running.store(false);
-  }
+  stopRunning();
 
   delete protectionHandler;
-  for (i = 0; i < 16; i++) delete[] interleaveData[i];
-  delete[] interleaveData;
   for (i = 0; i < 20; i++) delete[] theData[i];
   delete our_backendBase;
 }
 
 void dataBackend::start(void) {
+  running.store(true);
   threadHandle = std::thread(&dataBackend::run, this);
 }
 
-int32_t dataBackend::process(int16_t *v, int16_t cnt) {
-  (void)cnt;
+int32_t dataBackend::process(const int16_t *const *cifRing,
+                             int16_t cifIndex) {
   while (!freeSlots.tryAcquire(200))
     if (!running) return 0;
-  memcpy(theData[nextIn], v, fragmentSize * sizeof(int16_t));
+  deinterleave(cifRing, cifIndex, theData[nextIn]);
   nextIn = (nextIn + 1) % 20;
   usedSlots.Release();
   return 1;
 }
 
-const int16_t interleaveMap[] = {0, 8, 4, 12, 2, 10, 6, 14,
-                                 1, 9, 5, 13, 3, 11, 7, 15};
-
+//
+//	The segments in theData are already deinterleaved, the
+//	deinterleaving is done on the CIF history in the mscHandler
 void dataBackend::run(void) {
   int16_t i;
-  int16_t countforInterleaver = 0;
-  int16_t interleaverIndex = 0;
 
-  running.store(true);
   while (running.load()) {
     while (!usedSlots.tryAcquire(200))
       if (!running) return;
 
-    for (i = 0; i < fragmentSize; i++) {
-      tempX[i] =
-          interleaveData[(interleaverIndex + interleaveMap[i & 017]) & 017][i];
-      interleaveData[interleaverIndex][i] = theData[nextOut][i];
-    }
-    nextOut = (nextOut + 1) % 20;
-    freeSlots.Release();
-
-    interleaverIndex = (interleaverIndex + 1) & 0x0F;
-
-    //	only continue when de-interleaver is filled
-    if (countforInterleaver <= 15) {
+    //	only continue when de-interleaver is filled,
+    //	the oldest element used is 15 CIFs back
+    if (countforInterleaver < 15) {
       countforInterleaver++;
+      nextOut = (nextOut + 1) % 20;
+      freeSlots.Release();
       continue;
     }
     //
-    protectionHandler->deconvolve(tempX.data(), fragmentSize, outV.data());
+    protectionHandler->deconvolve(theData[nextOut], fragmentSize,
+                                  outV.data());
+    nextOut = (nextOut + 1) % 20;
+    freeSlots.Release();
     //
     //	and the energy dispersal
     for (i = 0; i < bitRate * 24; i++) outV[i] ^= disperseVector[i];
@@ -146,6 +128,10 @@ void dataBackend::run(void) {
 
 //	It might take a msec for the task to stop
 void dataBackend::stopRunning(void) {
-  running.store(false);
-  threadHandle.join();
+  if (running.load()) {
+    running.store(false);
+    freeSlots.interrupt(true);
+    usedSlots.interrupt(true);
+    threadHandle.join();
+  }
 }
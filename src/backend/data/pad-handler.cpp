@@ -102,7 +102,8 @@ void padHandler::handle_shortPAD(uint8_t *b, int16_t last, uint8_t CIf) {
       case 2:  // start of new fragment, extract the length
         if (firstSegment && !lastSegment) {
           segmentNumber = b[last - 2] >> 4;
-          if (dynamicLabelText.size() > 0) dataOut(dynamicLabelText, ctx);
+          if (dynamicLabelText.size() > 0 && dataOut != nullptr)
+            dataOut(dynamicLabelText, ctx);
           dynamicLabelText.clear();
         }
 
@@ -153,7 +154,8 @@ void padHandler::handle_shortPAD(uint8_t *b, int16_t last, uint8_t CIf) {
         dynamicLabelText.append(segmentText);
       }
       shortpadData.resize(0);
-      if (dynamicLabelText.length() > 0) dataOut(dynamicLabelText, ctx);
+      if (dynamicLabelText.length() > 0 && dataOut != nullptr)
+        dataOut(dynamicLabelText, ctx);
       dynamicLabelText.clear();
     }
   }
@@ -298,7 +300,7 @@ void padHandler::dynamicLabel(uint8_t *data, int16_t length, uint8_t CI) {
       //	if at the end, show the label
       if (last) {
         if (!moreXPad) {
-          dataOut(dynamicLabelText, ctx);
+          if (dataOut != nullptr) dataOut(dynamicLabelText, ctx);
 
         } else
           isLastSegment = true;
@@ -325,7 +327,7 @@ void padHandler::dynamicLabel(uint8_t *data, int16_t length, uint8_t CI) {
           (const char *)data, (CharacterSet)charSet, dataLength);
       dynamicLabelText.append(segmentText);
     }
-    if (!moreXPad && isLastSegment) {
+    if (!moreXPad && isLastSegment && dataOut != nullptr) {
       dataOut(dynamicLabelText, ctx);
     }
   }
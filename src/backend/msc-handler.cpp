@@ -33,17 +33,13 @@
 //	a service is selected or not.
 
 #define CUSize (4 * 16)
+#define CIFSize (864 * CUSize)
 //	Note CIF counts from 0 .. 3
 
-static int16_t cifVector[55296];
-
-static int blocksperCIF[] = {18, 72, 0, 36};
-
 mscHandler::mscHandler(uint8_t dabMode, audioOut_t soundOut, dataOut_t dataOut,
                        bytesOut_t bytesOut, programQuality_t mscQuality,
                        motdata_t motdata_Handler, void *userData)
     : params(dabMode),
-      my_fftHandler(dabMode),
       myMapper(dabMode),
       freeSlots(params.get_L()) {
   this->soundOut = soundOut;
@@ -53,16 +49,37 @@ mscHandler::mscHandler(uint8_t dabMode, audioOut_t soundOut, dataOut_t dataOut,
   this->errorReportHandler = nullptr;
   this->motdata_Handler = motdata_Handler;
   this->userData = userData;
+  my_fftHandler = new fft_handler(dabMode);
+  myEstimator = new channelEstimator(dabMode);
+  coherent.store(false);
   theData = new std::complex<float> *[params.get_L()];
   for (int i = 0; i < params.get_L(); i++)
     theData[i] = new std::complex<float>[params.get_T_u()];
+  theBlock.assign(params.get_L(), 0);
+  theDamage.assign(params.get_L(), 0);
+  theGap.assign(params.get_L(), 0);
 
-  //	cifVector. resize (55296);
+  //	The CIFs are kept in a ring, the time deinterleaving for
+  //	all subchannels is done by reading "older" CIFs from the ring
+  for (int i = 0; i < 16; i++) {
+    cifRing[i] = new int16_t[CIFSize];
+    memset(cifRing[i], 0, CIFSize * sizeof(int16_t));
+  }
+  cifIndex = 0;
+  cifValid.store(0);
+  instantSwitch.store(false);
+  frameGap.store(false);
   cifCount = 0;  // msc blocks in CIF
   blkCount = 0;
-  theBackends.push_back(new virtualBackend(0, 0));
+  backendList[0].push_back(new virtualBackend(0, 0));
+  activeList.store(0);
+  dispatchSeq.store(0);
+  publishWaiting.store(false);
+  publishing = false;
+  nextHandle = 1;
   BitsperBlock = 2 * params.get_carriers();
-  numberofblocksperCIF = blocksperCIF[(dabMode - 1) & 03];
+  numberofblocksperCIF = params.get_mscBlocksperCIF();
+  firstMSCblock = params.get_ficSymbols() + 1;
 
   work_to_do.store(false);
   running.store(false);
@@ -73,30 +90,204 @@ mscHandler::~mscHandler(void) {
   stop();
   for (int i = 0; i < params.get_L(); i++) delete[] theData[i];
   delete[] theData;
+  for (int i = 0; i < 16; i++) delete[] cifRing[i];
+  delete my_fftHandler;
+  delete myEstimator;
+}
+
+//
+//	The geometry of the frame depends on the mode, the CIFs
+//	do not, so the selected services remain.
+//	To be called with the thread stopped
+void mscHandler::set_mode(uint8_t dabMode) {
+  if (running.load()) {
+    fprintf(stderr, "cannot change the mode of an active mscHandler\n");
+    return;
+  }
+  for (int i = 0; i < params.get_L(); i++) delete[] theData[i];
+  delete[] theData;
+  delete my_fftHandler;
+  delete myEstimator;
+
+  params = dabParams(dabMode);
+  my_fftHandler = new fft_handler(dabMode);
+  myEstimator = new channelEstimator(dabMode);
+  myMapper = interLeaver(dabMode);
+  theData = new std::complex<float> *[params.get_L()];
+  for (int i = 0; i < params.get_L(); i++)
+    theData[i] = new std::complex<float>[params.get_T_u()];
+  theBlock.assign(params.get_L(), 0);
+  theDamage.assign(params.get_L(), 0);
+  theGap.assign(params.get_L(), 0);
+  BitsperBlock = 2 * params.get_carriers();
+  numberofblocksperCIF = params.get_mscBlocksperCIF();
+  firstMSCblock = params.get_ficSymbols() + 1;
+  phaseReference.resize(params.get_T_u());
+  cifValid.store(0);
 }
 
 void mscHandler::setError_handler(decodeErrorReport_t err_Handler) {
+  mutexer.lock();
   errorReportHandler = err_Handler;
-  for (auto &b : theBackends) {
-    b->setError_handler(err_Handler);
+  for (auto &b : backendList[activeList.load()]) {
+    if (b->sharedContext()) b->setError_handler(err_Handler);
   }
+  mutexer.unlock();
 }
 
 void mscHandler::stop(void) {
   if (running.load()) {
     running.store(false);
+    freeSlots.interrupt(true);
+    usedSlots.interrupt(true);
     threadHandle.join();
   }
+  reset();
+}
 
-  mutexer.lock();
-  for (auto const &b : theBackends) {
+//
+//	reset terminates the active backends only, the thread
+//	continues, such that the CIF history remains valid and
+//	a newly selected service may use it
+void mscHandler::reset(void) {
+  std::vector<virtualBackend *> retired;
+  std::vector<virtualBackend *> empty;
+
+  std::unique_lock<std::mutex> lock(mutexer);
+  lockList(lock);
+  retired = backendList[activeList.load()];
+  work_to_do.store(false);
+  publish(lock, empty);
+  lock.unlock();
+
+  for (auto const &b : retired) {
     b->stopRunning();
     delete b;
   }
+}
 
-  theBackends.resize(0);
-  work_to_do.store(false);
-  mutexer.unlock();
+//
+//	remove_channel removes a single backend, the others
+//	continue undisturbed
+bool mscHandler::remove_channel(int32_t handle) {
+  std::vector<virtualBackend *> newList;
+  virtualBackend *retired = nullptr;
+
+  if (handle <= 0) return false;
+  std::unique_lock<std::mutex> lock(mutexer);
+  lockList(lock);
+  for (auto const &b : backendList[activeList.load()]) {
+    if ((retired == nullptr) && (b->get_handle() == handle))
+      retired = b;
+    else
+      newList.push_back(b);
+  }
+  if (retired != nullptr) publish(lock, newList);
+  lock.unlock();
+
+  if (retired == nullptr) return false;
+  retired->stopRunning();
+  delete retired;
+  return true;
+}
+
+//
+//	publish releases mutexer while waiting, so the lists are
+//	changed by one publisher at the time: lockList waits - with
+//	mutexer locked - until no publish is in progress
+void mscHandler::lockList(std::unique_lock<std::mutex> &lock) {
+  dispatchDone.wait(lock, [this] { return !publishing; });
+}
+
+//
+//	publish is called with mutexer locked. The new list is copied
+//	into the inactive buffer and made active. Then we wait until a
+//	dispatch - if any - that might still be using the old
+//	list is finished, after which the old buffer (and the backends
+//	no longer in the new list) may be reused.
+//	The dispatcher itself never waits for us, it only signals
+//	the end of the dispatch when publishWaiting is set.
+void mscHandler::publish(std::unique_lock<std::mutex> &lock,
+                         std::vector<virtualBackend *> &newList) {
+  int next = 1 - activeList.load();
+  backendList[next] = newList;
+  activeList.store(next);
+  uint32_t seq = dispatchSeq.load();
+  if ((seq & 01) == 0) return;
+  publishing = true;
+  publishWaiting.store(true);
+  while (running.load() && (dispatchSeq.load() == seq))
+    dispatchDone.wait_for(lock, std::chrono::milliseconds(100));
+  publishWaiting.store(false);
+  publishing = false;
+  dispatchDone.notify_all();
+}
+
+//	called with mutexer locked
+void mscHandler::prepare_backend(virtualBackend *nbe, const serviceSink *sink,
+                                 int32_t handle) {
+  bool shared =
+      (sink->errorReport_Handler == nullptr) && (sink->ctx == userData);
+
+  nbe->set_handle(handle);
+  nbe->set_sharedContext(shared);
+  nbe->setError_handler(shared ? errorReportHandler
+                               : sink->errorReport_Handler);
+  if (instantSwitch.load() && (cifValid.load() >= 15))
+    nbe->set_interleaverFilled();
+}
+
+int32_t mscHandler::add_backend(virtualBackend *nbe, const serviceSink *sink) {
+  std::vector<virtualBackend *> newList;
+  int32_t handle;
+
+  std::unique_lock<std::mutex> lock(mutexer);
+  lockList(lock);
+  handle = nextHandle++;
+  prepare_backend(nbe, sink, handle);
+  newList = backendList[activeList.load()];
+  newList.push_back(nbe);
+  publish(lock, newList);
+  work_to_do.store(true);
+  lock.unlock();
+  return handle;
+}
+
+//
+//	replace_audioChannel gives the service with the handle
+//	other parameters, e.g. when these turned out to be outdated.
+//	The handle remains valid
+bool mscHandler::replace_audioChannel(int32_t handle, audiodata *d,
+                                      const serviceSink *sink) {
+  std::vector<virtualBackend *> newList;
+  virtualBackend *retired = nullptr;
+  audioBackend *nbe;
+
+  if (handle <= 0) return false;
+  nbe = new audioBackend(d, sink->audioOut_Handler, sink->dataOut_Handler,
+                         sink->programQuality_Handler, sink->motdata_Handler,
+                         sink->ctx);
+  std::unique_lock<std::mutex> lock(mutexer);
+  lockList(lock);
+  for (auto const &b : backendList[activeList.load()]) {
+    if ((retired == nullptr) && (b->get_handle() == handle)) {
+      retired = b;
+      prepare_backend(nbe, sink, handle);
+      newList.push_back(nbe);
+    } else
+      newList.push_back(b);
+  }
+  if (retired != nullptr) publish(lock, newList);
+  lock.unlock();
+
+  if (retired == nullptr) {
+    nbe->stopRunning();
+    delete nbe;
+    return false;
+  }
+  retired->stopRunning();
+  delete retired;
+  return true;
 }
 
 void mscHandler::start(void) {
@@ -106,60 +297,114 @@ void mscHandler::start(void) {
   }
   //	else
   //	   fprintf (stderr, "starting mscHandler\n");
+  cifValid.store(0);
+  //	slots left over from a previous run are not consumed
+  freeSlots.setCount(params.get_L());
+  usedSlots.setCount(0);
+  inSlot = 0;
+  freeSlots.interrupt(false);
+  usedSlots.interrupt(false);
+  running.store(true);
   threadHandle = std::thread(&mscHandler::run, this);
 }
 
-void mscHandler::reset(void) {
-  stop();
-  start();
-}
+//
+//	With instantSwitch set, a newly selected service is
+//	deinterleaved using the CIFs already in the ring - if these
+//	are valid - rather than waiting for 15 CIFs to arrive.
+void mscHandler::set_instantSwitch(bool b) { instantSwitch.store(b); }
+
+//
+//	called by the ofdm processor when frames were lost, i.e.
+//	the CIFs in the ring are no longer consecutive
+void mscHandler::signal_frameGap(void) { frameGap.store(true); }
+
+//
+//	coherent demodulation, effective at the start of the next frame.
+//	The FIC blocks are then demodulated as well, they are
+//	needed to follow the channel
+void mscHandler::set_coherent(bool b) { coherent.store(b); }
 
 //	The exteral world sees this
-void mscHandler::process_mscBlock(std::complex<float> *b, int16_t blkno) {
+//	damaged is the number of samples of the block that were blanked
+//	or clipped by the sampleReader
+void mscHandler::process_mscBlock(std::complex<float> *b, int16_t blkno,
+                                  int32_t damaged) {
   while (running.load())
     if (freeSlots.tryAcquire(200)) break;
 
   if (!running.load()) return;
-  memcpy(theData[blkno], b, params.get_T_u() * sizeof(std::complex<float>));
+  //	the block number and the gap flag travel in the slot, like
+  //	the data, the semaphores order them for the msc thread
+  memcpy(theData[inSlot], b, params.get_T_u() * sizeof(std::complex<float>));
+  theBlock[inSlot] = blkno;
+  theDamage[inSlot] = damaged;
+  theGap[inSlot] = (blkno == 0) && frameGap.exchange(false);
+  inSlot = (inSlot + 1) % params.get_L();
   usedSlots.Release();
 }
 
 void mscHandler::run(void) {
-  std::complex<float> *fft_buffer = my_fftHandler.getVector();
+  std::complex<float> *fft_buffer = my_fftHandler->getVector();
   std::vector<int16_t> ibits;
+  int slot = 0;
   int currentBlock = 0;
+  bool inFrame = false;
+  bool coherentFrame = false;
 
-  running.store(true);
   ibits.resize(BitsperBlock);
   while (running.load()) {
     while (!usedSlots.tryAcquire(200))
       if (!running) return;
-    memcpy(fft_buffer, theData[currentBlock],
+    //	when reading samples is interrupted (retune, reset) the
+    //	processor starts again with block 0, the blocks up to the
+    //	next block 0 have no reference and are skipped
+    int16_t blkno = theBlock[slot];
+    inFrame = (blkno == 0) || (inFrame && (blkno == currentBlock + 1));
+    currentBlock = blkno;
+    if (!inFrame) {
+      freeSlots.Release();
+      slot = (slot + 1) % params.get_L();
+      continue;
+    }
+    memcpy(fft_buffer, theData[slot],
            params.get_T_u() * sizeof(std::complex<float>));
+    if (theGap[slot]) cifValid.store(0);
 
     //      block 3 and up are needed as basis for demodulation the "mext" block
-    //      "our" msc blocks start with blkno 4
-    my_fftHandler.do_FFT();
-    if (currentBlock >= 4) {
-      for (int i = 0; i < params.get_carriers(); i++) {
-        int16_t index = myMapper.mapIn(i);
-        if (index < 0) index += params.get_T_u();
-
-        std::complex<float> r1 =
-            fft_buffer[index] * conj(phaseReference[index]);
-        float ab1 = jan_abs(r1);
-        //	Recall:  the viterbi decoder wants 127 max pos, - 127 max neg
-        //	we make the bits into softbits in the range -127 .. 127
-        ibits[i] = -real(r1) / ab1 * 127.0;
-        ibits[params.get_carriers() + i] = -imag(r1) / ab1 * 127.0;
+    //      "our" msc blocks start after the FIC, with blkno 4 (9 in Mode III)
+    my_fftHandler->do_FFT();
+    if (currentBlock == 0) {
+      coherentFrame = coherent.load();
+      if (coherentFrame) myEstimator->start(fft_buffer);
+    } else if (coherentFrame || (currentBlock >= firstMSCblock)) {
+      if (coherentFrame)
+        myEstimator->demap(fft_buffer, ibits.data());
+      else
+        for (int i = 0; i < params.get_carriers(); i++) {
+          int16_t index = myMapper.mapIn(i);
+          if (index < 0) index += params.get_T_u();
+
+          std::complex<float> r1 =
+              fft_buffer[index] * conj(phaseReference[index]);
+          float ab1 = jan_abs(r1);
+          //	Recall:  the viterbi decoder wants 127 max pos, - 127 max neg
+          //	we make the bits into softbits in the range -127 .. 127
+          ibits[i] = -real(r1) / ab1 * 127.0;
+          ibits[params.get_carriers() + i] = -imag(r1) / ab1 * 127.0;
+        }
+      if (currentBlock >= firstMSCblock) {
+        float weight = erasureWeight(theDamage[slot], params.get_T_u());
+        if (weight < 1)
+          for (int i = 0; i < BitsperBlock; i++) ibits[i] = ibits[i] * weight;
+        process_mscBlock(ibits, currentBlock);
       }
-      process_mscBlock(ibits, currentBlock);
     }
 
     memcpy(phaseReference.data(), fft_buffer,
            params.get_T_u() * sizeof(std::complex<float>));
     freeSlots.Release();
-    currentBlock = (currentBlock + 1) % (params.get_L());
+    slot = (slot + 1) % params.get_L();
   }
 }
 
@@ -170,53 +415,72 @@ void mscHandler::run(void) {
 //	the actual changing of the settings is done in the
 //	thread executing process_mscBlock
 void mscHandler::set_audioChannel(audiodata *d) {
-  mutexer.lock();
-  audioBackend *nbe = new audioBackend(d, soundOut, dataOut, programQuality,
-                                       motdata_Handler, userData);
-  // we could assert here that theBackend == nullptr
-  if (nbe) {
-    nbe->setError_handler(errorReportHandler);
-    theBackends.push_back(nbe);
-    work_to_do.store(true);
-  }
-  mutexer.unlock();
+  serviceSink sink;
+  get_defaultSink(&sink);
+  set_audioChannel(d, &sink);
 }
 
 void mscHandler::set_dataChannel(packetdata *d) {
-  mutexer.lock();
-  dataBackend *nbe = new dataBackend(d, bytesOut, motdata_Handler, userData);
-  if (nbe) {
-    nbe->setError_handler(errorReportHandler);
-    theBackends.push_back(nbe);
-    work_to_do.store(true);
-  }
-  mutexer.unlock();
+  serviceSink sink;
+  get_defaultSink(&sink);
+  set_dataChannel(d, &sink);
+}
+
+//	the sink with the handlers passed to dabInit
+void mscHandler::get_defaultSink(serviceSink *sink) {
+  sink->audioOut_Handler = soundOut;
+  sink->dataOut_Handler = dataOut;
+  sink->bytesOut_Handler = bytesOut;
+  sink->programQuality_Handler = programQuality;
+  sink->motdata_Handler = motdata_Handler;
+  sink->errorReport_Handler = nullptr;
+  sink->ctx = userData;
+}
+
+//
+//	with a sink, the output of the service goes to the handlers
+//	of the sink, with the context of the sink.
+//	The handle returned can be used to remove the service
+int32_t mscHandler::set_audioChannel(audiodata *d, const serviceSink *sink) {
+  audioBackend *nbe = new audioBackend(
+      d, sink->audioOut_Handler, sink->dataOut_Handler,
+      sink->programQuality_Handler, sink->motdata_Handler, sink->ctx);
+  return add_backend(nbe, sink);
+}
+
+int32_t mscHandler::set_dataChannel(packetdata *d, const serviceSink *sink) {
+  dataBackend *nbe = new dataBackend(d, sink->bytesOut_Handler,
+                                     sink->motdata_Handler, sink->ctx);
+  return add_backend(nbe, sink);
 }
 
 void mscHandler::process_mscBlock(std::vector<int16_t> fbits, int16_t blkno) {
   int16_t currentblk;
 
   //	we accept the incoming data
-  currentblk = (blkno - 4) % numberofblocksperCIF;
-  memcpy(&cifVector[currentblk * BitsperBlock], fbits.data(),
+  currentblk = (blkno - firstMSCblock) % numberofblocksperCIF;
+  memcpy(&cifRing[cifIndex][currentblk * BitsperBlock], fbits.data(),
          BitsperBlock * sizeof(int16_t));
   if (currentblk < numberofblocksperCIF - 1) return;
 
-  if (!work_to_do.load()) return;
   //	OK, now we have a full CIF
-  mutexer.lock();
-  blkCount = 0;
-  cifCount = (cifCount + 1) & 03;
-  for (auto const &b : theBackends) {
-    int startAddr = b->startAddr();
-    int Length = b->Length();
-
-    if (Length > 0) {
-      int16_t myBegin[Length * CUSize];
-      memcpy(myBegin, &cifVector[startAddr * CUSize],
-             Length * CUSize * sizeof(int16_t));
-      (void)b->process(myBegin, Length * CUSize);
+  //	The list of backends is read without locking, dispatchSeq
+  //	is odd while we are using it (see publish)
+  if (work_to_do.load()) {
+    dispatchSeq.fetch_add(1);
+    blkCount = 0;
+    cifCount = (cifCount + 1) & 03;
+    for (auto const &b : backendList[activeList.load()]) {
+      if (b->Length() > 0) (void)b->process(cifRing, cifIndex);
+    }
+    dispatchSeq.fetch_add(1);
+    //	mutexer is only held for short moments, the publisher
+    //	releases it while waiting
+    if (publishWaiting.load()) {
+      std::lock_guard<std::mutex> lock(mutexer);
+      dispatchDone.notify_all();
     }
   }
-  mutexer.unlock();
+  cifIndex = (cifIndex + 1) & 017;
+  if (cifValid.load() < 16) cifValid.store(cifValid.load() + 1);
 }
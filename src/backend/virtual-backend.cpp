@@ -28,6 +28,9 @@
 virtualBackend::virtualBackend(int16_t a, int16_t l) {
   startAddress = a;
   segmentLength = l;
+  countforInterleaver = 0;
+  handle = 0;
+  shared = true;
 }
 
 virtualBackend::~virtualBackend(void) {}
@@ -36,16 +39,59 @@ void virtualBackend::setError_handler(decodeErrorReport_t err_Handler) {
   (void)err_Handler;
 }
 
-int32_t virtualBackend::process(int16_t *v, int16_t c) {
-  (void)v;
-  (void)c;
+int32_t virtualBackend::process(const int16_t *const *cifRing,
+                                int16_t cifIndex) {
+  (void)cifRing;
+  (void)cifIndex;
   return 32768;
 }
 
+//
+//	The time deinterleaving is done on the CIF history, kept by
+//	the mscHandler as a ring of 16 CIFs, with cifRing [cifIndex]
+//	being the most recent one.
+//	Element i of the subchannel is to be taken from the CIF that
+//	is cifDelay [i & 017] CIFs old, i.e. 15 - interleaveMap [i & 017].
+//	The loop is organized per group of 16 elements, such that the
+//	inner loop has a fixed set of 16 source pointers and no index
+//	computations, which the compiler happily unrolls and vectorizes.
+static const int16_t cifDelay[] = {15, 7, 11, 3, 13, 5, 9, 1,
+                                   14, 6, 10, 2, 12, 4, 8, 0};
+
+void virtualBackend::deinterleave(const int16_t *const *cifRing,
+                                  int16_t cifIndex, int16_t *out) {
+  const int16_t *src[16];
+  int32_t base = startAddress * CUSize;
+  int32_t fragmentSize = segmentLength * CUSize;
+
+  for (int k = 0; k < 16; k++)
+    src[k] = &cifRing[(cifIndex - cifDelay[k]) & 017][base];
+
+  for (int32_t i = 0; i < fragmentSize; i += 16)
+    for (int k = 0; k < 16; k++) out[i + k] = src[k][i + k];
+}
+
 int16_t virtualBackend::startAddr(void) { return startAddress; }
 
 int16_t virtualBackend::Length(void) { return segmentLength; }
 
+//
+//	If the CIF history (i.e. the 15 CIFs before the next one) is
+//	valid, the deinterleaver need not wait to be filled
+void virtualBackend::set_interleaverFilled(void) { countforInterleaver = 15; }
+
+void virtualBackend::set_handle(int32_t h) { handle = h; }
+
+int32_t virtualBackend::get_handle(void) { return handle; }
+
+//
+//	a backend "shares" the context when its output goes to the
+//	handlers with the userData passed to dabInit, only then
+//	the error handler set afterwards applies to it
+void virtualBackend::set_sharedContext(bool b) { shared = b; }
+
+bool virtualBackend::sharedContext(void) { return shared; }
+
 void virtualBackend::stopRunning(void) {}
 
 void virtualBackend::stop(void) {}
@@ -22,7 +22,13 @@
  */
 //
 #include "dab-api.h"
+#include <string.h>
+#include "af-follower.h"
+#include "band-scanner.h"
 #include "dab-processor.h"
+#include "ensemble-cache.h"
+#include "ensemble-monitor.h"
+#include "event-queue.h"
 #include "ringbuffer.h"
 
 void *dabInit(deviceHandler *theDevice, uint8_t Mode,
@@ -45,6 +51,26 @@ void *dabInit(deviceHandler *theDevice, uint8_t Mode,
   return (void *)theClass;
 }
 
+//
+//	all results go to the event queue, the context passed to
+//	the callbacks is an eventSource with the tag
+void *dabInit_events(deviceHandler *theDevice, uint8_t Mode, void *queue,
+                     void *tag, bool withFIBs,
+                     RingBuffer<std::complex<float>> *spectrumBuffer,
+                     RingBuffer<std::complex<float>> *iqBuffer) {
+  eventSource *source = ((eventQueue *)queue)->newSource(tag);
+  dabProcessor *theClass = new dabProcessor(
+      theDevice, Mode, eventQueue::syncsignal, eventQueue::systemdata,
+      eventQueue::ensemblename, eventQueue::programname,
+      eventQueue::fib_quality, eventQueue::audioOut, eventQueue::bytesOut,
+      eventQueue::dataOut, eventQueue::programdata, eventQueue::programQuality,
+      eventQueue::motdata, spectrumBuffer, iqBuffer, source);
+  theClass->setError_handler(eventQueue::errorReport);
+  theClass->setChange_handler(eventQueue::ensembleChange);
+  if (withFIBs) theClass->setFIB_handler(eventQueue::fibdata);
+  return (void *)theClass;
+}
+
 void dabExit(void *Handle) { delete (dabProcessor *)Handle; }
 
 void dabStartProcessing(void *Handle) { ((dabProcessor *)Handle)->start(); }
@@ -55,6 +81,14 @@ void dabStop(void *Handle) { ((dabProcessor *)Handle)->stop(); }
 
 void dabReset_msc(void *Handle) { ((dabProcessor *)Handle)->reset_msc(); }
 
+bool dabRetune(void *Handle, int32_t frequency) {
+  return ((dabProcessor *)Handle)->retune(frequency);
+}
+
+void dab_setInstantSwitch(void *Handle, bool b) {
+  ((dabProcessor *)Handle)->set_instantSwitch(b);
+}
+
 bool is_audioService(void *Handle, const char *name) {
   return ((dabProcessor *)Handle)->kindofService(std::string(name)) ==
          AUDIO_SERVICE;
@@ -84,6 +118,50 @@ void dab_setEId_handler(void *Handle, ensembleid_t EId_Handler) {
   return ((dabProcessor *)Handle)->setEId_handler(EId_Handler);
 }
 
+void dab_setChange_handler(void *Handle, ensembleChange_t change_Handler) {
+  ((dabProcessor *)Handle)->setChange_handler(change_Handler);
+}
+
+uint32_t dab_getGeneration(void *Handle) {
+  return ((dabProcessor *)Handle)->get_generation();
+}
+
+static int copyList(const std::vector<int32_t> &v, int32_t *out,
+                    int maxCount) {
+  for (int i = 0; (i < (int)v.size()) && (i < maxCount); i++) out[i] = v[i];
+  return v.size();
+}
+
+int dab_getFrequencies(void *Handle, int32_t EId, int32_t *kHz,
+                       int maxCount) {
+  return copyList(((dabProcessor *)Handle)->frequenciesFor(EId), kHz,
+                  maxCount);
+}
+
+int dab_getOtherEnsembles(void *Handle, int32_t SId, int32_t *EIds,
+                          int maxCount) {
+  return copyList(((dabProcessor *)Handle)->ensemblesFor(SId), EIds,
+                  maxCount);
+}
+
+int dab_getLinkedServices(void *Handle, int32_t SId, int32_t *SIds,
+                          int maxCount) {
+  return copyList(((dabProcessor *)Handle)->linkedServices(SId), SIds,
+                  maxCount);
+}
+
+int16_t dab_getMode(void *Handle) {
+  return ((dabProcessor *)Handle)->get_mode();
+}
+
+float dab_getClockOffset(void *Handle) {
+  return ((dabProcessor *)Handle)->get_clockOffset();
+}
+
+int16_t dab_getFicQuality(void *Handle) {
+  return ((dabProcessor *)Handle)->get_ficQuality();
+}
+
 void dab_setError_handler(void *Handle, decodeErrorReport_t err_Handler) {
   return ((dabProcessor *)Handle)->setError_handler(err_Handler);
 }
@@ -138,6 +216,153 @@ void set_dataChannel(void *Handle, packetdata *pd) {
   ((dabProcessor *)Handle)->set_dataChannel(pd);
 }
 
+int set_audioChannel_sink(void *Handle, audiodata *ad,
+                          const serviceSink *sink) {
+  return ((dabProcessor *)Handle)->set_audioChannel(ad, sink);
+}
+
+int set_dataChannel_sink(void *Handle, packetdata *pd,
+                         const serviceSink *sink) {
+  return ((dabProcessor *)Handle)->set_dataChannel(pd, sink);
+}
+
+bool dab_removeChannel(void *Handle, int handle) {
+  return ((dabProcessor *)Handle)->remove_channel(handle);
+}
+
+int dab_decodeAll(void *Handle, sinkFactory_t factory, void *userData) {
+  return ((dabProcessor *)Handle)->decodeAll(factory, userData);
+}
+
+int dab_scanBand(deviceHandler *theDevice, uint8_t Mode, uint8_t band,
+                 int32_t syncTime, int32_t ensembleTime, afcState *afc,
+                 scanResult_t handler, void *ctx) {
+  bandScanner scanner(theDevice, Mode);
+  return scanner.scan(band, syncTime, ensembleTime, afc, handler, ctx);
+}
+
+void dab_setFicOnly(void *Handle, bool b) {
+  ((dabProcessor *)Handle)->set_ficOnly(b);
+}
+
+void dab_setGuardSync(void *Handle, bool b) {
+  ((dabProcessor *)Handle)->set_guardSync(b);
+}
+
+void dab_setCoherent(void *Handle, bool b) {
+  ((dabProcessor *)Handle)->set_coherent(b);
+}
+
+void *dab_openCache(const char *fileName) {
+  return (void *)(new ensembleCache(std::string(fileName)));
+}
+
+void dab_closeCache(void *cache) { delete (ensembleCache *)cache; }
+
+void dab_setCache(void *Handle, void *cache, int32_t frequency) {
+  ((dabProcessor *)Handle)->set_cache((ensembleCache *)cache, frequency);
+}
+
+int dab_preloadService(void *Handle, int32_t SId, const serviceSink *sink) {
+  return ((dabProcessor *)Handle)->preload_audioService(SId, sink);
+}
+
+bool dab_cacheEnsemble(void *Handle) {
+  return ((dabProcessor *)Handle)->cache_ensemble();
+}
+
+void dab_setFrequency(void *Handle, int32_t frequency) {
+  ((dabProcessor *)Handle)->set_frequency(frequency);
+}
+
+void *dab_createMonitor(deviceHandler *theDevice, uint8_t Mode, uint8_t band,
+                        const char *const *channels, int nrChannels,
+                        int dwellFrames, int syncTime) {
+  std::vector<std::string> names;
+  for (int i = 0; i < nrChannels; i++) names.push_back(channels[i]);
+  return (void *)(new ensembleMonitor(theDevice, Mode, band, names,
+                                      dwellFrames, syncTime));
+}
+
+void dab_deleteMonitor(void *monitor) { delete (ensembleMonitor *)monitor; }
+
+bool dab_startMonitor(void *monitor, monitorReport_t handler, void *ctx) {
+  return ((ensembleMonitor *)monitor)->start(handler, ctx);
+}
+
+void dab_stopMonitor(void *monitor) { ((ensembleMonitor *)monitor)->stop(); }
+
+int dab_monitorChannels(void *monitor) {
+  return ((ensembleMonitor *)monitor)->channelCount();
+}
+
+bool dab_getMonitorState(void *monitor, int channel, monitorState *s) {
+  return ((ensembleMonitor *)monitor)->get_state(channel, s);
+}
+
+bool dab_getMonitorServiceName(void *monitor, int channel, int32_t SId,
+                               char *name, int size) {
+  std::string s;
+  if ((size <= 0) ||
+      !((ensembleMonitor *)monitor)->get_serviceName(channel, SId, &s))
+    return false;
+  strncpy(name, s.c_str(), size - 1);
+  name[size - 1] = 0;
+  return true;
+}
+
+void *dab_createFollower(void *Handle, int32_t SId, const serviceSink *sink,
+                         void *cache, const followParams *params) {
+  return (void *)(new afFollower((dabProcessor *)Handle, SId, sink,
+                                 (ensembleCache *)cache, params));
+}
+
+void dab_deleteFollower(void *follower) { delete (afFollower *)follower; }
+
+bool dab_startFollower(void *follower, followReport_t handler, void *ctx) {
+  return ((afFollower *)follower)->start(handler, ctx);
+}
+
+void dab_stopFollower(void *follower) { ((afFollower *)follower)->stop(); }
+
+void dab_getAFC(void *Handle, afcState *s) {
+  ((dabProcessor *)Handle)->get_afcState(s);
+}
+
+void dab_setAFC(void *Handle, const afcState *s) {
+  ((dabProcessor *)Handle)->set_afcState(s);
+}
+
+void *dab_createEventQueue(int poolSize) {
+  return (void *)(new eventQueue(poolSize));
+}
+
+void dab_deleteEventQueue(void *queue) { delete (eventQueue *)queue; }
+
+int dab_eventFd(void *queue) { return ((eventQueue *)queue)->eventFd(); }
+
+bool dab_nextEvent(void *queue, dabEvent *e) {
+  return ((eventQueue *)queue)->nextEvent(e);
+}
+
+int dab_droppedEvents(void *queue) {
+  return ((eventQueue *)queue)->droppedEvents();
+}
+
+void dab_retainBuffer(dabBuffer *b) { eventQueue::retainBuffer(b); }
+
+void dab_releaseBuffer(dabBuffer *b) { eventQueue::releaseBuffer(b); }
+
+void dab_eventSink(void *queue, void *tag, serviceSink *sink) {
+  sink->audioOut_Handler = eventQueue::audioOut;
+  sink->dataOut_Handler = eventQueue::dataOut;
+  sink->bytesOut_Handler = eventQueue::bytesOut;
+  sink->programQuality_Handler = eventQueue::programQuality;
+  sink->motdata_Handler = eventQueue::motdata;
+  sink->errorReport_Handler = eventQueue::errorReport;
+  sink->ctx = ((eventQueue *)queue)->newSource(tag);
+}
+
 int32_t dab_getSId(void *Handle, const char *c_s) {
   std::string s(c_s);
   return ((dabProcessor *)Handle)->get_SId(s);
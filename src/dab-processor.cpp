@@ -22,8 +22,20 @@
 #include "dab-processor.h"
 #include "dab-api.h"
 #include "device-handler.h"
+#include "ensemble-cache.h"
+#include "guard-syncer.h"
 #include "timesyncer.h"
 
+//	the sample clock offset (in ppm) follows the measurements
+//	with this gain per frame, the range is that of the measurement
+#define CLOCK_GAIN 0.3
+#define CLOCK_MAXOFFSET 250
+//	below this FIC quality (see ficHandler::get_ficQuality) hardly
+//	a FIB passes, the MSC is not decoded. After a few of those
+//	frames in a row the sync is considered lost
+#define FIC_COLLAPSED 10
+#define FIC_COLLAPSEFRAMES 3
+
 /**
  *	\brief dabProcessor
  *	The dabProcessor class is the driver of the processing
@@ -46,9 +58,6 @@ dabProcessor::dabProcessor(
       tii_resetFrameCount(-1),
       params(dabMode),
       myReader(this, inputDevice, spectrumBuffer),
-      phaseSynchronizer(dabMode, THRESHOLD, DIFF_LENGTH),
-      my_TII_Detector(dabMode),
-      my_ofdmDecoder(dabMode, iqBuffer),
       my_ficHandler(dabMode, ensemblename_Handler, programname_Handler,
                     fibquality_Handler, userData),
       my_mscHandler(dabMode, audioOut, dataOut_handler, bytesOut, mscQuality,
@@ -58,6 +67,44 @@ dabProcessor::dabProcessor(
   this->errorReportHandler = nullptr;
   this->systemdataHandler = systemdataHandler;
   this->userData = userData;
+  this->iqBuffer = iqBuffer;
+  //	Mode 0: the mode is detected, until then we assume Mode I
+  autoMode = dabMode == 0;
+  phaseSynchronizer = nullptr;
+  my_TII_Detector = nullptr;
+  my_ofdmDecoder = nullptr;
+  setup_mode(params.get_dabMode());
+  isSynced = false;
+  parked = false;
+  running.store(false);
+  theCache = nullptr;
+  cacheFrequency = 0;
+  checkCache.store(false);
+  cacheRequest = false;
+  tunedFrequency.store(0);
+  haveOffsetHint = false;
+  offsetHint = 0;
+  frameCount.store(0);
+  clockOffset.store(0);
+  lockedOffset.store(0);
+  frameSnr.store(0);
+  ficOnly.store(false);
+  guardSync.store(false);
+  coherent.store(false);
+}
+
+dabProcessor::~dabProcessor() {
+  stop();
+  delete phaseSynchronizer;
+  delete my_TII_Detector;
+  delete my_ofdmDecoder;
+}
+
+//
+//	setup_mode is called from the constructor, and later only
+//	from the processing thread, with the msc thread stopped
+void dabProcessor::setup_mode(uint8_t dabMode) {
+  params = dabParams(dabMode);
   this->T_null = params.get_T_null();
   this->T_s = params.get_T_s();
   this->T_u = params.get_T_u();
@@ -66,15 +113,38 @@ dabProcessor::dabProcessor(
   this->nrBlocks = params.get_L();
   this->carriers = params.get_carriers();
   this->carrierDiff = params.get_carrierDiff();
-  isSynced = false;
-  running.store(false);
+  this->ficSymbols = params.get_ficSymbols();
+  delete phaseSynchronizer;
+  delete my_TII_Detector;
+  delete my_ofdmDecoder;
+  phaseSynchronizer = new phaseReference(dabMode, THRESHOLD, DIFF_LENGTH);
+  my_TII_Detector = new TII_Detector(dabMode);
+  my_ofdmDecoder = new ofdmDecoder(dabMode, iqBuffer);
+  my_ficHandler.set_mode(dabMode);
+  my_mscHandler.set_mode(dabMode);
+  currentMode.store(dabMode);
 }
 
-dabProcessor::~dabProcessor() { stop(); }
+//
+//	detect_mode reads a stretch of samples - somewhat over two
+//	Mode I frames - and tells the mode, 0 if it cannot tell
+uint8_t dabProcessor::detect_mode(float offset) {
+  std::vector<std::complex<float>> buffer(modeDetector::bufferSize());
+  myReader.getSamples(buffer.data(), buffer.size(), offset);
+  return myModeDetector.detect(buffer.data(), buffer.size());
+}
+
+int16_t dabProcessor::get_mode(void) { return currentMode.load(); }
 
 void dabProcessor::start() {
   if (running.load()) return;
+  running.store(true);
+  parked = false;
+  myReader.interrupt(false);
+  myReader.setRunning(true);
+  cacheRequest = false;
   threadHandle = std::thread(&dabProcessor::run, this);
+  cacheThread = std::thread(&dabProcessor::run_cacheCheck, this);
 }
 
 /***
@@ -88,133 +158,253 @@ void dabProcessor::start() {
 void dabProcessor::run() {
   std::complex<float> FreqCorr;
   timeSyncer myTimeSyncer(&myReader);
+  guardSyncer myGuardSyncer(&myReader);
   int32_t i;
   float fineOffset = 0;
   float coarseOffset = 0;
   bool correctionNeeded = true;
   std::vector<complex<float>> ofdmBuffer(T_null);
+  std::vector<int16_t> ibits(2 * carriers);
   int dip_attempts = 0;
   int index_attempts = 0;
-
+  int collapsedFrames = 0;
+  bool mscActive = false;
+  bool modeKnown = !autoMode;
+  //	the wide range frequency acquisition is done at the start,
+  //	after a retune and after losing sync, the narrow tracker
+  //	takes over from the offset found
+  bool acquiring = true;
+  float acquiredOffset = 0;
+
+  coarseOffset = startOffset();
+  acquiredOffset = coarseOffset;
   isSynced = false;
-  running.store(true);
   my_ficHandler.reset();
-  myReader.setRunning(true);
-  my_mscHandler.start();
-  try {
-    for (i = 0; i < T_F / 2; i++) {
-      jan_abs(myReader.getSample(0));
-    }
+  while (running.load()) {
+    try {
+      for (i = 0; i < T_F / 2; i++) {
+        jan_abs(myReader.getSample(0));
+      }
 
-  // Initing:
-  notSynced:
-    my_TII_Detector.reset();
+    // Initing:
+    notSynced:
+      //	with automatic mode detection, the mode is (re)established
+      //	at the start, after a retune and after losing sync
+      if (!modeKnown) {
+        uint8_t mode = detect_mode(coarseOffset + fineOffset);
+        if (mode == 0) {
+          if (++dip_attempts >= 5) {
+            syncsignalHandler(false, userData);
+            dip_attempts = 0;
+          }
+          goto notSynced;
+        }
+        if (mode != params.get_dabMode()) {
+          if (mscActive) my_mscHandler.stop();
+          mscActive = false;
+          setup_mode(mode);
+          ofdmBuffer.resize(T_null);
+          ibits.resize(2 * carriers);
+          acquiring = true;
+          fprintf(stderr, "Mode %d detected\n", mode);
+        }
+        modeKnown = true;
+      }
+      my_TII_Detector->reset();
+      //	whatever is in the CIF history is not followed by
+      //	the next CIF to arrive
+      my_mscHandler.signal_frameGap();
+
+      //	the guardSyncer also tells the frequency offset within
+      //	a carrier, the timeSyncer looks at the envelope only
+      int syncResult;
+      float guardOffset = 0;
+      if (guardSync.load())
+        syncResult = myGuardSyncer.sync(&params, coarseOffset + fineOffset,
+                                        &guardOffset);
+      else
+        syncResult = myTimeSyncer.sync(T_null, T_F);
+      switch (syncResult) {
+        case TIMESYNC_ESTABLISHED:
+          fineOffset += guardOffset;
+          break;  // yes, we are ready
+
+        case NO_DIP_FOUND:
+          if (++dip_attempts >= 5) {
+            syncsignalHandler(false, userData);
+            dip_attempts = 0;
+            modeKnown = !autoMode;
+          }
+          goto notSynced;
 
-    switch (myTimeSyncer.sync(T_null, T_F)) {
-      case TIMESYNC_ESTABLISHED:
-        break;  // yes, we are ready
+        default:  // does not happen
+        case NO_END_OF_DIP_FOUND:
+          goto notSynced;
+      }
 
-      case NO_DIP_FOUND:
-        if (++dip_attempts >= 5) {
+    SyncOnPhase:
+      //	We arrive here when - it seems we are time synchronized,
+      //	either from above
+      //	or after having processed a frame
+      //	Now read in Tu samples. The precise number is not really important
+      //	as long as we can be sure that the first sample to be identified
+      //	is part of the samples read.
+      myReader.getSamples(ofdmBuffer.data(), T_u, coarseOffset + fineOffset);
+      if (acquiring) {
+        bool found;
+        int16_t correction =
+            phaseSynchronizer->acquireOffset(ofdmBuffer.data(), &found);
+        if (found) {
+          acquiring = false;
+          coarseOffset += correction * carrierDiff;
+          acquiredOffset = coarseOffset;
+          //	the block was read with the wrong offset, we
+          //	synchronize on the next frame
+          if (correction != 0) goto notSynced;
+        }
+      }
+      int startIndex = phaseSynchronizer->findIndex(ofdmBuffer.data());
+      if (startIndex < 0) {  // no sync, try again
+        isSynced = false;
+        if (++index_attempts > 5) {
           syncsignalHandler(false, userData);
-          dip_attempts = 0;
+          index_attempts = 0;
+          modeKnown = !autoMode;
+          acquiring = true;
         }
+        if (errorReportHandler)  // additional immediate error report?
+          errorReportHandler(4, 1, 0, userData);
         goto notSynced;
-
-      default:  // does not happen
-      case NO_END_OF_DIP_FOUND:
-        goto notSynced;
-    }
-
-  SyncOnPhase:
-    //	We arrive here when - it seems we are time synchronized,
-    //	either from above
-    //	or after having processed a frame
-    //	Now read in Tu samples. The precise number is not really important
-    //	as long as we can be sure that the first sample to be identified
-    //	is part of the samples read.
-    myReader.getSamples(ofdmBuffer.data(), T_u, coarseOffset + fineOffset);
-    int startIndex = phaseSynchronizer.findIndex(ofdmBuffer.data());
-    if (startIndex < 0) {  // no sync, try again
-      isSynced = false;
-      if (++index_attempts > 5) {
-        syncsignalHandler(false, userData);
-        index_attempts = 0;
       }
-      if (errorReportHandler)  // additional immediate error report?
-        errorReportHandler(4, 1, 0, userData);
-      goto notSynced;
-    }
 
-    index_attempts = 0;
-    dip_attempts = 0;
-    isSynced = true;
-    syncsignalHandler(isSynced, userData);
-
-    //	Once here, we are synchronized, we need to copy the data we
-    //	used for synchronization for block 0
-
-    memmove(ofdmBuffer.data(), &((ofdmBuffer.data())[startIndex]),
-            (T_u - startIndex) * sizeof(std::complex<float>));
-    int ofdmBufferIndex = T_u - startIndex;
-
-    //	Block 0 is special in that it is used for coarse time synchronization
-    //	and its content is used as a reference for decoding the
-    //	first datablock.
-    //	We read the missing samples in the ofdm buffer
-    myReader.getSamples(&((ofdmBuffer.data())[ofdmBufferIndex]),
-                        T_u - ofdmBufferIndex, coarseOffset + fineOffset);
-    my_ofdmDecoder.processBlock_0(ofdmBuffer.data());
-    my_mscHandler.process_mscBlock(ofdmBuffer.data(), 0);
-    //
-    //	if correction is needed (known by the fic handler)
-    //	we compute the coarse offset in the phaseSynchronizer
-    correctionNeeded = !my_ficHandler.syncReached();
-    if (correctionNeeded) {
-      int correction = phaseSynchronizer.estimateOffset(ofdmBuffer.data());
-      if (correction != 100) {
-        coarseOffset += correction * carrierDiff;
-        if (abs(coarseOffset) > Khz(35)) coarseOffset = 0;
+      index_attempts = 0;
+      dip_attempts = 0;
+      isSynced = true;
+      syncsignalHandler(isSynced, userData);
+
+      //	Once here, we are synchronized, we need to copy the data we
+      //	used for synchronization for block 0
+
+      memmove(ofdmBuffer.data(), &((ofdmBuffer.data())[startIndex]),
+              (T_u - startIndex) * sizeof(std::complex<float>));
+      int ofdmBufferIndex = T_u - startIndex;
+
+      //	Block 0 is special in that it is used for coarse time synchronization
+      //	and its content is used as a reference for decoding the
+      //	first datablock.
+      //	We read the missing samples in the ofdm buffer
+      myReader.getSamples(&((ofdmBuffer.data())[ofdmBufferIndex]),
+                          T_u - ofdmBufferIndex, coarseOffset + fineOffset);
+      my_ofdmDecoder->set_coherent(coherent.load());
+      my_ofdmDecoder->processBlock_0(ofdmBuffer.data());
+      //	the msc thread is started or stopped here, at the start
+      //	of a frame, when going out of or into FIC-only mode
+      if (ficOnly.load() == mscActive) {
+        mscActive = !mscActive;
+        if (mscActive)
+          my_mscHandler.start();
+        else
+          my_mscHandler.stop();
       }
-    }
-    //
-    //	after block 0, we will just read in the other (params -> L - 1) blocks
-    //	The first ones are the FIC blocks. We immediately
-    //	start with building up an average of the phase difference
-    //	between the samples in the cyclic prefix and the
-    //	corresponding samples in the datapart.
-    ///	and similar for the (params. L - 4) MSC blocks
-    FreqCorr = std::complex<float>(0, 0);
-    std::vector<int16_t> ibits(2 * params.get_carriers());
-    for (int ofdmSymbolCount = 1; ofdmSymbolCount < (uint16_t)nrBlocks;
-         ofdmSymbolCount++) {
-      myReader.getSamples(ofdmBuffer.data(), T_s, coarseOffset + fineOffset);
-      for (i = (int)T_u; i < (int)T_s; i++)
-        FreqCorr += ofdmBuffer[i] * conj(ofdmBuffer[i - T_u]);
+      //	the FIC quality lags a frame, as the FIC is decoded by
+      //	the workers of the ficHandler. The skipped frames are a
+      //	gap for the MSC
+      int16_t ficQuality = my_ficHandler.get_ficQuality();
+      if ((ficQuality >= 0) && (ficQuality < FIC_COLLAPSED)) {
+        if (++collapsedFrames >= FIC_COLLAPSEFRAMES) {
+          collapsedFrames = 0;
+          isSynced = false;
+          if (errorReportHandler) errorReportHandler(4, 1, 0, userData);
+          goto notSynced;
+        }
+      } else
+        collapsedFrames = 0;
+      bool mscDispatch = mscActive && (collapsedFrames == 0);
+      if (mscActive && !mscDispatch) my_mscHandler.signal_frameGap();
+      if (mscDispatch) my_mscHandler.process_mscBlock(ofdmBuffer.data(), 0, 0);
       //
-      //	Note that only the first few blocks are handled locally
-      //	The FIC/FIB handling is in this thread, so that there is
-      //	no delay is "knowing" that we are synchronized
-      if (ofdmSymbolCount < 4) {
-        my_ofdmDecoder.decode(ofdmBuffer.data(), ofdmSymbolCount, ibits.data());
-        my_ficHandler.process_ficBlock(ibits, ofdmSymbolCount);
+      //	if correction is needed (known by the fic handler)
+      //	we compute the coarse offset in the phaseSynchronizer
+      correctionNeeded = !my_ficHandler.syncReached();
+      if (correctionNeeded) {
+        int correction = phaseSynchronizer->estimateOffset(ofdmBuffer.data());
+        if (correction != 100) {
+          coarseOffset += correction * carrierDiff;
+          //	drifting away that far means the acquisition was wrong
+          if (abs(coarseOffset - acquiredOffset) > Khz(35)) {
+            coarseOffset = acquiredOffset;
+            acquiring = true;
+          }
+        }
+      }
+      //
+      //	after block 0, we will just read in the other (params -> L - 1) blocks
+      //	The first ones are the FIC blocks. We immediately
+      //	start with building up an average of the phase difference
+      //	between the samples in the cyclic prefix and the
+      //	corresponding samples in the datapart.
+      ///	and similar for the MSC blocks
+      FreqCorr = std::complex<float>(0, 0);
+      int lastSymbol = mscDispatch ? nrBlocks : ficSymbols + 1;
+      for (int ofdmSymbolCount = 1; ofdmSymbolCount < lastSymbol;
+           ofdmSymbolCount++) {
+        myReader.getSamples(ofdmBuffer.data(), T_s, coarseOffset + fineOffset);
+        int32_t damaged = myReader.get_damaged();
+        for (i = (int)T_u; i < (int)T_s; i++)
+          FreqCorr += ofdmBuffer[i] * conj(ofdmBuffer[i - T_u]);
+        //
+        //	Note that only the first few blocks are handled locally
+        //	The FIC/FIB handling is in this thread, so that there is
+        //	no delay is "knowing" that we are synchronized
+        if (ofdmSymbolCount <= ficSymbols) {
+          my_ofdmDecoder->decode(ofdmBuffer.data(), ofdmSymbolCount,
+                                 ibits.data(), damaged);
+          my_ficHandler.process_ficBlock(ibits.data(), ibits.size(),
+                                         ofdmSymbolCount);
+        }
+        if (mscDispatch)
+          my_mscHandler.process_mscBlock(&((ofdmBuffer.data())[T_g]),
+                                         ofdmSymbolCount, damaged);
+      }
+      //	in FIC-only mode - and with a collapsed FIC - the MSC
+      //	symbols are not even looked at
+      if (!mscDispatch)
+        myReader.skipSamples((nrBlocks - 1 - ficSymbols) * T_s,
+                             coarseOffset + fineOffset);
+      if (checkCache.load()) {
+        std::lock_guard<std::mutex> lock(cacheWakeLock);
+        cacheRequest = true;
+        cacheWake.notify_one();
       }
-      my_mscHandler.process_mscBlock(&((ofdmBuffer.data())[T_g]),
-                                     ofdmSymbolCount);
-    }
-
-    //	we integrate the newly found frequency error with the
-    //	existing frequency error.
-    fineOffset += 0.1 * arg(FreqCorr) / M_PI * (carrierDiff);
-
-    //	at the end of the frame, just skip Tnull samples
-    myReader.getSamples(ofdmBuffer.data(), T_null, coarseOffset + fineOffset);
-    float sum = 0;
-    for (i = 0; i < T_null; i++) sum += abs(ofdmBuffer[i]);
-    sum /= T_null;
 
-    float sum2 = myReader.get_sLevel();
-    (void)sum2;  // avoid compiler warning
+      //	we integrate the newly found frequency error with the
+      //	existing frequency error.
+      fineOffset += 0.1 * arg(FreqCorr) / M_PI * (carrierDiff);
+      //	the sample clock offset is measured over the FIC blocks,
+      //	the reader resamples to compensate it
+      bool clockValid;
+      float clockError = my_ofdmDecoder->get_clockOffset(&clockValid);
+      if (my_ficHandler.syncReached()) {
+        theAFC.update(tunedFrequency.load(), coarseOffset + fineOffset);
+        if (clockValid) {
+          float clock = clockOffset.load() + CLOCK_GAIN * clockError;
+          if (fabs(clock) > CLOCK_MAXOFFSET) clock = 0;
+          clockOffset.store(clock);
+          myReader.set_clockOffset(clock);
+        }
+      }
+      lockedOffset.store(coarseOffset + fineOffset);
+      frameSnr.store(my_ofdmDecoder->get_snr());
+      frameCount++;
+
+      //	at the end of the frame, just skip Tnull samples
+      myReader.getSamples(ofdmBuffer.data(), T_null, coarseOffset + fineOffset);
+      float sum = 0;
+      for (i = 0; i < T_null; i++) sum += abs(ofdmBuffer[i]);
+      sum /= T_null;
+
+      float sum2 = myReader.get_sLevel();
+      (void)sum2;  // avoid compiler warning
 #if 0
 	static int ccc	= 0;
 	if (++ccc > 10) {
@@ -223,76 +413,209 @@ void dabProcessor::run() {
 	}
 #endif
 
-    /*
-     *	The TII data is encoded in the null period of the
-     *	odd frames
-     */
-    if ((my_tiiHandler || my_tiiExHandler) && my_ficHandler.has_CIFcount() &&
-        params.get_dabMode() == 1) {
-      int32_t cifCounter = my_ficHandler.get_CIFcount();
-      if (wasSecond(cifCounter, &params)) {
-        my_TII_Detector.addBuffer(
-            ofdmBuffer, tii_alfa,
-            cifCounter);  // forward tii_algo to addBuffer()
-        ++tii_counter;
-        if (tii_counter >= tii_framedelay) {
-          if (my_tiiHandler) {
-            int16_t mainId = -1;
-            int16_t subId = -1;
-            my_TII_Detector.processNULL(
-                &mainId, &subId);  // forward tii_algo to processNULL()
-            my_tiiHandler(mainId, subId, my_TII_Detector.getNumBuffers(),
-                          userData);
-          } else {
-            int numOut = 0;
-            int outTii[24];
-            float outAvgSNR[24];
-            float outMinSNR[24];
-            float outNxtSNR[24];
-            my_TII_Detector.processNULL_ex(&numOut, outTii, outAvgSNR,
-                                           outMinSNR, outNxtSNR);
-            if (numOut > 0)
-              my_tiiExHandler(numOut, outTii, outAvgSNR, outMinSNR, outNxtSNR,
-                              my_TII_Detector.getNumBuffers(),
-                              my_TII_Detector.P_allAvg, (int)T_u, userData);
+      /*
+       *	The TII data is encoded in the null period of the
+       *	odd frames
+       */
+      if ((my_tiiHandler || my_tiiExHandler) && my_ficHandler.has_CIFcount() &&
+          params.get_dabMode() == 1) {
+        int32_t cifCounter = my_ficHandler.get_CIFcount();
+        if (wasSecond(cifCounter, &params)) {
+          my_TII_Detector->addBuffer(
+              ofdmBuffer, tii_alfa,
+              cifCounter);  // forward tii_algo to addBuffer()
+          ++tii_counter;
+          if (tii_counter >= tii_framedelay) {
+            if (my_tiiHandler) {
+              int16_t mainId = -1;
+              int16_t subId = -1;
+              my_TII_Detector->processNULL(
+                  &mainId, &subId);  // forward tii_algo to processNULL()
+              my_tiiHandler(mainId, subId, my_TII_Detector->getNumBuffers(),
+                            userData);
+            } else {
+              int numOut = 0;
+              int outTii[24];
+              float outAvgSNR[24];
+              float outMinSNR[24];
+              float outNxtSNR[24];
+              my_TII_Detector->processNULL_ex(&numOut, outTii, outAvgSNR,
+                                             outMinSNR, outNxtSNR);
+              if (numOut > 0)
+                my_tiiExHandler(numOut, outTii, outAvgSNR, outMinSNR, outNxtSNR,
+                                my_TII_Detector->getNumBuffers(),
+                                my_TII_Detector->P_allAvg, (int)T_u, userData);
+            }
+          }
+          if (tii_counter >= tii_framedelay) tii_counter = 0;
+          if ((int)my_TII_Detector->getNumBuffers() >= tii_resetFrameCount &&
+              tii_resetFrameCount > 0) {
+            my_TII_Detector->reset();
           }
-        }
-        if (tii_counter >= tii_framedelay) tii_counter = 0;
-        if ((int)my_TII_Detector.getNumBuffers() >= tii_resetFrameCount &&
-            tii_resetFrameCount > 0) {
-          my_TII_Detector.reset();
         }
       }
-    }
 
-    if (fineOffset > carrierDiff / 2) {
-      coarseOffset += carrierDiff;
-      fineOffset -= carrierDiff;
-    } else if (fineOffset < -carrierDiff / 2) {
-      coarseOffset -= carrierDiff;
-      fineOffset += carrierDiff;
+      if (fineOffset > carrierDiff / 2) {
+        coarseOffset += carrierDiff;
+        fineOffset -= carrierDiff;
+      } else if (fineOffset < -carrierDiff / 2) {
+        coarseOffset -= carrierDiff;
+        fineOffset += carrierDiff;
+      }
+      goto SyncOnPhase;
     }
-    goto SyncOnPhase;
-  }
 
-  catch (int e) {
-    ;
+    catch (int e) {
+      if (e != READER_INTERRUPTED) break;
+      //	a retune (or reset) is requested, we wait until it is
+      //	done and start all over, with a clean state
+      wait_forRetune();
+      isSynced = false;
+      fineOffset = 0;
+      coarseOffset = startOffset();
+      correctionNeeded = true;
+      dip_attempts = 0;
+      index_attempts = 0;
+      modeKnown = !autoMode;
+      acquiring = true;
+      acquiredOffset = coarseOffset;
+    }
   }
   my_mscHandler.stop();
   //	fprintf (stderr, "dabProcessor is shutting down\n");
 }
 
+//
+//	reset and retune keep the threads (and all allocations) alive,
+//	the processing thread is "parked" while the state is cleaned up
 void dabProcessor::reset() {
-  stop();
-  start();
+  if (!running.load()) {
+    start();
+    return;
+  }
+  std::unique_lock<std::mutex> lck(retuneLock);
+  park(lck);
+  my_ficHandler.reset();
+  my_mscHandler.reset();
+  {
+    std::lock_guard<std::mutex> lock(cacheLock);
+    preloaded.clear();
+    checkCache.store(false);
+  }
+  unpark();
+}
+
+//
+//	retune flushes the device and sets the new frequency,
+//	the ensemble information and selected services are gone.
+//	With a cache, what was learned of the ensemble is kept
+bool dabProcessor::retune(int32_t frequency) {
+  bool result;
+  cache_ensemble();
+  std::unique_lock<std::mutex> lck(retuneLock);
+  if (running.load()) park(lck);
+  inputDevice->stopReader();
+  inputDevice->resetBuffer();
+  myReader.flush();
+  result = inputDevice->restartReader(frequency);
+  my_ficHandler.set_database(nullptr);
+  my_ficHandler.reset();
+  my_mscHandler.reset();
+  {
+    std::lock_guard<std::mutex> lock(cacheLock);
+    preloaded.clear();
+    checkCache.store(false);
+    cacheFrequency = frequency;
+  }
+  tunedFrequency.store(frequency);
+  if (running.load()) unpark();
+  return result;
+}
+
+//
+//	switch_channel is a retune for the ensembleMonitor: the FIC goes
+//	into the database kept for the channel - and continues from
+//	there - and the offset found on the previous visit is used
+bool dabProcessor::switch_channel(int32_t frequency, fib_processor *db,
+                                  bool haveOffset, float offset) {
+  bool result;
+  std::unique_lock<std::mutex> lck(retuneLock);
+  if (running.load()) park(lck);
+  inputDevice->stopReader();
+  inputDevice->resetBuffer();
+  myReader.flush();
+  result = inputDevice->restartReader(frequency);
+  my_ficHandler.set_database(db);
+  my_mscHandler.reset();
+  tunedFrequency.store(frequency);
+  haveOffsetHint = haveOffset;
+  offsetHint = offset;
+  if (running.load()) unpark();
+  return result;
+}
+
+//	the offset to start with: the one passed with switch_channel,
+//	otherwise the prediction of the frequency error of the device
+float dabProcessor::startOffset(void) {
+  std::lock_guard<std::mutex> lock(retuneLock);
+  if (!haveOffsetHint) return theAFC.predict(tunedFrequency.load());
+  haveOffsetHint = false;
+  return offsetHint;
+}
+
+//	the number of frames processed - in sync - and the offset
+//	of the last one
+uint32_t dabProcessor::get_frameCount(void) { return frameCount.load(); }
+
+float dabProcessor::get_offset(void) { return lockedOffset.load(); }
+
+//	the SNR (dB) of the last frame, the frequency tuned to
+int16_t dabProcessor::get_snr(void) { return frameSnr.load(); }
+
+int16_t dabProcessor::get_ficQuality(void) {
+  return my_ficHandler.get_ficQuality();
+}
+
+int32_t dabProcessor::get_frequency(void) { return tunedFrequency.load(); }
+
+//	the offset (in ppm) of the sample clock of the device
+float dabProcessor::get_clockOffset(void) { return clockOffset.load(); }
+
+//	called with retuneLock locked, returns with the processing
+//	thread waiting in wait_forRetune (or terminated)
+void dabProcessor::park(std::unique_lock<std::mutex> &lck) {
+  myReader.interrupt(true);
+  retuneSignal.wait(lck, [this] { return parked || !running.load(); });
+}
+
+void dabProcessor::unpark(void) {
+  myReader.interrupt(false);
+  parked = false;
+  retuneSignal.notify_all();
+}
+
+void dabProcessor::wait_forRetune(void) {
+  std::unique_lock<std::mutex> lck(retuneLock);
+  parked = true;
+  retuneSignal.notify_all();
+  retuneSignal.wait(lck, [this] { return !parked || !running.load(); });
+  parked = false;
 }
 
 void dabProcessor::stop() {
   if (running.load()) {
-    running.store(false);
-    myReader.setRunning(false);
-    sleep(1);
+    {
+      std::unique_lock<std::mutex> lck(retuneLock);
+      running.store(false);
+      myReader.setRunning(false);
+      retuneSignal.notify_all();
+    }
     threadHandle.join();
+    {
+      std::lock_guard<std::mutex> lock(cacheWakeLock);
+      cacheWake.notify_all();
+    }
+    cacheThread.join();
   }
 }
 
@@ -302,7 +625,8 @@ void dabProcessor::call_systemData(bool f, int16_t snr, int32_t freq) {
 
 void dabProcessor::show_Corrector(int freqOffset) {
   if (systemdataHandler != nullptr)
-    systemdataHandler(isSynced, my_ofdmDecoder.get_snr(), freqOffset, userData);
+    systemdataHandler(isSynced, my_ofdmDecoder->get_snr(), freqOffset,
+                      userData);
 }
 
 bool dabProcessor::signalSeemsGood() { return isSynced; }
@@ -348,6 +672,10 @@ void dabProcessor::printAll_metaInfo(FILE *out) {
 
 void dabProcessor::reset_msc() { my_mscHandler.reset(); }
 
+void dabProcessor::set_instantSwitch(bool b) {
+  my_mscHandler.set_instantSwitch(b);
+}
+
 void dabProcessor::setTII_handler(tii_t tii_Handler, tii_ex_t tii_ExHandler,
                                   int framedelay, float alfa,
                                   int resetFrameCount) {
@@ -362,6 +690,34 @@ void dabProcessor::setEId_handler(ensembleid_t EId_Handler) {
   my_ficHandler.setEId_handler(EId_Handler);
 }
 
+void dabProcessor::setChange_handler(ensembleChange_t change_Handler) {
+  my_ficHandler.setChange_handler(change_Handler);
+}
+
+uint32_t dabProcessor::get_generation(void) {
+  return my_ficHandler.get_generation();
+}
+
+int32_t dabProcessor::get_EId(bool *found) {
+  return my_ficHandler.get_EId(found);
+}
+
+void dabProcessor::get_defaultSink(serviceSink *sink) {
+  my_mscHandler.get_defaultSink(sink);
+}
+
+std::vector<int32_t> dabProcessor::frequenciesFor(int32_t EId) {
+  return my_ficHandler.frequenciesFor(EId);
+}
+
+std::vector<int32_t> dabProcessor::ensemblesFor(int32_t SId) {
+  return my_ficHandler.ensemblesFor(SId);
+}
+
+std::vector<int32_t> dabProcessor::linkedServices(int32_t SId) {
+  return my_ficHandler.linkedServices(SId);
+}
+
 void dabProcessor::setError_handler(decodeErrorReport_t err_Handler) {
   errorReportHandler = err_Handler;
   my_ficHandler.setError_handler(err_Handler);
@@ -402,6 +758,191 @@ void dabProcessor::set_dataChannel(packetdata *d) {
   my_mscHandler.set_dataChannel(d);
 }
 
+int32_t dabProcessor::set_audioChannel(audiodata *d,
+                                       const serviceSink *sink) {
+  return my_mscHandler.set_audioChannel(d, sink);
+}
+
+int32_t dabProcessor::set_dataChannel(packetdata *d, const serviceSink *sink) {
+  return my_mscHandler.set_dataChannel(d, sink);
+}
+
+bool dabProcessor::remove_channel(int32_t handle) {
+  return my_mscHandler.remove_channel(handle);
+}
+
+//	decodeAll walks over the services as known at the moment
+//	of calling, the factory decides which of the (sub)services
+//	are to be decoded, and where the output goes to.
+//	Since the number of components is encoded in 4 bits, we look
+//	at at most 16 components per service
+int dabProcessor::decodeAll(sinkFactory_t factory, void *ctx) {
+  int added = 0;
+
+  if (factory == nullptr) return 0;
+  for (int32_t SId : my_ficHandler.serviceIds()) {
+    for (int16_t compnr = 0; compnr < 16; compnr++) {
+      audiodata ad;
+      packetdata pd;
+      serviceSink sink;
+      memset(&sink, 0, sizeof(sink));
+      my_ficHandler.dataforAudioService(SId, &ad, compnr);
+      if (ad.defined) {
+        if (factory(SId, &ad, nullptr, &sink, ctx)) {
+          my_mscHandler.set_audioChannel(&ad, &sink);
+          added++;
+        }
+        continue;
+      }
+      my_ficHandler.dataforDataService(SId, &pd, compnr);
+      if (pd.defined && factory(SId, nullptr, &pd, &sink, ctx)) {
+        my_mscHandler.set_dataChannel(&pd, &sink);
+        added++;
+      }
+    }
+  }
+  return added;
+}
+
+//
+//	In FIC-only mode the msc thread is stopped - terminating the
+//	selected services - and the MSC symbols are skipped, the
+//	switch is made by the processing thread at the next frame
+void dabProcessor::set_ficOnly(bool b) { ficOnly.store(b); }
+
+//
+//	the acquisition - at the start, after a retune and after
+//	losing sync - with the guardSyncer instead of the timeSyncer,
+//	effective the next time
+void dabProcessor::set_guardSync(bool b) { guardSync.store(b); }
+
+//
+//	coherent demodulation of the FIC and the MSC, both switch
+//	at the start of a frame. The ofdmDecoder is recreated with
+//	a change of mode, so it is told at every frame
+void dabProcessor::set_coherent(bool b) {
+  coherent.store(b);
+  my_mscHandler.set_coherent(b);
+}
+
+//
+//	The cache is keyed by the frequency the device is tuned to,
+//	retune updates it
+void dabProcessor::set_cache(ensembleCache *cache, int32_t frequency) {
+  std::lock_guard<std::mutex> lock(cacheLock);
+  theCache = cache;
+  cacheFrequency = frequency;
+}
+
+//
+//	preload_audioService selects the (main component of the)
+//	service with the parameters from the cache, so decoding starts
+//	as soon as we are time synchronized. Once the FIC tells
+//	the real parameters, these are compared (check_cache).
+//	A null sink means the handlers passed to dabInit.
+//	Returns the handle, or -1 when the service is not in the cache
+int32_t dabProcessor::preload_audioService(int32_t SId,
+                                           const serviceSink *sink) {
+  preloadedService p;
+
+  std::lock_guard<std::mutex> lock(cacheLock);
+  if (theCache == nullptr) return -1;
+  if (!theCache->lookup(cacheFrequency, SId, &p.ad, &p.EId)) return -1;
+  if (sink != nullptr)
+    p.sink = *sink;
+  else
+    my_mscHandler.get_defaultSink(&p.sink);
+  p.SId = SId;
+  p.handle = my_mscHandler.set_audioChannel(&p.ad, &p.sink);
+  preloaded.push_back(p);
+  checkCache.store(true);
+  return p.handle;
+}
+
+//
+//	cache_ensemble stores the audio services, as known now, of
+//	the current ensemble. Returns false if there is nothing to store
+bool dabProcessor::cache_ensemble(void) {
+  std::vector<cachedService> services;
+  bool haveEId;
+  int32_t EId = my_ficHandler.get_EId(&haveEId);
+
+  std::lock_guard<std::mutex> lock(cacheLock);
+  if ((theCache == nullptr) || !haveEId) return false;
+  for (int32_t SId : my_ficHandler.serviceIds()) {
+    cachedService s;
+    my_ficHandler.dataforAudioService(SId, &s.ad, 0);
+    if (!s.ad.defined) continue;
+    s.SId = SId;
+    services.push_back(s);
+  }
+  if (services.empty()) return false;
+  theCache->store(cacheFrequency, EId, services);
+  return true;
+}
+
+//
+//	the processing thread asks for a check once per frame, as long
+//	as there are preloaded services
+void dabProcessor::run_cacheCheck(void) {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(cacheWakeLock);
+      cacheWake.wait(lock, [this] { return cacheRequest || !running.load(); });
+      if (!running.load()) return;
+      cacheRequest = false;
+    }
+    check_cache();
+  }
+}
+
+//
+//	When the FIC contradicts the cache, the cache entry is dropped
+//	and the service continues - under the same handle - with the
+//	parameters from the FIC. In another ensemble than the one
+//	cached, a service the FIC does not (yet) know is stopped
+void dabProcessor::check_cache(void) {
+  bool haveEId;
+  int32_t EId = my_ficHandler.get_EId(&haveEId);
+
+  std::lock_guard<std::mutex> lock(cacheLock);
+  for (auto it = preloaded.begin(); it != preloaded.end();) {
+    audiodata live;
+    bool otherEnsemble = haveEId && (EId != it->EId);
+    if (otherEnsemble) theCache->invalidate(cacheFrequency);
+    my_ficHandler.dataforAudioService(it->SId, &live, 0);
+    if (!live.defined) {
+      if (otherEnsemble) {
+        my_mscHandler.remove_channel(it->handle);
+        it = preloaded.erase(it);
+      } else
+        it++;
+      continue;
+    }
+    if (!ensembleCache::sameSubchannel(&live, &it->ad)) {
+      theCache->invalidate(cacheFrequency);
+      my_mscHandler.replace_audioChannel(it->handle, &live, &it->sink);
+    }
+    it = preloaded.erase(it);
+  }
+  if (preloaded.empty()) checkCache.store(false);
+}
+
+//
+//	the frequency is needed to convert between the offset (in Hz)
+//	and the frequency error (in ppm) of the device
+void dabProcessor::set_frequency(int32_t frequency) {
+  tunedFrequency.store(frequency);
+}
+
+void dabProcessor::get_afcState(afcState *s) { theAFC.get_state(s); }
+
+void dabProcessor::set_afcState(const afcState *s) { theAFC.set_state(s); }
+
+std::vector<int32_t> dabProcessor::serviceIds(void) {
+  return my_ficHandler.serviceIds();
+}
+
 void dabProcessor::clearEnsemble() { my_ficHandler.reset(); }
 
 bool dabProcessor::wasSecond(int16_t cf, dabParams *p) {
@@ -0,0 +1,152 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#include "channel-estimator.h"
+#include "phasetable.h"
+#include <algorithm>
+
+//	the estimate is averaged over 2 * EST_WINDOW + 1 neighbouring
+//	carriers, and follows the channel over the blocks with
+//	a weight of EST_TRACKING for the new block
+#define EST_WINDOW 2
+#define EST_TRACKING 0.3F
+
+channelEstimator::channelEstimator(uint8_t dabMode)
+    : params(dabMode), myMapper(dabMode) {
+  phaseTable theTable(dabMode);
+  this->T_u = params.get_T_u();
+  this->carriers = params.get_carriers();
+  fftIndex.resize(carriers);
+  bitIndex.resize(carriers);
+  reference.resize(carriers);
+  estimate.resize(carriers);
+  raw.resize(carriers);
+  previous.resize(carriers);
+  phaseDiff.resize(carriers);
+  margin.resize(carriers);
+  //	carrier 0 is not used, the carriers are - for the smoothing -
+  //	numbered from - carriers / 2 to carriers / 2 without it
+  for (int32_t n = 0; n < carriers; n++) {
+    int32_t k = n < carriers / 2 ? n - carriers / 2 : n - carriers / 2 + 1;
+    float Phi_k = theTable.get_Phi(k);
+    fftIndex[n] = k < 0 ? k + T_u : k;
+    reference[n] = std::complex<float>(cosf(Phi_k), sinf(Phi_k));
+  }
+  //	the soft bits of carrier n go to bitIndex [n] and
+  //	carriers + bitIndex [n]
+  for (int32_t i = 0; i < carriers; i++) {
+    int16_t carrier = myMapper.mapIn(i);
+    int32_t n = carrier + carriers / 2 - (carrier < 0 ? 0 : 1);
+    bitIndex[n] = i;
+  }
+  power = 0;
+}
+
+channelEstimator::~channelEstimator(void) {}
+
+//
+//	the FFT of block 0, the phase reference symbol, with known
+//	contents, gives the first estimate of the channel
+void channelEstimator::start(const std::complex<float> *v) {
+  for (int32_t n = 0; n < carriers; n++) {
+    raw[n] = v[fftIndex[n]] * conj(reference[n]);
+    estimate[n] = 0;
+    previous[n] = reference[n];
+    margin[n] = 1e30F;
+  }
+  update(1, 1.0F);
+}
+
+//
+//	The carrier, multiplied by the conjugate of the estimate, is
+//	the symbol weighted with the power of the channel on that
+//	carrier, i.e. a faded carrier gives weak soft bits. The phase
+//	difference with the decided symbol of the previous block gives
+//	the soft bits.
+//	The estimate lags a channel that changes, its phase mostly
+//	changes for all carriers together. As with the clock offset,
+//	the 4th power of the phase differences removes the modulation,
+//	the phase that remains is the correction for this block.
+//	A wrong decision in the previous block would give a strong - and
+//	wrong - soft bit, so the soft bit is limited to the margin of
+//	that decision, the distance to the nearest other symbol.
+//	The soft bits are scaled such that - on average - they are
+//	as large as the ones of the differential demodulation.
+//	The decided symbol of this block then gives a new
+//	measurement of the channel
+void channelEstimator::demap(const std::complex<float> *v, int16_t *ibits) {
+  float scale = 64 / (power + 1e-10F);
+  std::complex<float> drift = 0;
+
+  for (int32_t n = 0; n < carriers; n++) {
+    std::complex<float> d = v[fftIndex[n]] * conj(estimate[n] * previous[n]);
+    std::complex<float> d2 = d * d;
+    drift -= d2 * d2;
+    phaseDiff[n] = d;
+  }
+  std::complex<float> rotator = std::polar(1.0F, arg(drift) / 4);
+  std::complex<float> correction = conj(rotator) * sqrtf(2);
+
+  //	the decided symbol q is (s_re + j * s_im) / sqrt (2), the
+  //	multiplications with q are written out
+  for (int32_t n = 0; n < carriers; n++) {
+    std::complex<float> d = phaseDiff[n] * correction;
+    float re = real(d);
+    float im = imag(d);
+    float s_re = re < 0 ? -1 : 1;
+    float s_im = im < 0 ? -1 : 1;
+    float b_re = std::min(std::min(re * s_re, margin[n]) * scale, 127.0F);
+    float b_im = std::min(std::min(im * s_im, margin[n]) * scale, 127.0F);
+    ibits[bitIndex[n]] = (int16_t)(-s_re * b_re);
+    ibits[carriers + bitIndex[n]] = (int16_t)(-s_im * b_im);
+    float u_re = (re * s_re + im * s_im) / 2;
+    float u_im = (im * s_re - re * s_im) / 2;
+    margin[n] = std::max(u_re - fabsf(u_im), 0.0F);
+    std::complex<float> p = previous[n];
+    previous[n] = std::complex<float>(real(p) * s_re - imag(p) * s_im,
+                                      real(p) * s_im + imag(p) * s_re) /
+                  sqrtf(2);
+    raw[n] = v[fftIndex[n]] * conj(previous[n]);
+  }
+
+  update(rotator, EST_TRACKING);
+}
+
+//
+//	the new estimate, with raw - the measurement of the channel for
+//	each carrier - averaged over the neighbouring carriers, with
+//	a running sum over the window, shorter at the edges
+void channelEstimator::update(std::complex<float> rotator, float weight) {
+  std::complex<float> sum = 0;
+  int32_t low = 0, high = 0;
+
+  power = 0;
+  for (int32_t n = 0; n < carriers; n++) {
+    while (high < carriers && high <= n + EST_WINDOW) sum += raw[high++];
+    while (low < n - EST_WINDOW) sum -= raw[low++];
+    std::complex<float> h = estimate[n] * rotator;
+    estimate[n] = h + (weight / (high - low) * sum - weight * h);
+    power += norm(estimate[n]);
+  }
+  power /= carriers;
+}
@@ -22,6 +22,7 @@
  * 	fib and fig processor
  */
 #include "fib-decoder.h"
+#include <algorithm>
 #include <cstring>
 #include "charsets.h"
 #include "ensemble-handler.h"
@@ -78,11 +79,20 @@ inline static bool existsInTab(int16_t num, const int16_t *tab, int16_t v) {
   return false;
 }
 
+//	the fields of a subchannel as set by FIG0/1
+static bool sameChannel(const channelMap &a, const channelMap &b) {
+  return (a.inUse == b.inUse) && (a.StartAddr == b.StartAddr) &&
+         (a.Length == b.Length) && (a.subChanSize == b.subChanSize) &&
+         (a.shortForm == b.shortForm) &&
+         (a.protIdxOrCase == b.protIdxOrCase) &&
+         (a.protLevel == b.protLevel) && (a.BitRate == b.BitRate);
+}
+
 
 //
 fib_processor::fib_processor(ensemblename_t ensemblenameHandler,
                              programname_t programnameHandler, void *userData)
-    : ensembleidHandler(nullptr) {
+    : ensembleidHandler(nullptr), changeHandler(nullptr) {
   this->ensemblenameHandler = ensemblenameHandler;
   if (programnameHandler == nullptr) fprintf(stderr, "NULL detected\n");
   this->programnameHandler = programnameHandler;
@@ -91,6 +101,8 @@ fib_processor::fib_processor(ensemblename_t ensemblenameHandler,
 
   for (int k = 0; k < 32; ++k) FIG0processingOutput[k] = false;
 
+  dirty = true;
+  generation = 0;
   reset();
 }
 
@@ -112,6 +124,8 @@ void fib_processor::process_FIB(const uint8_t *p, uint16_t fib) {
   int8_t processedBytes = 0;
   const uint8_t *d = p;
   uint16_t hdr;
+  int16_t key;
+  uint64_t hash;
   // uint8_t	extension;
 
   fibLocker.lock();
@@ -123,23 +137,32 @@ void fib_processor::process_FIB(const uint8_t *p, uint16_t fib) {
     FIGtype = getBits_3(d, 0);
     // extension = 0xFF;
 
-    switch (FIGtype) {
-      case 0:
-        // extension	= getBits_5 (d, 8 + 3);  // FIG0
-        process_FIG0(d);
-        break;
-
-      case 1:
-        // extension	= getBits_3 (d, 8 + 5);  // FIG1
-        process_FIG1(d);
-        break;
-
-      case 7:
-        break;
-
-      default:
-        //	         fprintf (stderr, "FIG%d aanwezig\n", FIGtype);
-        break;
+    if (!seenFIG(d, &key, &hash)) {
+      uint32_t before = generation;
+      switch (FIGtype) {
+        case 0:
+          // extension	= getBits_5 (d, 8 + 3);  // FIG0
+          process_FIG0(d);
+          break;
+
+        case 1:
+          // extension	= getBits_3 (d, 8 + 5);  // FIG1
+          process_FIG1(d);
+          break;
+
+        case 7:
+          break;
+
+        default:
+          //	         fprintf (stderr, "FIG%d aanwezig\n", FIGtype);
+          break;
+      }
+      //	a FIG that changed something may have a different effect
+      //	the next time, and so may all others
+      if (generation != before)
+        forgetFIGs();
+      else if (key >= 0)
+        rememberFIG(key, hash);
     }
     //
     //	Thanks to Ronny Kunze, who discovered that I used
@@ -300,6 +323,8 @@ bool fib_processor::FIG0Extension0(const uint8_t *d) {
 
   CIFcount = highpart * 250 + lowpart;
   hasCIFcount = true;
+  ensembleId = EId;
+  ensembleId_Present = true;
 #if OUT_CIF_COUNTER
   fprintf(stderr, "FIG0Extension0: CIFcount %d\n", CIFcount);
 #endif
@@ -367,6 +392,7 @@ int16_t fib_processor::HandleFIG0Extension1(const uint8_t *d, int16_t offset,
   int16_t option, protLevel, subChanSize;
   (void)pd;  // not used right now, maybe later
 
+  channelMap old = subChannels[SubChId];
 #if OUT_FIG0E1
   const char *wasAlreadyInUse = subChannels[SubChId].inUse ? "used" : "free";
 #endif
@@ -448,6 +474,8 @@ int16_t fib_processor::HandleFIG0Extension1(const uint8_t *d, int16_t offset,
 
     bitOffset += 32;
   }
+  if (!sameChannel(old, subChannels[SubChId]))
+    noteChange(DAB_CHANGE_SUBCHANNEL, SubChId);
   return bitOffset / 8;  // we return bytes
 }
 //
@@ -580,8 +608,11 @@ int16_t fib_processor::HandleFIG0Extension3(const uint8_t *d, int16_t used,
   packetComp->DGflag = DGflag;
   packetComp->packetAddress = packetAddress;
 
-  if ( svc && svc->numSubChId < 4 && !existsInTab(svc->numSubChId, svc->SubChId, SubChId) )
-    svc->SubChId[svc->numSubChId++] = SubChId;
+  if (svc != nullptr) {
+    if (svc->numSubChId < 4 && !existsInTab(svc->numSubChId, svc->SubChId, SubChId))
+      svc->SubChId[svc->numSubChId++] = SubChId;
+    noteChange(DAB_CHANGE_COMPONENT, svc->SId);
+  }
 
   if (packetComp->componentNr == 0)  // otherwise sub component
     addtoEnsemble(svc->label, svc->abbr, svc->SId);
@@ -634,7 +665,10 @@ int16_t fib_processor::HandleFIG0Extension5(const uint8_t *d, uint8_t CN_bit,
     if (getBits_1(d, loffset + 1) == 0) {
       subChId = getBits_6(d, loffset + 2);
       language = getBits_8(d, loffset + 8);
-      subChannels[subChId].language = language;
+      if (subChannels[subChId].language != language) {
+        subChannels[subChId].language = language;
+        noteChange(DAB_CHANGE_SUBCHANNEL, subChId);
+      }
       fprintf(stderr, "FIG0Ext5: Short, SubChId %d, language %d\n", (int)subChId, (int)language);
     }
     loffset += 16;
@@ -648,10 +682,88 @@ int16_t fib_processor::HandleFIG0Extension5(const uint8_t *d, uint8_t CN_bit,
   return loffset / 8;
 }
 
-// FIG0/6: Service linking information 8.1.15, not implemented
+//
+//	FIG0/6: Service linking information 8.1.15
+//	The sets are repeated in pieces, the ids of a set are merged.
+//	A field without id list is a change event indication, it only
+//	changes the flags
 bool fib_processor::FIG0Extension6(const uint8_t *d) {
-  (void)d;
-  return false;
+  int16_t used = 2;  // offset in bytes
+  int16_t Length = getBits_5(d, 3);
+  uint8_t OE_bit = getBits_1(d, 8 + 1);
+  uint8_t PD_bit = getBits_1(d, 8 + 2);
+
+  while (used < Length)
+    used = HandleFIG0Extension6(d, used, Length, OE_bit, PD_bit);
+
+  return true;
+}
+
+int16_t fib_processor::HandleFIG0Extension6(const uint8_t *d, int16_t used,
+                                            int16_t Length, uint8_t OE_bit,
+                                            uint8_t PD_bit) {
+  int16_t lOffset = used * 8;
+  uint8_t idListFlag = getBits_1(d, lOffset);
+  bool LA = getBits_1(d, lOffset + 1) != 0;
+  bool SH = getBits_1(d, lOffset + 2) != 0;
+  bool ILS = getBits_1(d, lOffset + 3) != 0;
+  uint16_t LSN = getBits(d, lOffset + 4, 12);
+  uint8_t IdLQ = 0;
+  int16_t nIds = 0;
+  int16_t idSize = PD_bit == 1 ? 4 : ILS ? 3 : 2;
+
+  (void)OE_bit;
+  if (idListFlag == 1) {
+    IdLQ = getBits_2(d, lOffset + 16 + 1);
+    nIds = getBits_4(d, lOffset + 16 + 4);
+    if (used + 3 + nIds * idSize > Length + 1)  // does not fit
+      return Length + 1;
+  }
+
+  bool changed = false;
+  auto it = linkageSets.find(LSN);
+  if (it == linkageSets.end()) {
+    it = linkageSets.emplace(LSN, linkageSet()).first;
+    it->second.LSN = LSN;
+    changed = true;
+  }
+  linkageSet &set = it->second;
+  if ((set.active != LA) || (set.hard != SH) || (set.international != ILS))
+    changed = true;
+  set.active = LA;
+  set.hard = SH;
+  set.international = ILS;
+
+  if (idListFlag == 0) {
+    if (changed) noteChange(DAB_CHANGE_LINKAGE, LSN);
+    return used + 2;
+  }
+
+  lOffset += 24;
+  for (int16_t i = 0; i < nIds; i++) {
+    linkedId l;
+    l.IdLQ = IdLQ;
+    l.ecc = 0;
+    if (PD_bit == 1)
+      l.id = getLBits(d, lOffset, 32);
+    else if (ILS) {
+      l.ecc = getBits_8(d, lOffset);
+      l.id = getBits(d, lOffset + 8, 16);
+    } else
+      l.id = getBits(d, lOffset, 16);
+    lOffset += idSize * 8;
+
+    bool known = false;
+    for (auto const &k : set.ids)
+      if ((k.IdLQ == l.IdLQ) && (k.ecc == l.ecc) && (k.id == l.id))
+        known = true;
+    if (!known) {
+      set.ids.push_back(l);
+      changed = true;
+    }
+  }
+  if (changed) noteChange(DAB_CHANGE_LINKAGE, LSN);
+  return lOffset / 8;
 }
 
 // FIG0/7: Configuration linking information 6.4.2, not implemented
@@ -693,15 +805,19 @@ int16_t fib_processor::HandleFIG0Extension8(const uint8_t *d, int16_t used,
   lOffset += 8;
 
   serviceId *svc = findServiceId(SId);
-  if ( svc && svc->numSCIds < 4 && !existsInTab(svc->numSCIds, svc->SCIds, SCIds) )
+  if ( svc && svc->numSCIds < 4 && !existsInTab(svc->numSCIds, svc->SCIds, SCIds) ) {
     svc->SCIds[svc->numSCIds++] = SCIds;
+    noteChange();
+  }
 
   lsFlag = getBits_1(d, lOffset);
   if (lsFlag == 1) {
     SCid = getBits(d, lOffset + 4, 12);
     lOffset += 16;
-    if ( svc && svc->numSCid < 4 && !existsInTab(svc->numSCid, svc->SCid, SCid) )
+    if ( svc && svc->numSCid < 4 && !existsInTab(svc->numSCid, svc->SCid, SCid) ) {
       svc->SCid[svc->numSCid++] = SCid;
+      noteChange();
+    }
     //           if (find_packetComponent ((SCIds << 4) | SCid) != nullptr) {
     //              fprintf (stderr, "packet component bestaat !!\n");
     //           }
@@ -709,8 +825,10 @@ int16_t fib_processor::HandleFIG0Extension8(const uint8_t *d, int16_t used,
     MSCflag = getBits_1(d, lOffset + 1);
     SubChId = getBits_6(d, lOffset + 2);
     lOffset += 8;
-    if ( svc && svc->numSubChId < 4 && !existsInTab(svc->numSubChId, svc->SubChId, SubChId) )
+    if ( svc && svc->numSubChId < 4 && !existsInTab(svc->numSubChId, svc->SubChId, SubChId) ) {
       svc->SubChId[svc->numSubChId++] = SubChId;
+      noteChange();
+    }
   }
   if (extensionFlag) lOffset += 8;  // skip Rfa
   (void)SId;
@@ -824,9 +942,11 @@ int16_t fib_processor::HandleFIG0Extension13(const uint8_t *d, int16_t used,
     int16_t length = getBits_5(d, lOffset + 11);
     lOffset += (11 + 5 + 8 * length);
     serviceComponent *packetComp = find_serviceComponent(SId, SCIds);
-    if (packetComp != nullptr) {
+    if ((packetComp != nullptr) &&
+        ((packetComp->SCIds != SCIds) || (packetComp->appType != appType))) {
       packetComp->SCIds = SCIds;
       packetComp->appType = appType;
+      noteChange(DAB_CHANGE_COMPONENT, SId);
     }
   }
 
@@ -844,8 +964,10 @@ bool fib_processor::FIG0Extension14(const uint8_t *d) {
     uint8_t FEC_scheme = getBits_2(d, used * 8 + 6);
     used = used + 1;
     for (i = 0; i < 64; i++) {
-      if (subChannels[i].SubChId == SubChId) {
+      if ((subChannels[i].SubChId == SubChId) &&
+          (subChannels[i].FEC_scheme != FEC_scheme)) {
         subChannels[i].FEC_scheme = FEC_scheme;
+        noteChange(DAB_CHANGE_SUBCHANNEL, SubChId);
       }
     }
   }
@@ -871,6 +993,7 @@ bool fib_processor::FIG0Extension16(const uint8_t *d) {
       uint8_t PNum = getBits(d, offset + 16, 16);
       s->pNum = PNum;
       s->hasPNum = true;
+      noteChange();
       fprintf(stderr, "FIG0Ext16: Program number info for SID %08X, PNum %d\n", SId, (int)PNum);
     }
     offset += 72;
@@ -894,13 +1017,19 @@ bool fib_processor::FIG0Extension17(const uint8_t *d) {
     s = findServiceId(SId);
     if (L_flag) {  // language field present
       Language = getBits_8(d, offset + 24);
-      s->language = Language;
-      s->hasLanguage = true;
+      if (!s->hasLanguage || (s->language != Language)) {
+        s->language = Language;
+        s->hasLanguage = true;
+        noteChange(DAB_CHANGE_SERVICE, SId);
+      }
       offset += 8;
     }
 
     type = getBits_5(d, offset + 27);
-    s->programType = type;
+    if (s->programType != type) {
+      s->programType = type;
+      noteChange(DAB_CHANGE_SERVICE, SId);
+    }
     if (CC_flag)  // cc flag
       offset += 40;
     else
@@ -987,6 +1116,10 @@ bool fib_processor::FIG0Extension21(const uint8_t *d) {
   return true;
 }
 
+//
+//	Of the frequency lists, the ones for DAB ensembles (R&M 0000),
+//	FM (R&M 1000 and 1001) and AM (R&M 1010 and 1011) are kept,
+//	DRM and AMSS are skipped
 int16_t fib_processor::HandleFIG0Extension21(const uint8_t *d, uint8_t CN_bit,
                                              uint8_t OE_bit, uint8_t PD_bit,
                                              int16_t offset) {
@@ -996,31 +1129,83 @@ int16_t fib_processor::HandleFIG0Extension21(const uint8_t *d, uint8_t CN_bit,
   int16_t base = l_offset + 16;
 
   (void)CN_bit;
-  (void)OE_bit, (void)PD_bit;
+  (void)PD_bit;
 
   while (base < upperLimit) {
-    //uint16_t idField = getBits(d, base, 16);
+    uint16_t idField = getBits(d, base, 16);
     uint8_t RandM = getBits_4(d, base + 16);
     uint8_t continuity = getBits_1(d, base + 20);
-    (void)continuity;
     uint8_t length = getBits_3(d, base + 21);
-    if (RandM == 0x08) {
-      uint16_t fmFrequency_key = getBits(d, base + 24, 8);
-      int32_t fmFrequency = 87500 + fmFrequency_key * 100;
-      (void)fmFrequency;
-      //int16_t serviceIndex = findService(idField);
-      //if (serviceIndex != -1) {
-      //  if ((ensemble->services[serviceIndex].hasName) &&
-      //      (ensemble->services[serviceIndex].fmFrequency == -1))
-      //    ensemble->services[serviceIndex].fmFrequency = fmFrequency;
-      //}
+    int16_t f = base + 24;
+    std::vector<int32_t> frequencies;
+
+    if (base + 24 + length * 8 > upperLimit) break;
+    switch (RandM) {
+      case 0x00:  // DAB ensemble, 19 bits in units of 16 KHz
+        for (int16_t k = 0; k + 3 <= length; k += 3)
+          frequencies.push_back(getLBits(d, f + k * 8 + 5, 19) * 16);
+        break;
+
+      case 0x08:  // FM with RDS
+      case 0x09:  // FM without RDS
+        for (int16_t k = 0; k < length; k++) {
+          uint8_t code = getBits_8(d, f + k * 8);
+          if ((code >= 1) && (code <= 204))
+            frequencies.push_back(87500 + code * 100);
+        }
+        break;
+
+      case 0x0a:  // AM, MW in 9 KHz steps and LW
+        for (int16_t k = 0; k < length; k++) {
+          uint8_t code = getBits_8(d, f + k * 8);
+          if (code != 0) frequencies.push_back(144 + code * 9);
+        }
+        break;
+
+      case 0x0b:  // AM, MW in 5 KHz steps and SW
+        for (int16_t k = 0; k + 2 <= length; k += 2)
+          frequencies.push_back(getBits(d, f + k * 8, 16) * 5);
+        break;
+
+      default:
+        break;
     }
+    if (!frequencies.empty())
+      addFrequencies(idField, RandM, continuity != 0, OE_bit != 0,
+                     frequencies);
     base += 24 + length * 8;
   }
 
   return upperLimit / 8;
 }
 
+//	the frequencies are merged with those known for the id
+void fib_processor::addFrequencies(uint16_t id, uint8_t RandM, bool continuity,
+                                   bool otherEnsemble,
+                                   const std::vector<int32_t> &frequencies) {
+  uint32_t key = (RandM << 16) | id;
+  bool changed = false;
+  auto it = frequencyLists.find(key);
+  if (it == frequencyLists.end()) {
+    it = frequencyLists.emplace(key, frequencyList()).first;
+    it->second.id = id;
+    it->second.RandM = RandM;
+    changed = true;
+  }
+  frequencyList &list = it->second;
+  if ((list.continuity != continuity) || (list.otherEnsemble != otherEnsemble))
+    changed = true;
+  list.continuity = continuity;
+  list.otherEnsemble = otherEnsemble;
+  for (int32_t f : frequencies)
+    if (std::find(list.frequencies.begin(), list.frequencies.end(), f) ==
+        list.frequencies.end()) {
+      list.frequencies.push_back(f);
+      changed = true;
+    }
+  if (changed) noteChange(DAB_CHANGE_FREQUENCY, id);
+}
+
 //
 //      Obsolete in ETSI EN 300 401 V2.1.1 (2017-01)
 bool fib_processor::FIG0Extension22(const uint8_t *d) {
@@ -1078,10 +1263,40 @@ bool fib_processor::FIG0Extension23(const uint8_t *d) {
   return false;
 }
 //
-//      OE Services
+//      OE Services 8.1.10, the other ensembles a service is in
 bool fib_processor::FIG0Extension24(const uint8_t *d) {
-  (void)d;
-  return false;
+  int16_t used = 2;  // offset in bytes
+  int16_t Length = getBits_5(d, 3);
+  uint8_t PD_bit = getBits_1(d, 8 + 2);
+
+  while (used < Length)
+    used = HandleFIG0Extension24(d, used, Length, PD_bit);
+
+  return true;
+}
+
+int16_t fib_processor::HandleFIG0Extension24(const uint8_t *d, int16_t used,
+                                             int16_t Length, uint8_t PD_bit) {
+  int16_t lOffset = used * 8;
+  int16_t SIdSize = PD_bit == 1 ? 32 : 16;
+  int32_t SId = getLBits(d, lOffset, SIdSize);
+  int16_t nEIds = getBits_4(d, lOffset + SIdSize + 4);
+  bool changed = false;
+
+  if (used + SIdSize / 8 + 1 + 2 * nEIds > Length + 1)  // does not fit
+    return Length + 1;
+  lOffset += SIdSize + 8;
+  std::vector<int32_t> &EIds = oeServices[SId];
+  for (int16_t i = 0; i < nEIds; i++) {
+    int32_t EId = getBits(d, lOffset, 16);
+    lOffset += 16;
+    if (std::find(EIds.begin(), EIds.end(), EId) == EIds.end()) {
+      EIds.push_back(EId);
+      changed = true;
+    }
+  }
+  if (changed) noteChange(DAB_CHANGE_OE_SERVICE, SId);
+  return lOffset / 8;
 }
 //
 //      OE Announcement support
@@ -1172,6 +1387,10 @@ void fib_processor::process_FIG1(const uint8_t *d) {
         else {
           std::string name = toStringUsingCharset(label, (CharacterSet)charSet);
           std::string abbr = toStringUsingCharset(abbrev, (CharacterSet)charSet);
+          if (firstTimeEName || (name != ensembleLabel)) {
+            ensembleLabel = name;
+            noteChange(DAB_CHANGE_ENSEMBLE, SId);
+          }
           // without idofEnsemble: just report one name
           if (ensembleidHandler != nullptr || firstTimeEName)
             nameofEnsemble(SId, name, abbr);
@@ -1186,21 +1405,27 @@ void fib_processor::process_FIG1(const uint8_t *d) {
       SId = getBits(d, 16, 16);
       offset = 32;
       myIndex = findServiceId(SId);
-      if ( myIndex && (!myIndex->hasName) && (charSet <= 16)) {
+      if ( myIndex && (charSet <= 16)) {
 
         writeLabel( d, offset,  label, abbrev, SId, -1, "ext1: programme name", 0 & OUT_ALL_LABELS );
 
-        if (UnicodeUcs2 == (CharacterSet)charSet)
-          fprintf(stderr,
-                  "warning: ignoring service label cause of "
-                  "unimplemented Ucs2 conversion\n");
+        if (UnicodeUcs2 == (CharacterSet)charSet) {
+          if (!myIndex->hasName)
+            fprintf(stderr,
+                    "warning: ignoring service label cause of "
+                    "unimplemented Ucs2 conversion\n");
+        }
         else {
           std::string appStr = toStringUsingCharset(label, (CharacterSet)charSet);
           std::string abbr = toStringUsingCharset(abbrev, (CharacterSet)charSet);
-          strcat(myIndex->label, appStr.c_str());
-          strcat(myIndex->abbr, abbr.c_str());
-          // fprintf (stderr, "FIG1/1: SId = %4x\t%s\n", SId, label);
-          myIndex->hasName = true;
+          //	a known service may get another label
+          if (!myIndex->hasName || (appStr != myIndex->label)) {
+            snprintf(myIndex->label, sizeof(myIndex->label), "%s", appStr.c_str());
+            snprintf(myIndex->abbr, sizeof(myIndex->abbr), "%s", abbr.c_str());
+            // fprintf (stderr, "FIG1/1: SId = %4x\t%s\n", SId, label);
+            myIndex->hasName = true;
+            noteChange(DAB_CHANGE_SERVICE, SId);
+          }
         }
       }
       break;
@@ -1237,6 +1462,7 @@ void fib_processor::process_FIG1(const uint8_t *d) {
           strcpy( packetComp->label, name.c_str() );
           strcpy( packetComp->abbr, abbr.c_str() );
           packetComp->hasLabel = true;
+          noteChange(DAB_CHANGE_COMPONENT, SId);
         }
       }
       break;
@@ -1259,6 +1485,7 @@ void fib_processor::process_FIG1(const uint8_t *d) {
           strcat(myIndex->label, appStr.c_str());
           strcat(myIndex->abbr, abbr.c_str());
           myIndex->hasName = true;
+          noteChange(DAB_CHANGE_SERVICE, SId);
           addtoEnsemble(myIndex->label, myIndex->abbr, SId);
         }
       }
@@ -1312,142 +1539,79 @@ static int compareNames(std::string in, std::string ref) {
   return PREFIX_MATCH;
 }
 
-//	locate - and create if needed - a reference to the entry
-//	for the serviceId serviceId
-serviceId *fib_processor::findServiceId(int32_t serviceId) {
-  int16_t i;
-
-  for (i = 0; i < 64; i++) {
-    if ((listofServices[i].inUse) &&
-        (listofServices[i].SId == serviceId))
-      return &listofServices[i];
-  }
-
-  for (i = 0; i < 64; i++) {
-    if (!listofServices[i].inUse) {
-      listofServices[i].inUse = true;
-      listofServices[i].SId = serviceId;
-      return &listofServices[i];
-    }
-  }
-
-  listofServices[64].inUse = false;
-  return &listofServices[64];  // should not happen
+//	the key for the label index
+static std::string normalisedName(const std::string &s) {
+  size_t end = s.find_last_not_of(' ');
+  return end == std::string::npos ? std::string() : s.substr(0, end + 1);
 }
-//
-//	since some servicenames are long, we allow selection of a
-//	service based on the first few letters/digits of the name.
-//	However, in case of servicenames where one is a prefix
-//	of the other, the full match should have precedence over the
-//	prefix match
-serviceId *fib_processor::findServiceId(std::string serviceName, bool fullMatchOnly) {
-  int16_t i;
-  int indexforprefixMatch = -1;
 
-  for (i = 0; i < 64; i++) {
-    if (listofServices[i].inUse) {
-      int res = compareNames(serviceName, listofServices[i].label);
-      if (res == FULL_MATCH) {
-        return &listofServices[i];
-      }
-      if (res == PREFIX_MATCH) {
-        indexforprefixMatch = i;
-      }
-    }
-  }
+//	locate - and create if needed - a reference to the entry
+//	for the serviceId SId
+serviceId *fib_processor::findServiceId(int32_t SId) {
+  auto it = serviceIndex.find(SId);
+  if (it != serviceIndex.end()) return it->second;
 
-  if (fullMatchOnly)
-      return nullptr;
-  return indexforprefixMatch >= 0 ? &listofServices[indexforprefixMatch]
-                                  : nullptr;
+  listofServices.emplace_back();
+  serviceId *s = &listofServices.back();
+  s->inUse = true;
+  s->SId = SId;
+  serviceIndex[SId] = s;
+  noteChange();
+  return s;
 }
 
 serviceComponent *fib_processor::find_packetComponent(int16_t SubChId, int16_t SCId) {
-  int16_t i;
-
-  for (i = 0; i < 64; i++) {
-    if (!ServiceComps[i].inUse) continue;
-    if (ServiceComps[i].TMid != 03) continue;
-    //if (ServiceComps[i].subchannelId == SubChId && ServiceComps[i].SCId == SCId)
-    if (ServiceComps[i].SCId == SCId)
-      return &ServiceComps[i];
-  }
-  return nullptr;
+  (void)SubChId;
+  auto it = packetIndex.find(SCId);
+  return it == packetIndex.end() ? nullptr : it->second;
 }
 
 serviceComponent *fib_processor::find_serviceComponent(int32_t SId,
                                                        int16_t SCIdS) {
-  int16_t i;
   (void)SCIdS;
-
-  for (i = 0; i < 64; i++) {
-    if (!ServiceComps[i].inUse) continue;
-
-    if ( ServiceComps[i].service
-      && ServiceComps[i].service->inUse
-      && ServiceComps[i].service->SId == SId )
-    {
-      return &ServiceComps[i];
-    }
-  }
-
-  return nullptr;
+  auto it = componentIndex.find(SId);
+  if ((it == componentIndex.end()) || it->second.empty()) return nullptr;
+  return it->second.front();
 }
 
 serviceComponent *fib_processor::find_serviceComponentNr(int32_t SId,
                                                 int16_t componentNr) {
-  int16_t i;
-
-  for (i = 0; i < 64; i++) {
-    if (!ServiceComps[i].inUse) continue;
-
-    if ( ServiceComps[i].componentNr == componentNr
-      && ServiceComps[i].service
-      && ServiceComps[i].service->inUse
-      && ServiceComps[i].service->SId == SId )
-    {
-      return &ServiceComps[i];
-    }
-  }
-
+  auto it = componentIndex.find(SId);
+  if (it == componentIndex.end()) return nullptr;
+  for (auto c : it->second)
+    if (c->componentNr == componentNr) return c;
   return nullptr;
 }
 
-serviceComponent *find_serviceComponentNr(int32_t SId, int16_t componentNr);
-
 //	bind_audioService is the main processor for - what the name suggests -
 //	connecting the description of audioservices to a SID
 void fib_processor::bind_audioService(int8_t TMid, uint32_t SId, int16_t compnr,
                                       int16_t SubChId, int16_t ps_flag,
                                       int16_t ASCTy) {
   serviceId *s = findServiceId(SId);
-  int16_t i;
-  int16_t firstFree = -1;
 
   if (!s->hasName) return;
 
   if (!subChannels[SubChId].inUse) return;
 
-  for (i = 0; i < 64; i++) {
-    if (!ServiceComps[i].inUse) {
-      if (firstFree == -1) firstFree = i;
-      continue;
-    }
-    if ((ServiceComps[i].service == s) &&
-        (ServiceComps[i].componentNr == compnr))
-      return;
-  }
+  std::vector<serviceComponent *> &comps = componentIndex[SId];
+  for (auto c : comps)
+    if (c->componentNr == compnr) return;
+
+  ServiceComps.emplace_back();
+  serviceComponent *c = &ServiceComps.back();
+  c->inUse = true;
+  c->compType = 'A';
+  c->TMid = TMid;
+  c->componentNr = compnr;
+  c->service = s;
+  c->subchannelId = SubChId;
+  c->PS_flag = ps_flag;
+  c->ASCTy = ASCTy;
+  comps.push_back(c);
+  noteChange(DAB_CHANGE_COMPONENT, SId);
 
   addtoEnsemble(s->label, s->abbr, s->SId);
-
-  ServiceComps[firstFree].inUse = true;
-  ServiceComps[firstFree].compType = 'A';
-  ServiceComps[firstFree].TMid = TMid;
-  ServiceComps[firstFree].componentNr = compnr;
-  ServiceComps[firstFree].service = s;
-  ServiceComps[firstFree].subchannelId = SubChId;
-  ServiceComps[firstFree].PS_flag = ps_flag;
-  ServiceComps[firstFree].ASCTy = ASCTy;
 }
 
 //      bind_packetService is the main processor for - what the name suggests -
@@ -1457,176 +1621,248 @@ void fib_processor::bind_packetService(int8_t TMid, uint32_t SId,
                                        int16_t compnr, int16_t SCId,
                                        int16_t ps_flag, int16_t CAflag) {
   serviceId *s = findServiceId(SId);
-  int16_t i;
-  int16_t firstFree = -1;
 
   // no need to wait for serviceLabel
   // Jan: if (!ensemble -> services [serviceIndex]. hasName)  - with class ensembleDescriptor * ensemble
   if (!s || !s->hasName)  // wait until we have a name
     return;
 
-  for (i = 0; i < 64; i++) {
-    if ( ServiceComps[i].inUse
-        && ServiceComps[i].service == s  // this was 2nd source of bug missing PACKET DATA
-                                         // see https://github.com/JvanKatwijk/dab-cmdline/pull/69
-        && ServiceComps[i].componentNr == compnr && ServiceComps[i].SCId == SCId )
-      return;
-
-    if (!ServiceComps[i].inUse) {
-      if (firstFree == -1) firstFree = i;
-      continue;
-    }
-  }
-
-  ServiceComps[firstFree].inUse = true;
-  ServiceComps[firstFree].compType = 'P';
-  ServiceComps[firstFree].TMid = TMid;
-  ServiceComps[firstFree].service = s;
-  ServiceComps[firstFree].componentNr = compnr;
-  ServiceComps[firstFree].SCId = SCId;
-  ServiceComps[firstFree].PS_flag = ps_flag;
-  ServiceComps[firstFree].CAflag = CAflag;
+  // the service is part of the key, see
+  // https://github.com/JvanKatwijk/dab-cmdline/pull/69
+  std::vector<serviceComponent *> &comps = componentIndex[SId];
+  for (auto c : comps)
+    if ((c->componentNr == compnr) && (c->SCId == SCId)) return;
+
+  ServiceComps.emplace_back();
+  serviceComponent *c = &ServiceComps.back();
+  c->inUse = true;
+  c->compType = 'P';
+  c->TMid = TMid;
+  c->service = s;
+  c->componentNr = compnr;
+  c->SCId = SCId;
+  c->PS_flag = ps_flag;
+  c->CAflag = CAflag;
+  comps.push_back(c);
+  packetIndex.emplace(SCId, c);
+  noteChange(DAB_CHANGE_COMPONENT, SId);
 }
 
 void fib_processor::clearEnsemble(void) {
   int16_t i;
+  fibLocker.lock();
   isSynced = false;
   coordinates.cleanUp();
-  for (i = 0; i < 64; i++)
-    listofServices[i].clear();
-  for (i = 0; i < 64; i++)
-    ServiceComps[i].clear();
+  componentIndex.clear();
+  packetIndex.clear();
+  serviceIndex.clear();
+  ServiceComps.clear();
+  listofServices.clear();
   for (i = 0; i < 64; i++)
     subChannels[i].clear();
+  linkageSets.clear();
+  frequencyLists.clear();
+  oeServices.clear();
   firstTimeEId = true;
   firstTimeEName = true;
+  ensembleLabel.clear();
+  noteChange(DAB_CHANGE_CLEARED, 0);
+  forgetFIGs();
+  buildSnapshot();
+  fibLocker.unlock();
 }
 
-std::string fib_processor::nameFor(int32_t serviceId) {
-  int16_t i;
-
-  for (i = 0; i < 64; i++) {
-    if (!listofServices[i].inUse) continue;
+//	with fibLocker locked. The reports wait for publishSnapshot
+void fib_processor::noteChange(void) {
+  generation++;
+  dirty = true;
+}
 
-    if (!listofServices[i].hasName) continue;
+void fib_processor::noteChange(int16_t kind, int32_t id) {
+  noteChange();
+  if (changeHandler != nullptr)
+    pendingChanges.push_back({generation, kind, id});
+}
 
-    if (listofServices[i].SId == serviceId) {
-      return listofServices[i].label;
-    }
+//
+//	The hash covers the whole FIG, i.e. type, extension and
+//	payload (FNV-1a). FIG 0/0 - with the CIF counter - differs
+//	each time and is not looked at, as are FIGs not processed
+bool fib_processor::seenFIG(const uint8_t *d, int16_t *key, uint64_t *hash) {
+  uint8_t FIGtype = getBits_3(d, 0);
+  int16_t length = getBits_5(d, 3);
+  uint64_t h = 14695981039346656037ULL;
+
+  *key = -1;
+  if (FIGtype == 0) {
+    if (getBits_5(d, 8 + 3) != 0) *key = getBits_5(d, 8 + 3);
+  } else if (FIGtype == 1)
+    *key = 32 + getBits_3(d, 8 + 5);
+  if (*key < 0) return false;
+
+  for (int16_t i = 0; i <= length; i++) {
+    h ^= getBits_8(d, 8 * i);
+    h *= 1099511628211ULL;
   }
-  return "no service found";
+  *hash = h;
+  for (int16_t i = 0; i < figFill[*key]; i++)
+    if (figHashes[*key][i] == h) return true;
+  return false;
 }
 
-int32_t fib_processor::SIdFor(std::string &name) {
-  int16_t i;
-  int serviceIndex = -1;
-
-  for (i = 0; i < 64; i++) {
-    if (!listofServices[i].inUse) continue;
+//	the history per FIG type is a small ring, the oldest is replaced
+void fib_processor::rememberFIG(int16_t key, uint64_t hash) {
+  figHashes[key][figNext[key]] = hash;
+  figNext[key] = (figNext[key] + 1) % FIG_HISTORY;
+  if (figFill[key] < FIG_HISTORY) figFill[key]++;
+}
 
-    if (!listofServices[i].hasName) continue;
+void fib_processor::forgetFIGs(void) {
+  for (int16_t i = 0; i < FIG_KEYS; i++) {
+    figFill[i] = 0;
+    figNext[i] = 0;
+  }
+}
 
-    int res = compareNames(name, listofServices[i].label);
-    if (res == NO_MATCH) continue;
-    if (res == PREFIX_MATCH) {
-      serviceIndex = i;
-      continue;
+//
+//	The snapshot is built by the FIC thread, with fibLocker
+//	locked, when the tables changed: at the end of the FIC
+//	part of a frame, and before telling the world about a new
+//	service or ensemble, such that the handlers see it.
+//	Readers take a reference to the current snapshot and are
+//	never bothered by the FIC thread.
+void fib_processor::buildSnapshot(void) {
+  if (!dirty) return;
+  dirty = false;
+
+  std::shared_ptr<fibSnapshot> snap = std::make_shared<fibSnapshot>();
+  snap->generation = generation;
+  for (auto const &svc : listofServices) {
+    if (!svc.hasName) continue;
+    fibService fs;
+    fs.SId = svc.SId;
+    fs.label = svc.label;
+    auto it = componentIndex.find(svc.SId);
+    if (it != componentIndex.end()) {
+      for (auto c : it->second) {
+        fibComponent fc;
+        fc.componentNr = c->componentNr;
+        fc.TMid = c->TMid;
+        fc.ad.defined = false;
+        fc.pd.defined = false;
+        if (c->TMid == 00)
+          fill_audioData(&svc, c, &fc.ad);
+        else if (c->TMid == 03)
+          fill_packetData(c, &fc.pd);
+        fs.components.push_back(fc);
+      }
     }
-    //	it is a FULL match:
-    return listofServices[i].SId;
+    int32_t index = snap->services.size();
+    snap->bySId[fs.SId] = index;
+    snap->byLabel.emplace(normalisedName(fs.label), index);
+    snap->services.push_back(std::move(fs));
   }
-  if (serviceIndex >= 0) return listofServices[serviceIndex].SId;
-  return -1;
+  snap->linkage = linkageSets;
+  snap->frequencies = frequencyLists;
+  snap->otherEnsembles = oeServices;
+  std::atomic_store(&currentSnapshot,
+                    std::shared_ptr<const fibSnapshot>(snap));
 }
-//
-//	Here we look for a primary service only
-uint8_t fib_processor::kindofService(std::string &s) {
-  int16_t i, j;
-  int16_t service = UNKNOWN_SERVICE;
-  int32_t selectedService = -1;
-  int serviceIndex = -1;
 
+//
+//	the changes are reported after the snapshot telling about
+//	them is there, and without the lock
+void fib_processor::publishSnapshot(void) {
+  std::vector<fibChange> changes;
+  ensembleChange_t handler;
   fibLocker.lock();
-  //	first we locate the serviceId
-  for (i = 0; i < 64; i++) {
-    int res;
-    if (!listofServices[i].inUse) continue;
-
-    if (!listofServices[i].hasName) continue;
+  buildSnapshot();
+  changes.swap(pendingChanges);
+  handler = changeHandler;
+  fibLocker.unlock();
+  if (handler == nullptr) return;
+  for (auto const &c : changes) handler(c.generation, c.kind, c.id, userData);
+}
 
-    res = compareNames(s, listofServices[i].label);
-    if (res == NO_MATCH) continue;
-    if (res == PREFIX_MATCH) {
-      serviceIndex = i;
-      continue;
-    }
-    serviceIndex = i;
-    break;
-  }
+std::shared_ptr<const fibSnapshot> fib_processor::snapshot(void) const {
+  return std::atomic_load(&currentSnapshot);
+}
 
-  if (serviceIndex != -1) {
-    selectedService = listofServices[serviceIndex].SId;
-    for (j = 0; j < 64; j++) {
-      if (!ServiceComps[j].inUse) continue;
-      if (selectedService != ServiceComps[j].service->SId)
-        continue;
+static const fibService *serviceFor(const fibSnapshot *snap, int32_t SId) {
+  auto it = snap->bySId.find(SId);
+  return it == snap->bySId.end() ? nullptr : &snap->services[it->second];
+}
 
-      if (ServiceComps[j].componentNr != 0) continue;
+//
+//	since some servicenames are long, we allow selection of a
+//	service based on the first few letters/digits of the name.
+//	However, in case of servicenames where one is a prefix
+//	of the other, the full match should have precedence over the
+//	prefix match. The index handles the common case, a name as
+//	given by the FIC
+static const fibService *serviceFor(const fibSnapshot *snap,
+                                    const std::string &name,
+                                    bool fullMatchOnly) {
+  const fibService *prefixMatch = nullptr;
+  auto it = snap->byLabel.find(normalisedName(name));
+  if (it != snap->byLabel.end()) return &snap->services[it->second];
+
+  for (auto const &s : snap->services) {
+    int res = compareNames(name, s.label);
+    if (res == FULL_MATCH) return &s;
+    if (res == PREFIX_MATCH) prefixMatch = &s;
+  }
+  return fullMatchOnly ? nullptr : prefixMatch;
+}
 
-      if (ServiceComps[j].TMid == 03) {
-        service = PACKET_SERVICE;
-        break;
-      }
+static const fibComponent *componentFor(const fibService *s, int8_t TMid,
+                                        int16_t compnr) {
+  if (s == nullptr) return nullptr;
+  for (auto const &c : s->components)
+    if ((c.TMid == TMid) && (c.componentNr == compnr)) return &c;
+  return nullptr;
+}
 
-      if (ServiceComps[j].TMid == 00) {
-        service = AUDIO_SERVICE;
-        break;
-      }
-    }
+//	Here we look for a primary service only
+static uint8_t kindof(const fibService *s) {
+  if (s == nullptr) return UNKNOWN_SERVICE;
+  for (auto const &c : s->components) {
+    if (c.componentNr != 0) continue;
+    if (c.TMid == 03) return PACKET_SERVICE;
+    if (c.TMid == 00) return AUDIO_SERVICE;
   }
-  fibLocker.unlock();
-  return service;
+  return UNKNOWN_SERVICE;
 }
-//
-//	Here we look for a primary service only
-uint8_t fib_processor::kindofService(int32_t SId) {
-  int16_t i, j;
-  int16_t service = UNKNOWN_SERVICE;
-  int32_t selectedService = -1;
-  int serviceIndex = -1;
 
-  fibLocker.lock();
-  //	first we locate the serviceId
-  for (i = 0; i < 64; i++) {
-    if (!listofServices[i].inUse) continue;
-    if (!listofServices[i].hasName) continue;
-    if ( listofServices[i].SId != SId ) continue;
-    serviceIndex = i;
-    break;
-  }
+std::string fib_processor::nameFor(int32_t SId) {
+  std::shared_ptr<const fibSnapshot> snap = snapshot();
+  const fibService *s = serviceFor(snap.get(), SId);
+  return s != nullptr ? s->label : "no service found";
+}
 
-  if (serviceIndex != -1) {
-    selectedService = listofServices[serviceIndex].SId;
-    for (j = 0; j < 64; j++) {
-      if (!ServiceComps[j].inUse) continue;
-      if (selectedService != ServiceComps[j].service->SId)
-        continue;
+//	the services with a name, in the order they were found
+std::vector<int32_t> fib_processor::serviceIds(void) {
+  std::shared_ptr<const fibSnapshot> snap = snapshot();
+  std::vector<int32_t> result;
 
-      if (ServiceComps[j].componentNr != 0) continue;
+  for (auto const &s : snap->services) result.push_back(s.SId);
+  return result;
+}
 
-      if (ServiceComps[j].TMid == 03) {
-        service = PACKET_SERVICE;
-        break;
-      }
+int32_t fib_processor::SIdFor(std::string &name) {
+  std::shared_ptr<const fibSnapshot> snap = snapshot();
+  const fibService *s = serviceFor(snap.get(), name, false);
+  return s != nullptr ? s->SId : -1;
+}
 
-      if (ServiceComps[j].TMid == 00) {
-        service = AUDIO_SERVICE;
-        break;
-      }
-    }
-  }
-  fibLocker.unlock();
-  return service;
+uint8_t fib_processor::kindofService(std::string &name) {
+  std::shared_ptr<const fibSnapshot> snap = snapshot();
+  return kindof(serviceFor(snap.get(), name, false));
+}
+
+uint8_t fib_processor::kindofService(int32_t SId) {
+  std::shared_ptr<const fibSnapshot> snap = snapshot();
+  return kindof(serviceFor(snap.get(), SId));
 }
 
 void fib_processor::dataforDataService(std::string &s, packetdata *d) {
@@ -1635,90 +1871,66 @@ void fib_processor::dataforDataService(std::string &s, packetdata *d) {
 
 void fib_processor::dataforDataService(std::string &s, packetdata *d,
                                        int16_t compnr) {
-  serviceId *selectedService;
+  std::shared_ptr<const fibSnapshot> snap = snapshot();
+  const fibComponent *c =
+      componentFor(serviceFor(snap.get(), s, true), 03, compnr);
 
   d->defined = false;  // always a decent default
-  fibLocker.lock();
-  const bool fullMatchOnly = true;
-  selectedService = findServiceId(s, fullMatchOnly);
-  if (selectedService == nullptr) {
-    fibLocker.unlock();
-    return;
-  }
-  dataforDataService(selectedService, d, compnr);
-  fibLocker.unlock();
+  if (c != nullptr) *d = c->pd;
 }
 
 void fib_processor::dataforDataService(int SId, packetdata *d,
                                         int16_t compnr) {
-  serviceId *selectedService;
+  std::shared_ptr<const fibSnapshot> snap = snapshot();
+  const fibComponent *c = componentFor(serviceFor(snap.get(), SId), 03, compnr);
 
   d->defined = false;
-  fibLocker.lock();
-  selectedService = findServiceId(SId);
-  if (selectedService == nullptr) {
-    fibLocker.unlock();
-    return;
+  if (c != nullptr) *d = c->pd;
+}
+
+void fib_processor::fill_packetData(const serviceComponent *comp,
+                                    packetdata *d) {
+  const int16_t subchId = comp->subchannelId;
+
+  int16_t subChanIdx = -1;
+  if ( 0 <= subchId && subchId < 64 )
+    subChanIdx = subchId;
+
+  d->subchId = subChanIdx;
+
+  d->startAddr = -1;
+  d->shortForm = false;
+  d->protLevel = -1;
+  d->length = -1;
+  d->subChanSize = -1;
+  d->bitRate = -1;
+  d->FEC_scheme = -1;
+  d->protIdxOrCase = -1;
+
+  if ( 0 <= subChanIdx && subChanIdx < 64 ) {
+    d->startAddr = subChannels[subChanIdx].StartAddr;
+    d->shortForm = subChannels[subChanIdx].shortForm;
+    d->protLevel = subChannels[subChanIdx].protLevel;
+    d->length = subChannels[subChanIdx].Length;
+    d->subChanSize = subChannels[subChanIdx].subChanSize;
+    d->bitRate = subChannels[subChanIdx].BitRate;
+    d->FEC_scheme = subChannels[subChanIdx].FEC_scheme;
+    d->protIdxOrCase = subChannels[subChanIdx].protIdxOrCase;
   }
-  dataforDataService(selectedService, d, compnr);
-  fibLocker.unlock();
-}
-
-void fib_processor::dataforDataService(serviceId *selectedService, packetdata *d,
-                                       int16_t compnr) {
-  int16_t j;
-  //const int16_t SCid = ( selectedService && selectedService->numSCid > 0 ) ? selectedService->SCid[0] : -1;
-
-  for (j = 0; j < 64; j++) {
-    if ((!ServiceComps[j].inUse) || (ServiceComps[j].TMid != 03)) continue;
-
-    if (ServiceComps[j].componentNr != compnr) continue;
-
-    if (selectedService != ServiceComps[j].service) continue;
-
-    const int16_t subchId = ServiceComps[j].subchannelId;
-
-    int16_t subChanIdx = -1;
-    if ( 0 <= subchId && subchId < 64 )
-      subChanIdx = subchId;
-
-    d->subchId = subChanIdx;
-
-    d->startAddr = -1;
-    d->shortForm = false;
-    d->protLevel = -1;
-    d->length = -1;
-    d->subChanSize = -1;
-    d->bitRate = -1;
-    d->FEC_scheme = -1;
-    d->protIdxOrCase = -1;
-
-    if ( 0 <= subChanIdx && subChanIdx < 64 ) {
-      d->startAddr = subChannels[subChanIdx].StartAddr;
-      d->shortForm = subChannels[subChanIdx].shortForm;
-      d->protLevel = subChannels[subChanIdx].protLevel;
-      d->length = subChannels[subChanIdx].Length;
-      d->subChanSize = subChannels[subChanIdx].subChanSize;
-      d->bitRate = subChannels[subChanIdx].BitRate;
-      d->FEC_scheme = subChannels[subChanIdx].FEC_scheme;
-      d->protIdxOrCase = subChannels[subChanIdx].protIdxOrCase;
-    }
-    d->componentNr = ServiceComps[j].componentNr;
-    d->DSCTy = ServiceComps[j].DSCTy;
-    d->DGflag = ServiceComps[j].DGflag;
-    d->packetAddress = ServiceComps[j].packetAddress;
-    d->appType = ServiceComps[j].appType;
-    d->defined = true;
-
-    d->componentHasLabel = ServiceComps[j].hasLabel;
-    if ( ServiceComps[j].hasLabel ) {
-      strcpy( d->componentLabel, ServiceComps[j].label );
-      strcpy( d->componentAbbr, ServiceComps[j].abbr );
-    } else {
-      d->componentLabel[0] = 0;
-      d->componentAbbr[0] = 0;
-    }
-    break;
+  d->componentNr = comp->componentNr;
+  d->DSCTy = comp->DSCTy;
+  d->DGflag = comp->DGflag;
+  d->packetAddress = comp->packetAddress;
+  d->appType = comp->appType;
+  d->defined = true;
+
+  d->componentHasLabel = comp->hasLabel;
+  if ( comp->hasLabel ) {
+    strcpy( d->componentLabel, comp->label );
+    strcpy( d->componentAbbr, comp->abbr );
+  } else {
+    d->componentLabel[0] = 0;
+    d->componentAbbr[0] = 0;
   }
 }
 
@@ -1728,83 +1940,63 @@ void fib_processor::dataforAudioService(std::string &s, audiodata *d) {
 
 void fib_processor::dataforAudioService(std::string &s, audiodata *d,
                                         int16_t compnr) {
-    serviceId *selectedService;
-
-    d->defined = false;
-    fibLocker.lock();
-    const bool fullMatchOnly = true;
-    selectedService = findServiceId(s, fullMatchOnly);
-    if (selectedService == nullptr) {
-      fibLocker.unlock();
-      return;
-    }
-    dataforAudioService(selectedService, d, compnr);
-    fibLocker.unlock();
+  std::shared_ptr<const fibSnapshot> snap = snapshot();
+  const fibComponent *c =
+      componentFor(serviceFor(snap.get(), s, true), 00, compnr);
+
+  d->defined = false;
+  if (c != nullptr) *d = c->ad;
 }
 
 void fib_processor::dataforAudioService(int SId, audiodata *d,
                                         int16_t compnr) {
-  serviceId *selectedService;
+  std::shared_ptr<const fibSnapshot> snap = snapshot();
+  const fibComponent *c = componentFor(serviceFor(snap.get(), SId), 00, compnr);
 
   d->defined = false;
-  fibLocker.lock();
-  selectedService = findServiceId(SId);
-  if (selectedService == nullptr) {
-    fibLocker.unlock();
-    return;
-  }
-  dataforAudioService(selectedService, d, compnr);
-  fibLocker.unlock();
+  if (c != nullptr) *d = c->ad;
 }
 
-void fib_processor::dataforAudioService(serviceId *selectedService, audiodata *d,
-                                        int16_t compnr) {
-  int16_t j;
-  //	first we locate the serviceId
-  for (j = 0; j < 64; j++) {
-    int16_t subchId;
-    if ((!ServiceComps[j].inUse) || (ServiceComps[j].TMid != 00)) continue;
-
-    if (ServiceComps[j].componentNr != compnr) continue;
+void fib_processor::fill_audioData(const serviceId *service,
+                                   const serviceComponent *comp,
+                                   audiodata *d) {
+  int16_t subchId = comp->subchannelId;
 
-    if (selectedService != ServiceComps[j].service) continue;
-
-    subchId = ServiceComps[j].subchannelId;
-    if ( !(0 <= subchId && subchId < 64) )
-      continue;
+  d->defined = false;
+  if ( !(0 <= subchId && subchId < 64) )
+    return;
 
-    d->subchId = subchId;
-    d->startAddr = subChannels[subchId].StartAddr;
-    d->shortForm = subChannels[subchId].shortForm;
-    d->protLevel = subChannels[subchId].protLevel;
-    d->length = subChannels[subchId].Length;
-    d->subChanSize = subChannels[subchId].subChanSize;
-    d->bitRate = subChannels[subchId].BitRate;
-    d->protIdxOrCase = subChannels[subchId].protIdxOrCase;
-    d->componentNr = ServiceComps[j].componentNr;
-    d->ASCTy = ServiceComps[j].ASCTy;
-    d->language = selectedService->language;
-    d->programType = selectedService->programType;
-    d->defined = true;
-
-    d->componentHasLabel = ServiceComps[j].hasLabel;
-    if ( ServiceComps[j].hasLabel ) {
-      strcpy( d->componentLabel, ServiceComps[j].label );
-      strcpy( d->componentAbbr, ServiceComps[j].abbr );
-    } else {
-      d->componentLabel[0] = 0;
-      d->componentAbbr[0] = 0;
-    }
-    break;
+  d->subchId = subchId;
+  d->startAddr = subChannels[subchId].StartAddr;
+  d->shortForm = subChannels[subchId].shortForm;
+  d->protLevel = subChannels[subchId].protLevel;
+  d->length = subChannels[subchId].Length;
+  d->subChanSize = subChannels[subchId].subChanSize;
+  d->bitRate = subChannels[subchId].BitRate;
+  d->protIdxOrCase = subChannels[subchId].protIdxOrCase;
+  d->componentNr = comp->componentNr;
+  d->ASCTy = comp->ASCTy;
+  d->language = service->language;
+  d->programType = service->programType;
+  d->defined = true;
+
+  d->componentHasLabel = comp->hasLabel;
+  if ( comp->hasLabel ) {
+    strcpy( d->componentLabel, comp->label );
+    strcpy( d->componentAbbr, comp->abbr );
+  } else {
+    d->componentLabel[0] = 0;
+    d->componentAbbr[0] = 0;
   }
 }
 
 void fib_processor::printAll_metaInfo(FILE *out) {
+  fibLocker.lock();
   fprintf(out, "all meta info of fib_processor:\n");
 
   fprintf(out, "services:\n");
   int num = 0;
-  for (int k = 0; k < 64; ++k) {
+  for (int k = 0; k < (int)listofServices.size(); ++k) {
     const serviceId &e = listofServices[k];
     if (!e.inUse)
       continue;
@@ -1836,7 +2028,7 @@ void fib_processor::printAll_metaInfo(FILE *out) {
   num = 0;
   int nA = 0;
   int nP = 0;
-  for (int k = 0; k < 64; ++k) {
+  for (int k = 0; k < (int)ServiceComps.size(); ++k) {
     const serviceComponent &e = ServiceComps[k];
     if (!e.inUse)
       continue;
@@ -1896,6 +2088,34 @@ void fib_processor::printAll_metaInfo(FILE *out) {
       (int)e.FEC_scheme
       );
   }
+
+  fprintf(out, "linkage sets:\n");
+  for (auto const &l : linkageSets) {
+    fprintf(out, "LSN %03X: %s, %s, %s:", l.first,
+            l.second.active ? "active" : "inactive",
+            l.second.hard ? "hard" : "soft",
+            l.second.international ? "intl" : "nat.");
+    for (auto const &i : l.second.ids)
+      fprintf(out, " %d/%02X/%X", (int)i.IdLQ, (int)i.ecc, i.id);
+    fprintf(out, "\n");
+  }
+
+  fprintf(out, "frequency lists:\n");
+  for (auto const &f : frequencyLists) {
+    fprintf(out, "id %04X, R&M %X%s%s:", f.second.id, (int)f.second.RandM,
+            f.second.continuity ? ", continuity" : "",
+            f.second.otherEnsemble ? ", OE" : "");
+    for (int32_t k : f.second.frequencies) fprintf(out, " %d", k);
+    fprintf(out, "\n");
+  }
+
+  fprintf(out, "OE services:\n");
+  for (auto const &o : oeServices) {
+    fprintf(out, "SID %08X:", o.first);
+    for (int32_t EId : o.second) fprintf(out, " %04X", EId);
+    fprintf(out, "\n");
+  }
+  fibLocker.unlock();
 }
 
 //
@@ -1903,12 +2123,14 @@ void fib_processor::printAll_metaInfo(FILE *out) {
 //	Note that the main program may decide to execute calls
 //	in the fib structures, so release the lock
 void fib_processor::addtoEnsemble(const std::string &s, const std::string &abbr, int32_t SId) {
+  buildSnapshot();
   fibLocker.unlock();
   if (programnameHandler != nullptr) programnameHandler(s, abbr, SId, userData);
   fibLocker.lock();
 }
 
 void fib_processor::nameofEnsemble(int id, const std::string &s, const std::string &abbr) {
+  buildSnapshot();
   fibLocker.unlock();
   if (ensemblenameHandler != nullptr) ensemblenameHandler(s, abbr, id, userData);
   fibLocker.lock();
@@ -1928,8 +2150,13 @@ bool fib_processor::syncReached(void) { return isSynced; }
 std::complex<float> fib_processor::get_coordinates(int16_t mainId,
                                                    int16_t subId,
                                                    bool *success) {
+  std::complex<float> result;
+
+  fibLocker.lock();
   coordinates.print_coordinates();
-  return coordinates.get_coordinates(mainId, subId, success);
+  result = coordinates.get_coordinates(mainId, subId, success);
+  fibLocker.unlock();
+  return result;
 }
 
 // mainId < 0 (-1) => don't check mainId
@@ -1940,9 +2167,14 @@ std::complex<float> fib_processor::get_coordinates(int16_t mainId,
                                                    int16_t *pMainId,
                                                    int16_t *pSubId,
                                                    int16_t *pTD) {
+  std::complex<float> result;
+
   // coordinates. print_coordinates ();
-  return coordinates.get_coordinates(mainId, subId, success, pMainId, pSubId,
-                                     pTD);
+  fibLocker.lock();
+  result = coordinates.get_coordinates(mainId, subId, success, pMainId, pSubId,
+                                       pTD);
+  fibLocker.unlock();
+  return result;
 }
 
 uint8_t fib_processor::getECC(bool *success) {
@@ -1955,14 +2187,66 @@ uint8_t fib_processor::getInterTabId(bool *success) {
   return interTabId;
 }
 
+int32_t fib_processor::get_EId(bool *success) {
+  *success = ensembleId_Present;
+  return ensembleId;
+}
+
 void fib_processor::setEId_handler(ensembleid_t EId_Handler) {
   ensembleidHandler = EId_Handler;
 }
 
+void fib_processor::setChange_handler(ensembleChange_t change_Handler) {
+  fibLocker.lock();
+  changeHandler = change_Handler;
+  fibLocker.unlock();
+}
+
+uint32_t fib_processor::get_generation(void) {
+  return snapshot()->generation;
+}
+
+std::vector<int32_t> fib_processor::frequenciesFor(int32_t EId) {
+  std::shared_ptr<const fibSnapshot> snap = snapshot();
+  auto it = snap->frequencies.find(EId & 0xFFFF);  // R&M 0: DAB
+  if (it == snap->frequencies.end()) return std::vector<int32_t>();
+  return it->second.frequencies;
+}
+
+std::vector<int32_t> fib_processor::ensemblesFor(int32_t SId) {
+  std::shared_ptr<const fibSnapshot> snap = snapshot();
+  auto it = snap->otherEnsembles.find(SId);
+  if (it == snap->otherEnsembles.end()) return std::vector<int32_t>();
+  return it->second;
+}
+
+//
+//	The DAB services (IdLQ 0) in the active sets with SId, the
+//	country part of an international id is not looked at
+std::vector<int32_t> fib_processor::linkedServices(int32_t SId) {
+  std::shared_ptr<const fibSnapshot> snap = snapshot();
+  std::vector<int32_t> result;
+  for (auto const &s : snap->linkage) {
+    const linkageSet &set = s.second;
+    bool inSet = false;
+    if (!set.active) continue;
+    for (auto const &l : set.ids)
+      if ((l.IdLQ == 0) && ((int32_t)l.id == SId)) inSet = true;
+    if (!inSet) continue;
+    for (auto const &l : set.ids)
+      if ((l.IdLQ == 0) && ((int32_t)l.id != SId) &&
+          (std::find(result.begin(), result.end(), (int32_t)l.id) ==
+           result.end()))
+        result.push_back(l.id);
+  }
+  return result;
+}
+
 void fib_processor::reset(void) {
   dateFlag = false;
   ecc_Present = false;
   interTab_Present = false;
+  ensembleId_Present = false;
   clearEnsemble();
   CIFcount = 0;
 #if OUT_CIF_COUNTER
@@ -1971,6 +2255,20 @@ void fib_processor::reset(void) {
   hasCIFcount = false;
 }
 
+//
+//	revisit keeps the database, but what tells about the
+//	reception - sync and the CIF count - starts all over.
+//	Sync is reached with the ensemble label (FIG 1/0), which
+//	is therefore no longer skipped as seen before
+void fib_processor::revisit(void) {
+  fibLocker.lock();
+  isSynced = false;
+  hasCIFcount = false;
+  figFill[32 + 0] = 0;
+  figNext[32 + 0] = 0;
+  fibLocker.unlock();
+}
+
 int32_t fib_processor::get_CIFcount(void) const { return CIFcount; }
 
 bool fib_processor::has_CIFcount(void) const { return hasCIFcount; }
@@ -19,6 +19,9 @@
  */
 
 #include "fic-handler.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include "msc-handler.h"
 #include "protTables.h"
 //
@@ -28,6 +31,8 @@
 //	puncturing (per 32 bits) according to PI_16
 //	The next three blocks shall be subjected to
 //	puncturing (per 32 bits) according to PI_15
+//	In Mode III the codeword has 4 FIBs, the 4096 bits are
+//	split into 32 blocks, the first 29 are punctured with PI_16
 
 /**
  *	\class ficHandler
@@ -40,49 +45,78 @@
 ficHandler::ficHandler(uint8_t dabMode, ensemblename_t ensemblenameHandler,
                        programname_t programnameHandler,
                        fib_quality_t fib_qualityHandler, void *userData)
-    : viterbiHandler(768),
-      params(dabMode),
-      fibProcessor(ensemblenameHandler, programnameHandler, userData) {
-  int16_t i, j, k;
-  int16_t local = 0;
-
-  (void)dabMode;
+    : params(dabMode),
+      freeJobs(FIC_JOBS),
+      ownProcessor(ensemblenameHandler, programnameHandler, userData) {
   this->fib_qualityHandler = fib_qualityHandler;
   this->errorReportHandler = nullptr;
   this->fib_dataHandler = nullptr;
   this->userData = userData;
-  index = 0;
+  for (int i = 0; i < FIC_WORKERS; i++) viterbi[i] = nullptr;
+  for (int i = 0; i < FIC_JOBS; i++) jobs[i].done = false;
+  jobIn = 0;
+  jobNext.store(0);
+  jobOut = 0;
+  pending = 0;
+  frameStart = false;
+  frameMetric = 0;
+  frameMagnitude = 0;
+  ficQuality.store(-1);
+  crcGood = 0;
+  crcCount = 0;
+  fibProcessor.store(&ownProcessor);
+  set_mode(dabMode);
+  running.store(true);
+  for (int i = 0; i < FIC_WORKERS; i++)
+    workers[i] = std::thread(&ficHandler::worker, this, i);
+}
+
+ficHandler::~ficHandler(void) {
+  running.store(false);
+  usedJobs.interrupt(true);
+  freeJobs.interrupt(true);
+  for (int i = 0; i < FIC_WORKERS; i++) workers[i].join();
+  for (int i = 0; i < FIC_WORKERS; i++) delete viterbi[i];
+}
+
+//
+//	set_mode (re)builds the tables for the codeword of the mode,
+//	it is called from the thread delivering the FIC blocks, the
+//	workers are idle once the jobs are drained
+void ficHandler::set_mode(uint8_t dabMode) {
+  int16_t i, j, k;
+  int16_t local = 0;
+  int16_t codeBits;
+
+  drain();
+  ficQuality.store(-1);
+  params = dabParams(dabMode);
+  fibsperCodeword = params.get_dabMode() == 3 ? 4 : 3;
+  codeBits = fibsperCodeword * 256;
   BitsperBlock = 2 * params.get_carriers();
+  index = 0;
   ficno = 0;
-  memset(shiftRegister, 1, 9);
+  for (i = 0; i < FIC_WORKERS; i++) {
+    delete viterbi[i];
+    viterbi[i] = new viterbiHandler(codeBits);
+  }
 
-  for (i = 0; i < 768; i++) {
+  memset(shiftRegister, 1, 9);
+  for (i = 0; i < codeBits; i++) {
     PRBS[i] = shiftRegister[8] ^ shiftRegister[4];
     for (j = 8; j > 0; j--) shiftRegister[j] = shiftRegister[j - 1];
 
     shiftRegister[0] = PRBS[i];
   }
 
-  /**
-   *	a block of 2304 bits is considered to be a codeword
-   *	In the first step we have 21 blocks with puncturing according to PI_16
-   *	each 128 bit block contains 4 subblocks of 32 bits
-   *	on which the given puncturing is applied
-   */
-  memset(punctureTable, 0, (3072 + 24) * sizeof(bool));
+  memset(punctureTable, 0, sizeof(punctureTable));
 
-  for (i = 0; i < 21; i++) {
+  for (i = 0; i < codeBits / 32 - 3; i++) {
     for (k = 0; k < 32 * 4; k++) {
       if (get_PCodes(16 - 1)[k % 32] == 1) punctureTable[local] = true;
       local++;
     }
   }
-  /**
-   *	In the second step
-   *	we have 3 blocks with puncturing according to PI_15
-   *	each 128 bit block contains 4 subblocks of 32 bits
-   *	on which the given puncturing is applied
-   */
   for (i = 0; i < 3; i++) {
     for (k = 0; k < 32 * 4; k++) {
       if (get_PCodes(15 - 1)[k % 32] == 1) punctureTable[local] = true;
@@ -100,8 +134,6 @@ ficHandler::ficHandler(uint8_t dabMode, ensemblename_t ensemblenameHandler,
   }
 }
 
-ficHandler::~ficHandler(void) {}
-
 /**
  *	\brief process_ficBlock
  *	The number of bits to be processed per incoming block
@@ -111,59 +143,128 @@ ficHandler::~ficHandler(void) {}
  *	for Mode II we will get the 2304 bits after having read
  *	the 3 FIC blocks, each with 768 bits.
  *	for Mode IV we will get 3 * 2 * 768 = 4608, i.e. two resulting blocks
- *	Note that Mode III is NOT supported
+ *	for Mode III we get 8 blocks of 384 bits, i.e. one codeword
+ *	of 3072 bits (4 FIBs)
  *
- *	The function is called with a blkno. This should be 1, 2 or 3
- *	for each time 2304 bits are in, we call process_ficInput
+ *	The function is called with a blkno. This should be 1 .. 3
+ *	(1 .. 8 for Mode III), each time a codeword is in, it is
+ *	handed over to the workers, the decoding is not done here
  */
-void ficHandler::process_ficBlock(std::vector<int16_t> data, int16_t blkno) {
-  int32_t i;
+void ficHandler::process_ficBlock(const int16_t *data, int32_t size,
+                                  int16_t blkno) {
+  int32_t codewordSize = fibsperCodeword * 768;
 
   if (blkno == 1) {
     index = 0;
     ficno = 0;
-    fibProcessor.newFrame();
+    frameStart = true;
   }
   //
-  if ((1 <= blkno) && (blkno <= 3)) {
-    for (i = 0; i < BitsperBlock; i++) {
-      ofdm_input[index++] = data[i];
-      if (index >= 2304) {
-        process_ficInput(ficno);
-        index = 0;
-        ficno++;
-      }
-    }
-  } else
+  if ((blkno < 1) || (blkno > params.get_ficSymbols())) {
     fprintf(stderr, "You should not call ficBlock here\n");
+    return;
+  }
+  while (size > 0) {
+    int32_t n = std::min(size, codewordSize - index);
+    memcpy(&ofdm_input[index], data, n * sizeof(int16_t));
+    index += n;
+    data += n;
+    size -= n;
+    if (index >= codewordSize) {
+      //	the last codeword of the frame completes the last block
+      submit((blkno == params.get_ficSymbols()) && (size == 0));
+      index = 0;
+      ficno++;
+    }
+  }
   //	we are pretty sure now that after block 4, we end up
   //	with index = 0
 }
 
+//
+//	submit waits - like the msc handler does - for a free job,
+//	which only takes time when the workers are a frame behind
+void ficHandler::submit(bool last) {
+  while (running.load())
+    if (freeJobs.tryAcquire(200)) break;
+  if (!running.load()) return;
+
+  ficJob *job = &jobs[jobIn];
+  memcpy(job->softBits, ofdm_input, fibsperCodeword * 768 * sizeof(int16_t));
+  job->ficno = ficno;
+  job->first = frameStart;
+  job->last = last;
+  frameStart = false;
+  jobIn = (jobIn + 1) % FIC_JOBS;
+  {
+    std::lock_guard<std::mutex> lck(orderLock);
+    pending++;
+  }
+  usedJobs.Release();
+}
+
+//
+//	the workers take the jobs in the order they were submitted,
+//	each with its own viterbi decoder. The FIBs of a decoded job are
+//	processed when all jobs before it are, so the database sees
+//	the FIBs in the order they were transmitted
+void ficHandler::worker(int16_t n) {
+  while (running.load()) {
+    if (!usedJobs.tryAcquire(200)) continue;
+    if (!running.load()) return;
+    ficJob *job = &jobs[jobNext.fetch_add(1) % FIC_JOBS];
+    decode(job, n);
+
+    std::lock_guard<std::mutex> lck(orderLock);
+    job->done = true;
+    while (jobs[jobOut].done) {
+      process_fibs(&jobs[jobOut]);
+      jobs[jobOut].done = false;
+      jobOut = (jobOut + 1) % FIC_JOBS;
+      pending--;
+      freeJobs.Release();
+    }
+    if (pending == 0) idle.notify_all();
+  }
+}
+
+//
+//	drain waits until the jobs handed over are processed, such that
+//	nothing of the FIC before a reset, a mode change or a change of
+//	database ends up after it
+void ficHandler::drain(void) {
+  std::unique_lock<std::mutex> lck(orderLock);
+  while (pending > 0) idle.wait(lck);
+}
+
 /**
- *	\brief process_ficInput
+ *	\brief decode
  *	we have a vector of 2304 (0 .. 2303) soft bits that has
  *	to be de-punctured and de-conv-ed into a block of 768 bits
+ *	(for Mode III 3072 soft bits and 1024 bits)
  *	In this approach we first create the full 3072 block (i.e.
  *	we first depuncture, and then we apply the deconvolution
- *	In the next coding step, we will combine this function with the
- *	one above
  */
-void ficHandler::process_ficInput(int16_t ficno) {
+void ficHandler::decode(ficJob *job, int16_t n) {
   int16_t i;
-  int16_t viterbiBlock[3072 + 24];
+  int16_t *block = viterbiBlock[n];
   int16_t inputCount = 0;
-  uint8_t fibBinData[32 + 2];
-
-  memset(viterbiBlock, 0, (3072 + 24) * sizeof(int16_t));
-
-  for (i = 0; i < 4 * 768 + 24; i++)
-    if (punctureTable[i]) viterbiBlock[i] = ofdm_input[inputCount++];
+  int16_t codeBits = fibsperCodeword * 256;
+  int32_t magnitude = 0;
+
+  //	each position is written, the punctured ones with a 0
+  for (i = 0; i < 4 * codeBits + 24; i++)
+    if (punctureTable[i]) {
+      block[i] = job->softBits[inputCount++];
+      magnitude += abs(block[i]);
+    } else
+      block[i] = 0;
   /**
    *	Now we have the full word ready for deconvolution
    *	deconvolution is according to DAB standard section 11.2
    */
-  deconvolve(viterbiBlock, bitBuffer_out);
+  job->metric = viterbi[n]->deconvolve(block, job->bits);
+  job->magnitude = magnitude;
   /**
    *	if everything worked as planned, we now have a
    *	768 bit vector containing three FIB's
@@ -171,15 +272,31 @@ void ficHandler::process_ficInput(int16_t ficno) {
    *	first step: energy dispersal according to the DAB standard
    *	We use a predefined vector PRBS
    */
-  for (i = 0; i < 768; i++) bitBuffer_out[i] ^= PRBS[i];
-  /**
-   *	each of the fib blocks is protected by a crc
-   *	(we know that there are three fib blocks each time we are here
-   *	we keep track of the successrate
-   *	and show that per 100 fic blocks
-   */
-  for (i = ficno * 3; i < ficno * 3 + 3; i++) {
-    uint8_t *p = &bitBuffer_out[(i % 3) * 256];
+  for (i = 0; i < codeBits; i++) job->bits[i] ^= PRBS[i];
+}
+
+/**
+ *	\brief process_fibs
+ *	each of the fib blocks is protected by a crc
+ *	(we know that there are three - or four - fib blocks each time
+ *	we are here, we keep track of the successrate
+ *	and show that per 100 fic blocks.
+ *	Called with the orderLock locked, i.e. for one job at the time,
+ *	the database has its own lock, there is no other one here
+ */
+void ficHandler::process_fibs(ficJob *job) {
+  int16_t i;
+  uint8_t fibBinData[32 + 2];
+
+  if (job->first) {
+    database()->newFrame();
+    frameMetric = 0;
+    frameMagnitude = 0;
+  }
+  frameMetric += job->metric;
+  frameMagnitude += job->magnitude;
+  for (i = 0; i < fibsperCodeword; i++) {
+    uint8_t *p = &job->bits[i * 256];
 
     if (fib_dataHandler) {
       for (int byteOff = 0; byteOff < 32; ++byteOff)
@@ -199,75 +316,64 @@ void ficHandler::process_ficInput(int16_t ficno) {
       continue;
     }
     show_ficCRC(true);
-    fibProtector.lock();
     if (fib_dataHandler)
       fib_dataHandler(fibBinData, 1 /* good CRC */, userData);
-    fibProcessor.process_FIB(p, ficno);
-    fibProtector.unlock();
+    database()->process_FIB(p, job->ficno);
+  }
+  //	the FIC of this frame is done, changes become visible
+  if (!job->last) return;
+  database()->publishSnapshot();
+  if (frameMagnitude > 0) {
+    float agreement = -(float)frameMetric / frameMagnitude;
+    float q = 100 * (agreement - FIC_NOISEFLOOR) / (1 - FIC_NOISEFLOOR);
+    ficQuality.store(q < 0 ? 0 : q > 100 ? 100 : (int16_t)q);
   }
 }
 
 void ficHandler::clearEnsemble(void) {
-  fibProtector.lock();
-  fibProcessor.clearEnsemble();
-  fibProtector.unlock();
+  database()->clearEnsemble();
 }
 
+//
+//	the queries on the services are answered from a snapshot
+//	of the database, no locking here
 uint8_t ficHandler::kindofService(std::string &s) {
-  uint8_t result;
-  fibProtector.lock();
-  result = fibProcessor.kindofService(s);
-  fibProtector.unlock();
-  return result;
+  return database()->kindofService(s);
 }
 
 uint8_t ficHandler::kindofService(int SId) {
-  uint8_t result;
-  fibProtector.lock();
-  result = fibProcessor.kindofService(SId);
-  fibProtector.unlock();
-  return result;
+  return database()->kindofService(SId);
 }
 
 void ficHandler::dataforAudioService(std::string &s, audiodata *d, int c) {
-  fibProtector.lock();
-  fibProcessor.dataforAudioService(s, d, c);
-  fibProtector.unlock();
+  database()->dataforAudioService(s, d, c);
 }
 
 void ficHandler::dataforDataService(std::string &s, packetdata *d, int c) {
-  fibProtector.lock();
-  fibProcessor.dataforDataService(s, d, c);
-  fibProtector.unlock();
+  database()->dataforDataService(s, d, c);
 }
 
 void ficHandler::dataforAudioService(int SId, audiodata *d, int c) {
-  fibProtector.lock();
-  fibProcessor.dataforAudioService(SId, d, c);
-  fibProtector.unlock();
+  database()->dataforAudioService(SId, d, c);
 }
 
 void ficHandler::dataforDataService(int SId, packetdata *d, int c) {
-  fibProtector.lock();
-  fibProcessor.dataforDataService(SId, d, c);
-  fibProtector.unlock();
+  database()->dataforDataService(SId, d, c);
 }
 
 void ficHandler::printAll_metaInfo(FILE *out) {
-  fibProtector.lock();
-  fibProcessor.printAll_metaInfo(out);
-  fibProtector.unlock();
+  database()->printAll_metaInfo(out);
 }
 
 int32_t ficHandler::get_CIFcount(void) const {
   // no lock, because using std::atomic<> in fib_processor class
-  int32_t r = fibProcessor.get_CIFcount();
+  int32_t r = database()->get_CIFcount();
   return r;
 }
 
 bool ficHandler::has_CIFcount(void) const {
   // no lock, because using std::atomic<> in fib_processor class
-  bool r = fibProcessor.has_CIFcount();
+  bool r = database()->has_CIFcount();
   return r;
 }
 
@@ -275,9 +381,7 @@ std::complex<float> ficHandler::get_coordinates(int16_t mainId, int16_t subId,
                                                 bool *success) {
   std::complex<float> result;
 
-  fibProtector.lock();
-  result = fibProcessor.get_coordinates(mainId, subId, success);
-  fibProtector.unlock();
+  result = database()->get_coordinates(mainId, subId, success);
   return result;
 }
 //
@@ -290,10 +394,8 @@ std::complex<float> ficHandler::get_coordinates(int16_t mainId, int16_t subId,
                                                 int16_t *pSubId, int16_t *pTD) {
   std::complex<float> result;
 
-  fibProtector.lock();
-  result = fibProcessor.get_coordinates(mainId, subId, success, pMainId, pSubId,
+  result = database()->get_coordinates(mainId, subId, success, pMainId, pSubId,
                                         pTD);
-  fibProtector.unlock();
   return result;
 }
 
@@ -301,7 +403,7 @@ uint8_t ficHandler::getECC(bool *success) {
   uint8_t result;
 
   // no lock, because using std::atomic<> in fib_processor class
-  result = fibProcessor.getECC(success);
+  result = database()->getECC(success);
   return result;
 }
 
@@ -309,12 +411,37 @@ uint8_t ficHandler::getInterTabId(bool *success) {
   uint8_t result;
 
   // no lock, because using std::atomic<> in fib_processor class
-  result = fibProcessor.getInterTabId(success);
+  result = database()->getInterTabId(success);
   return result;
 }
 
+int32_t ficHandler::get_EId(bool *success) {
+  // no lock, because using std::atomic<> in fib_processor class
+  return database()->get_EId(success);
+}
+
 void ficHandler::setEId_handler(ensembleid_t EId_Handler) {
-  fibProcessor.setEId_handler(EId_Handler);
+  database()->setEId_handler(EId_Handler);
+}
+
+void ficHandler::setChange_handler(ensembleChange_t change_Handler) {
+  database()->setChange_handler(change_Handler);
+}
+
+uint32_t ficHandler::get_generation(void) {
+  return database()->get_generation();
+}
+
+std::vector<int32_t> ficHandler::frequenciesFor(int32_t EId) {
+  return database()->frequenciesFor(EId);
+}
+
+std::vector<int32_t> ficHandler::ensemblesFor(int32_t SId) {
+  return database()->ensemblesFor(SId);
+}
+
+std::vector<int32_t> ficHandler::linkedServices(int32_t SId) {
+  return database()->linkedServices(SId);
 }
 
 void ficHandler::setError_handler(decodeErrorReport_t err_Handler) {
@@ -325,25 +452,54 @@ void ficHandler::setFIB_handler(fibdata_t fib_Handler) {
   fib_dataHandler = fib_Handler;
 }
 
-bool ficHandler::syncReached(void) { return fibProcessor.syncReached(); }
+bool ficHandler::syncReached(void) { return database()->syncReached(); }
 
 std::string ficHandler::nameFor(int32_t serviceId) {
-  return fibProcessor.nameFor(serviceId);
+  return database()->nameFor(serviceId);
+}
+
+std::vector<int32_t> ficHandler::serviceIds(void) {
+  return database()->serviceIds();
 }
 
 int32_t ficHandler::SIdFor(std::string &name) {
-  return fibProcessor.SIdFor(name);
+  return database()->SIdFor(name);
 }
 
-static int pos = 0;
-static int amount = 0;
 void ficHandler::show_ficCRC(bool b) {
-  if (b) pos++;
-  if (++amount >= 100) {
-    if (fib_qualityHandler != nullptr) fib_qualityHandler(pos, userData);
-    pos = 0;
-    amount = 0;
+  if (b) crcGood++;
+  if (++crcCount >= 100) {
+    if (fib_qualityHandler != nullptr) fib_qualityHandler(crcGood, userData);
+    crcGood = 0;
+    crcCount = 0;
   }
 }
 
-void ficHandler::reset(void) { fibProcessor.reset(); }
+//
+//	The soft decision quality of the FIC of the last frame (0 .. 100),
+//	known as soon as the codewords are decoded, rather than after
+//	100 FIBs. The metric of the path found by the viterbi decoder is
+//	compared with the sum of the magnitudes of the soft bits: a
+//	codeword received without errors gives a metric of -sum, random
+//	soft bits give approx. -0.69 * sum (measured), where no
+//	FIB passes the CRC anymore. -1 means: not known (yet)
+int16_t ficHandler::get_ficQuality(void) { return ficQuality.load(); }
+
+void ficHandler::reset(void) {
+  drain();
+  ficQuality.store(-1);
+  database()->reset();
+}
+
+//
+//	set_database makes the FIC go into another database, one that
+//	is kept - with all it learned - while another channel is
+//	received, a nullptr selects our own one.
+//	Called with the thread delivering the FIC blocks parked
+void ficHandler::set_database(fib_processor *db) {
+  drain();
+  ficQuality.store(-1);
+  if (db == nullptr) db = &ownProcessor;
+  db->revisit();
+  fibProcessor.store(db);
+}
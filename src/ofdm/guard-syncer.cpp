@@ -0,0 +1,169 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#include "guard-syncer.h"
+#include <string.h>
+#include "sample-reader.h"
+
+//	the symbols looked at for the timing
+#define GUARD_SYMBOLS 8
+//	the correlation should stand out at least this much (it is
+//	normalized, 1.0 for a clean signal)
+#define GUARD_MINSCORE 0.2
+//	a symbol with less than this part of the correlation
+//	found is taken as null symbol
+#define GUARD_NULL 0.35
+
+guardSyncer::guardSyncer(sampleReader *mr) { myReader = mr; }
+
+guardSyncer::~guardSyncer() {}
+
+//
+//	First the timing: over GUARD_SYMBOLS symbols, the products of the
+//	samples with the samples T_u later, and their power, are folded
+//	onto a single symbol period. Summing T_g successive values - the
+//	window of the guard interval - gives the correlation for each
+//	start of the symbol, the best one is the start of the symbols.
+//	Then the symbols are read one by one, until the one that is
+//	not correlated, the null symbol, it is followed by block 0.
+//	With TII the null symbol is (weakly) correlated, in Mode I every
+//	second frame, so the search continues over two frames
+int guardSyncer::sync(dabParams *p, int32_t phase, float *offset) {
+  int32_t T_u = p->get_T_u();
+  int32_t T_g = p->get_T_g();
+  int32_t T_s = p->get_T_s();
+  int32_t T_null = p->get_T_null();
+  int32_t count = GUARD_SYMBOLS * T_s;
+  int32_t i;
+
+  buffer.resize(count + T_u);
+  prodRe.resize(count);
+  prodIm.resize(count);
+  power.resize(count);
+  myReader->getSamples(buffer.data(), count + T_u, phase);
+
+  //	no dependencies between the iterations, the compiler can
+  //	vectorize this
+  const float *v = reinterpret_cast<const float *>(buffer.data());
+  const float *w = reinterpret_cast<const float *>(&buffer[T_u]);
+  for (i = 0; i < count; i++) {
+    prodRe[i] = w[2 * i] * v[2 * i] + w[2 * i + 1] * v[2 * i + 1];
+    prodIm[i] = w[2 * i + 1] * v[2 * i] - w[2 * i] * v[2 * i + 1];
+    power[i] = v[2 * i] * v[2 * i] + v[2 * i + 1] * v[2 * i + 1] +
+               w[2 * i] * w[2 * i] + w[2 * i + 1] * w[2 * i + 1];
+  }
+  for (int32_t s = 1; s < GUARD_SYMBOLS; s++)
+    for (i = 0; i < T_s; i++) {
+      prodRe[i] += prodRe[s * T_s + i];
+      prodIm[i] += prodIm[s * T_s + i];
+      power[i] += power[s * T_s + i];
+    }
+
+  //	the window of T_g values slides - circularly - over the period
+  double corrRe = 0;
+  double corrIm = 0;
+  double energy = 0;
+  for (i = 0; i < T_g; i++) {
+    corrRe += prodRe[i];
+    corrIm += prodIm[i];
+    energy += power[i];
+  }
+  float bestScore = 0;
+  int32_t bestStart = 0;
+  std::complex<float> bestCorr = 0;
+  for (i = 0; i < T_s; i++) {
+    float score = energy > 0 ? 2 * sqrt(corrRe * corrRe + corrIm * corrIm) /
+                                   energy
+                             : 0;
+    if (score > bestScore) {
+      bestScore = score;
+      bestStart = i;
+      bestCorr = std::complex<float>(corrRe, corrIm);
+    }
+    int32_t next = (i + T_g) % T_s;
+    corrRe += prodRe[next] - prodRe[i];
+    corrIm += prodIm[next] - prodIm[i];
+    energy += power[next] - power[i];
+  }
+  if (bestScore < GUARD_MINSCORE) return NO_DIP_FOUND;
+  //	the phase over T_u samples, 2 * pi is one carrier
+  *offset = arg(bestCorr) / (2 * M_PI) * p->get_carrierDiff();
+
+  //	on to the start of the next symbol, the samples in the
+  //	buffer beyond it are (re)used for the first one
+  int32_t start = bestStart;
+  while (start < count) start += T_s;
+  int32_t inBuffer = count + T_u - start;
+  if (inBuffer < 0) {
+    myReader->getSamples(buffer.data(), -inBuffer, phase);
+    inBuffer = 0;
+  } else
+    memmove(buffer.data(), &buffer[start],
+            inBuffer * sizeof(std::complex<float>));
+
+  int32_t symbols = 2 * p->get_T_F() / T_s + 2;
+  for (int32_t s = 0; s < symbols; s++) {
+    if (inBuffer < T_s)
+      myReader->getSamples(&buffer[inBuffer], T_s - inBuffer, phase);
+    inBuffer = 0;
+    if (slotCorrelation(buffer.data(), T_u, T_g) < GUARD_NULL * bestScore) {
+      //	the null symbol started with this "symbol"
+      myReader->getSamples(buffer.data(), T_null - T_s, phase);
+      return TIMESYNC_ESTABLISHED;
+    }
+  }
+  return NO_END_OF_DIP_FOUND;
+}
+
+//	the normalized correlation of the guard interval of a symbol;
+//	the sums are split in four, so gcc -O3 vectorizes both loops
+float guardSyncer::slotCorrelation(const std::complex<float> *s, int32_t T_u,
+                                   int32_t T_g) {
+  const float *v = reinterpret_cast<const float *>(s);
+  const float *w = reinterpret_cast<const float *>(&s[T_u]);
+  float re[4] = {0, 0, 0, 0};
+  float im[4] = {0, 0, 0, 0};
+  float e[4] = {0, 0, 0, 0};
+  int32_t k;
+
+  for (k = 0; k + 4 <= T_g; k += 4)
+    for (int j = 0; j < 4; j++) {
+      int32_t n = 2 * (k + j);
+      re[j] += w[n] * v[n] + w[n + 1] * v[n + 1];
+      im[j] += w[n + 1] * v[n] - w[n] * v[n + 1];
+      e[j] += v[n] * v[n] + v[n + 1] * v[n + 1] + w[n] * w[n] +
+              w[n + 1] * w[n + 1];
+    }
+  for (; k < T_g; k++) {
+    int32_t n = 2 * k;
+    re[0] += w[n] * v[n] + w[n + 1] * v[n + 1];
+    im[0] += w[n + 1] * v[n] - w[n] * v[n + 1];
+    e[0] += v[n] * v[n] + v[n + 1] * v[n + 1] + w[n] * w[n] +
+            w[n + 1] * w[n + 1];
+  }
+  float corrRe = re[0] + re[1] + re[2] + re[3];
+  float corrIm = im[0] + im[1] + im[2] + im[3];
+  float energy = e[0] + e[1] + e[2] + e[3];
+  return energy > 0 ? 2 * sqrt(corrRe * corrRe + corrIm * corrIm) / energy
+                    : 0;
+}
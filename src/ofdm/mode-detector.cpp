@@ -0,0 +1,161 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#include "mode-detector.h"
+#include <math.h>
+
+//	samples per value of the envelope
+#define ENV_BLOCK 32
+//	a dip is at least this number of envelope values
+#define MIN_DIP 6
+//	the guard interval correlation should stand out at least this
+//	much (the correlation is normalized, 1.0 for a clean signal)
+#define MIN_SCORE 0.2
+
+modeDetector::modeDetector(void) {}
+
+modeDetector::~modeDetector(void) {}
+
+//
+//	two frames of the longest mode, plus a null symbol, such that
+//	at least two null symbols are seen
+int32_t modeDetector::bufferSize(void) {
+  dabParams p(1);
+  return 2 * p.get_T_F() + p.get_T_null();
+}
+
+uint8_t modeDetector::detect(const std::complex<float> *v, int32_t n) {
+  int16_t votes[5] = {0, 0, 0, 0, 0};
+  bool anyVote = false;
+  uint8_t best = 0;
+  float bestScore = MIN_SCORE;
+
+  nullVotes(v, n, votes);
+  for (uint8_t mode = 1; mode <= 4; mode++)
+    if (votes[mode] > 0) anyVote = true;
+
+  for (uint8_t mode = 1; mode <= 4; mode++) {
+    if (anyVote && (votes[mode] == 0)) continue;
+    dabParams p(mode);
+    float score = guardScore(v, n, p);
+    if (score > bestScore) {
+      best = mode;
+      bestScore = score;
+    }
+  }
+  return best;
+}
+
+//
+//	The envelope is averaged over blocks of ENV_BLOCK samples,
+//	a dip is a run of blocks under half the average level.
+//	Each pair of successive dips votes for the mode(s) with
+//	that frame length and null length
+void modeDetector::nullVotes(const std::complex<float> *v, int32_t n,
+                             int16_t *votes) {
+  int32_t blocks = n / ENV_BLOCK;
+  float mean = 0;
+  int32_t runStart = -1;
+  int32_t lastStart = -1;
+  int32_t lastLength = 0;
+
+  if (blocks == 0) return;
+  envelope.resize(blocks);
+  for (int32_t b = 0; b < blocks; b++) {
+    float e = 0;
+    for (int32_t i = 0; i < ENV_BLOCK; i++) e += abs(v[b * ENV_BLOCK + i]);
+    envelope[b] = e / ENV_BLOCK;
+    mean += envelope[b];
+  }
+  mean /= blocks;
+
+  for (int32_t b = 0; b <= blocks; b++) {
+    bool below = (b < blocks) && (envelope[b] < 0.5 * mean);
+    if (below) {
+      if (runStart < 0) runStart = b;
+      continue;
+    }
+    if (runStart < 0) continue;
+    //	a dip at the start of the buffer may be cut off
+    if ((runStart > 0) && (b - runStart >= MIN_DIP) && (b < blocks)) {
+      if (lastStart >= 0) {
+        int32_t period = (runStart - lastStart) * ENV_BLOCK;
+        int32_t nullLength = lastLength * ENV_BLOCK;
+        for (uint8_t mode = 1; mode <= 4; mode++) {
+          dabParams p(mode);
+          if ((abs(period - p.get_T_F()) < p.get_T_F() / 50) &&
+              (abs(nullLength - p.get_T_null()) < p.get_T_null() / 4))
+            votes[mode]++;
+        }
+      }
+      lastStart = runStart;
+      lastLength = b - runStart;
+    }
+    runStart = -1;
+  }
+}
+
+//
+//	The correlation between a window of T_g samples and the window
+//	T_u samples later is computed for all positions (sliding),
+//	normalized with the energy in both windows. With the right T_u
+//	it peaks once per symbol, where the window is the guard interval.
+//	The score is the average, over the symbols, of the height of
+//	the peak above the average in that symbol
+float modeDetector::guardScore(const std::complex<float> *v, int32_t n,
+                               dabParams &p) {
+  int32_t T_u = p.get_T_u();
+  int32_t T_g = p.get_T_g();
+  int32_t T_s = p.get_T_s();
+  int32_t count = n - T_u - T_g;
+  std::complex<double> corr = 0;
+  double energy = 0;
+  float segmentMax = 0;
+  float segmentSum = 0;
+  float score = 0;
+  int32_t segments = 0;
+
+  if (count < 2 * T_s) return 0;
+  for (int32_t k = 0; k < T_g; k++) {
+    corr += std::complex<double>(v[k] * conj(v[k + T_u]));
+    energy += norm(v[k]) + norm(v[k + T_u]);
+  }
+
+  for (int32_t m = 0; m < count; m++) {
+    float rho = energy > 0 ? 2 * abs(corr) / energy : 0;
+    if (rho > segmentMax) segmentMax = rho;
+    segmentSum += rho;
+    if ((m + 1) % T_s == 0) {
+      score += segmentMax - segmentSum / T_s;
+      segments++;
+      segmentMax = 0;
+      segmentSum = 0;
+    }
+    //	slide the windows one sample
+    corr -= std::complex<double>(v[m] * conj(v[m + T_u]));
+    energy -= norm(v[m]) + norm(v[m + T_u]);
+    corr += std::complex<double>(v[m + T_g] * conj(v[m + T_g + T_u]));
+    energy += norm(v[m + T_g]) + norm(v[m + T_g + T_u]);
+  }
+  return segments > 0 ? score / segments : 0;
+}
@@ -39,7 +39,10 @@
  */
 ofdmDecoder::ofdmDecoder(uint8_t dabMode,
                          RingBuffer<std::complex<float>> *iqBuffer)
-    : params(dabMode), my_fftHandler(dabMode), myMapper(dabMode) {
+    : params(dabMode),
+      my_fftHandler(dabMode),
+      myMapper(dabMode),
+      myEstimator(dabMode) {
   this->iqBuffer = iqBuffer;
   this->T_s = params.get_T_s();
   this->T_u = params.get_T_u();
@@ -51,6 +54,10 @@ ofdmDecoder::ofdmDecoder(uint8_t dabMode,
   //
   current_snr = 0;
   cnt = 0;
+  for (int i = 0; i < 4; i++) clockSums[i] = 0;
+  clockWeight = 0;
+  coherent.store(false);
+  coherentFrame = false;
 }
 
 ofdmDecoder::~ofdmDecoder(void) {}
@@ -70,10 +77,21 @@ void ofdmDecoder::processBlock_0(std::complex<float> *buffer) {
    *	as coming from the FFT as phase reference.
    */
   memcpy(phaseReference.data(), fft_buffer, T_u * sizeof(std::complex<float>));
+  //	the switch to or from coherent demodulation is made here,
+  //	it needs the phase reference symbol
+  coherentFrame = coherent.load();
+  if (coherentFrame) myEstimator.start(fft_buffer);
 }
 
+//	with coherent demodulation - see the channelEstimator - the
+//	soft bits are better, at the expense of more computation
+void ofdmDecoder::set_coherent(bool b) { coherent.store(b); }
+
+//
+//	damaged tells the number of samples of the block that were
+//	blanked or clipped
 void ofdmDecoder::decode(std::complex<float> *buffer, int32_t blkno,
-                         int16_t *ibits) {
+                         int16_t *ibits, int32_t damaged) {
   int16_t i;
   memcpy(fft_buffer, &(buffer[T_g]), T_u * sizeof(std::complex<float>));
   std::complex<float> conjVector[T_u];
@@ -93,8 +111,8 @@ void ofdmDecoder::decode(std::complex<float> *buffer, int32_t blkno,
    *	"carriers" useful carriers of the FFT output
    */
   for (i = 0; i < carriers; i++) {
-    int16_t index = myMapper.mapIn(i);
-    if (index < 0) index += T_u;
+    int16_t carrier = myMapper.mapIn(i);
+    int16_t index = carrier < 0 ? carrier + T_u : carrier;
     /**
      *	decoding is computing the phase difference between
      *	carriers with the same index in subsequent blocks.
@@ -106,9 +124,26 @@ void ofdmDecoder::decode(std::complex<float> *buffer, int32_t blkno,
     //	The viterbi decoder expects values in the range 0 .. 255,
     //	we present values -127 .. 127 (easy with depuncturing)
     float ab1 = jan_abs(r1);
+    //	the 4th power removes the modulation, what remains is the
+    //	phase drift over a block, growing with the carrier number
+    //	if the sample clock is off. It is scaled back to |r1| with
+    //	the real magnitude, jan_abs depends on the phase and would
+    //	bias the result
+    float mag = abs(r1);
+    std::complex<float> r2 = r1 * r1;
+    std::complex<float> r4 = r2 * r2 / (mag * mag * mag + 1e-10F);
+    int16_t quarter = carrier < 0 ? (carrier < -carriers / 4 ? 0 : 1)
+                                  : (carrier <= carriers / 4 ? 2 : 3);
+    clockSums[quarter] += r4;
+    clockWeight += mag;
+    if (coherentFrame) continue;
     ibits[i] = -real(r1) / ab1 * 127.0;
     ibits[carriers + i] = -imag(r1) / ab1 * 127.0;
   }
+  if (coherentFrame) myEstimator.demap(fft_buffer, ibits);
+  float weight = erasureWeight(damaged, T_u);
+  if (weight < 1)
+    for (i = 0; i < 2 * carriers; i++) ibits[i] = ibits[i] * weight;
 
   memcpy(phaseReference.data(), fft_buffer, T_u * sizeof(std::complex<float>));
   //	From time to time we show the constellation of block 2.
@@ -149,3 +184,35 @@ int16_t ofdmDecoder::get_snr(std::complex<float> *v) {
 }
 
 int16_t ofdmDecoder::get_snr(void) { return (int16_t)current_snr; }
+
+//
+//	get_clockOffset tells the offset (in ppm) of the sample clock,
+//	measured over the blocks decoded since the previous call.
+//	With a clock offset e (a positive e: the device delivers too
+//	many samples) block l + 1 starts e * T_s samples later than
+//	assumed, carrier k then shows a phase difference
+//	of -2 * pi * k * e * T_s / T_u, four times that for the 4th power.
+//	The difference between the negative and the positive half
+//	(K / 2 carriers apart) is precise, but ambiguous beyond approx.
+//	130 ppm, the difference between the outer and the inner
+//	quarters (K / 4 carriers apart) resolves that up to 260 ppm.
+//	The 4th power does not survive noise well, below an SNR of
+//	approx. 8 dB the sums are mostly noise and the result is
+//	marked as invalid
+#define CLOCK_COHERENCE 0.25
+float ofdmDecoder::get_clockOffset(bool *valid) {
+  std::complex<float> fine = (clockSums[0] + clockSums[1]) *
+                             conj(clockSums[2] + clockSums[3]);
+  std::complex<float> coarse = clockSums[0] * conj(clockSums[1]) +
+                               clockSums[2] * conj(clockSums[3]);
+  float coherence = abs(clockSums[0]) + abs(clockSums[1]) +
+                    abs(clockSums[2]) + abs(clockSums[3]);
+  coherence /= clockWeight + 1e-10F;
+  for (int i = 0; i < 4; i++) clockSums[i] = 0;
+  clockWeight = 0;
+  *valid = coherence > CLOCK_COHERENCE;
+  if (!*valid) return 0;
+  float phase = arg(fine);
+  phase += 2 * M_PI * roundf((2 * arg(coarse) - phase) / (2 * M_PI));
+  return phase / (4 * 2 * M_PI * (carriers / 2 + 1) * T_s / T_u) * 1000000;
+}
@@ -52,6 +52,27 @@ phaseReference::phaseReference(uint8_t dabMode, int16_t threshold,
   for (i = 1; i <= diff_length; i++)
     phaseDifferences[i - 1] = abs(
         arg(refTable[(T_u + i) % T_u] * conj(refTable[(T_u + i + 1) % T_u])));
+
+  //
+  //	the table for the wide range acquisition, the phase difference
+  //	between carrier k and k + 1, for k = -K / 2 .. K / 2 - 1.
+  //	Carrier 0 is not used, the pairs with carrier 0 do not count.
+  //	The range is limited by the guard band of the spectrum
+  int32_t K = params.get_carriers();
+  acquireRange = Khz(ACQUIRE_RANGE) / params.get_carrierDiff();
+  if (acquireRange > (T_u - K) / 2) acquireRange = (T_u - K) / 2;
+  refDiffRe.resize(K);
+  refDiffIm.resize(K);
+  diffRe.resize(K + 2 * acquireRange);
+  diffIm.resize(K + 2 * acquireRange);
+  for (i = 0; i < K; i++) {
+    int32_t k = i - K / 2;
+    std::complex<float> d = 0;
+    if ((k != 0) && (k != -1))
+      d = refTable[(T_u + k) % T_u] * conj(refTable[(T_u + k + 1) % T_u]);
+    refDiffRe[i] = real(d);
+    refDiffIm[i] = imag(d);
+  }
 }
 
 phaseReference::~phaseReference() {}
@@ -139,3 +160,67 @@ int16_t phaseReference::estimateOffset(const std::complex<float> *v) {
   }
   return index - T_u;
 }
+
+//
+//	acquireOffset looks - in one pass - for an offset of up to
+//	ACQUIRE_RANGE KHz, i.e. far beyond what estimateOffset handles.
+//	It uses the same idea, the pattern of phase differences between
+//	successive carriers, but now as complex values, all carriers
+//	and all offsets.
+//	A time offset of the block adds the same phase to all differences,
+//	so we look at the magnitude of the correlation, and the block
+//	need not be time synchronized: any T_u samples that are mostly
+//	from block 0 - e.g. directly following the null symbol - will do.
+//	The differences are first stored as I and Q arrays; the
+//	correlation over them uses four partial sums (gcc -O3 vectorizes
+//	the inner loop).
+//	The result is the offset in carriers, *success tells whether
+//	the peak is clear enough to trust
+#define ACQUIRE_THRESHOLD 4
+int16_t phaseReference::acquireOffset(const std::complex<float> *v,
+                                      bool *success) {
+  std::complex<float> *fft_buffer = my_fftHandler.getVector();
+  int32_t K = params.get_carriers();
+  int32_t first = T_u - K / 2 - acquireRange;
+  const float *rRe = refDiffRe.data();
+  const float *rIm = refDiffIm.data();
+  int32_t i, j;
+  int16_t index = 0;
+  float Max = 0;
+  float sum = 0;
+
+  memcpy(fft_buffer, v, T_u * sizeof(std::complex<float>));
+  my_fftHandler.do_FFT();
+
+  //	the normalized phase differences from carrier -K/2 - range up
+  for (i = 0; i < K + 2 * acquireRange; i++) {
+    std::complex<float> d = fft_buffer[(first + i) % T_u] *
+                            conj(fft_buffer[(first + i + 1) % T_u]);
+    float a = abs(d);
+    if (a == 0) a = 1;
+    diffRe[i] = real(d) / a;
+    diffIm[i] = imag(d) / a;
+  }
+
+  for (i = 0; i <= 2 * acquireRange; i++) {
+    const float *dRe = &diffRe[i];
+    const float *dIm = &diffIm[i];
+    float cRe[4] = {0, 0, 0, 0};
+    float cIm[4] = {0, 0, 0, 0};
+    for (j = 0; j + 4 <= K; j += 4)
+      for (int k = 0; k < 4; k++) {
+        cRe[k] += dRe[j + k] * rRe[j + k] + dIm[j + k] * rIm[j + k];
+        cIm[k] += dIm[j + k] * rRe[j + k] - dRe[j + k] * rIm[j + k];
+      }
+    float re = cRe[0] + cRe[1] + cRe[2] + cRe[3];
+    float im = cIm[0] + cIm[1] + cIm[2] + cIm[3];
+    float mag = sqrt(re * re + im * im);
+    sum += mag;
+    if (mag > Max) {
+      Max = mag;
+      index = i - acquireRange;
+    }
+  }
+  *success = Max > ACQUIRE_THRESHOLD * sum / (2 * acquireRange + 1);
+  return index;
+}
@@ -80,6 +80,11 @@ struct phasetableElement modeII_table[] = {
     {97, 128, 3, 1},     {129, 160, 2, 0},   {161, 192, 1, 3},
     {-1000, -1000, 0, 0}};
 
+struct phasetableElement modeIII_table[] = {
+    {-96, -65, 0, 2}, {-64, -33, 1, 3}, {-32, -1, 2, 0},
+    {1, 32, 3, 2},    {33, 64, 2, 2},   {65, 96, 1, 2},
+    {-1000, -1000, 0, 0}};
+
 struct phasetableElement modeIV_table[] = {
     {-384, -353, 0, 0},  {-352, -321, 1, 1}, {-320, -289, 2, 1},
     {-288, -257, 3, 2},  {-256, -225, 0, 2}, {-224, -193, 1, 2},
@@ -104,6 +109,10 @@ phaseTable::phaseTable(int16_t modus) {
       currentTable = modeII_table;
       break;
 
+    case 3:
+      currentTable = modeIII_table;
+      break;
+
     case 4:
       currentTable = modeIV_table;
       break;
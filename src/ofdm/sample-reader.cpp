@@ -20,6 +20,7 @@
  *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 #
+#include <string.h>
 #include "sample-reader.h"
 #include "dab-processor.h"
 #include "device-handler.h"
@@ -38,6 +39,7 @@ sampleReader::sampleReader(dabProcessor *parent, deviceHandler *theRig,
   bufferSize = 32768;
   this->spectrumBuffer = spectrumBuffer;
   localBuffer.resize(bufferSize);
+  skipBuffer.resize(8192);
   localCounter = 0;
   currentPhase = 0;
   sLevel = 0;
@@ -48,26 +50,41 @@ sampleReader::sampleReader(dabProcessor *parent, deviceHandler *theRig,
                                              sin(2.0 * M_PI * i / INPUT_RATE));
 
   corrector = 0;
+  clockOffset = 0;
+  resampling = false;
+  resamplePos = 1;
+  inFill = 0;
+  blankLevel = 0;
+  clipPeak = 0;
+  clipRate = 0;
+  damaged = 0;
   running.store(true);
+  interrupted.store(false);
 }
 
 sampleReader::~sampleReader() { delete[] oscillatorTable; }
 
-void sampleReader::setRunning(bool b) { running.store(b); }
+void sampleReader::setRunning(bool b) {
+  running.store(b);
+  theRig->notify();
+}
+
+//
+//	interrupt makes the reader throw READER_INTERRUPTED, the
+//	dabProcessor then waits until the retune is done
+void sampleReader::interrupt(bool b) {
+  interrupted.store(b);
+  theRig->notify();
+}
 
 float sampleReader::get_sLevel() { return sLevel; }
 
 std::complex<float> sampleReader::getSample(int32_t phaseOffset) {
   std::complex<float> temp;
 
-  if (!running.load()) throw 21;
+  if (!running.load()) throw READER_STOPPED;
 
-  while (running.load() && (theRig->Samples() < 1)) usleep(100);
-
-  if (!running.load()) throw 20;
-  //
-  //	so here, bufferContent > 0
-  theRig->getSamples(&temp, 1);
+  fetch(&temp, 1);
 
   if (localCounter < bufferSize) localBuffer[localCounter++] = temp;
   //
@@ -94,11 +111,7 @@ void sampleReader::getSamples(std::complex<float> *v, int32_t n,
                               int32_t phaseOffset) {
   int32_t i;
 
-  while (running.load() && (theRig->Samples() < n)) usleep(100);
-
-  if (!running.load()) throw 20;
-  //
-  n = theRig->getSamples(v, n);
+  n = fetch(v, n);
 
   //	OK, we have samples!!
   //	first: adjust frequency. We need Hz accuracy
@@ -121,3 +134,258 @@ void sampleReader::getSamples(std::complex<float> *v, int32_t n,
     sampleCount = 0;
   }
 }
+
+//
+//	the number of samples of the last getSamples that were blanked,
+//	or found clipped. The soft bits of the block are weighted
+//	accordingly. With the resampler on, these are the samples
+//	newly fetched from the device for this block, not the samples
+//	of the output block itself
+int32_t sampleReader::get_damaged(void) { return damaged; }
+
+//
+//	Impulse noise - ignition, switching power supplies - gives
+//	a few samples far above the level of the signal. In the FFT
+//	they spread over all carriers and ruin the whole block, blanking
+//	them (and the samples around them) only costs the energy of
+//	the blanked samples.
+//	The level is the average of jan_abs, impulses are counted at
+//	the threshold only. It is updated once per call and follows
+//	the signal with a time constant of approx. 8 msec, i.e. it
+//	hardly drops in the null symbol.
+//	The detection loop has no branches, and keeps four partial
+//	results of each kind; gcc -O3 vectorizes it. The peak is kept
+//	as the bits of the float: c is not negative, so the order of
+//	the bits is that of the values, and an integer maximum is
+//	vectorized where a float one is not (without -ffast-math).
+//	Samples clipped by the ADC of the device are all at the same -
+//	the largest - value. A device that is driven too hard clips
+//	all the time, that hurts all blocks alike. Only when a block
+//	has more clipped samples than usual - an impulse that got
+//	clipped, it does not reach the threshold then - the excess
+//	is counted as damaged, clipped samples are not blanked
+#define BLANK_THRESHOLD 6.0F
+#define BLANK_SPREAD 2
+#define BLANK_RATE (1.0F / 16384)
+#define CLIP_MINCOUNT 4
+void sampleReader::blank(std::complex<float> *v, int32_t n) {
+  const float *x = reinterpret_cast<const float *>(v);
+  float threshold = blankLevel > 0 ? BLANK_THRESHOLD * blankLevel : 1e30F;
+  float clipLevel = clipPeak > 0 ? 0.999F * clipPeak : 1e30F;
+  float sums[4] = {0, 0, 0, 0};
+  int32_t peaks[4] = {0, 0, 0, 0};
+  int32_t hitCount[4] = {0, 0, 0, 0};
+  int32_t clipCount[4] = {0, 0, 0, 0};
+  int32_t i;
+
+  damaged = 0;
+  if (n <= 0) return;
+  for (i = 0; i + 4 <= n; i += 4)
+    for (int j = 0; j < 4; j++) {
+      float re = fabsf(x[2 * (i + j)]);
+      float im = fabsf(x[2 * (i + j) + 1]);
+      float a = re + im;
+      float c = re > im ? re : im;
+      int32_t cBits;
+      memcpy(&cBits, &c, sizeof(cBits));
+      hitCount[j] += (int32_t)(a > threshold);
+      clipCount[j] += (int32_t)(c >= clipLevel) & (int32_t)(a <= threshold);
+      sums[j] += a < threshold ? a : threshold;
+      peaks[j] = cBits > peaks[j] ? cBits : peaks[j];
+    }
+  for (; i < n; i++) {
+    float re = fabsf(x[2 * i]);
+    float im = fabsf(x[2 * i + 1]);
+    float a = re + im;
+    float c = re > im ? re : im;
+    int32_t cBits;
+    memcpy(&cBits, &c, sizeof(cBits));
+    hitCount[0] += (int32_t)(a > threshold);
+    clipCount[0] += (int32_t)(c >= clipLevel) & (int32_t)(a <= threshold);
+    sums[0] += a < threshold ? a : threshold;
+    peaks[0] = cBits > peaks[0] ? cBits : peaks[0];
+  }
+  int32_t hits = hitCount[0] + hitCount[1] + hitCount[2] + hitCount[3];
+  int32_t clipped = clipCount[0] + clipCount[1] + clipCount[2] + clipCount[3];
+  float sum = sums[0] + sums[1] + sums[2] + sums[3];
+  int32_t peakBits = peaks[0];
+  for (int j = 1; j < 4; j++)
+    peakBits = peaks[j] > peakBits ? peaks[j] : peakBits;
+  float peak;
+  memcpy(&peak, &peakBits, sizeof(peak));
+
+  //	a sample is tested before it is blanked, blanking "backwards"
+  //	only touches samples that were tested
+  if (hits > 0) {
+    int32_t end = -1;
+    for (int32_t i = 0; i < n; i++) {
+      if (jan_abs(v[i]) > threshold) {
+        int32_t from = i - BLANK_SPREAD > end + 1 ? i - BLANK_SPREAD : end + 1;
+        for (int32_t j = from < 0 ? 0 : from; j < i; j++) {
+          v[j] = 0;
+          damaged++;
+        }
+        end = i + BLANK_SPREAD;
+      }
+      if (i <= end) {
+        v[i] = 0;
+        damaged++;
+      }
+    }
+  }
+  float rate = n * BLANK_RATE < 1 ? n * BLANK_RATE : 1;
+  int32_t excess = clipped - (int32_t)(2 * clipRate * n) - CLIP_MINCOUNT;
+  if (excess > 0) damaged += excess;
+  clipRate += rate * ((float)clipped / n - clipRate);
+  blankLevel = blankLevel > 0 ? blankLevel + rate * (sum / n - blankLevel)
+                              : sum / n;
+  clipPeak = peak > clipPeak ? peak : clipPeak * (1 - rate);
+}
+
+//
+//	skipSamples reads - and ignores - n samples, e.g. the MSC part
+//	of a frame in FIC-only mode. Only the phase of the oscillator
+//	is kept up to date
+void sampleReader::skipSamples(int32_t n, int32_t phaseOffset) {
+  while (n > 0) {
+    int32_t amount = n < (int32_t)skipBuffer.size() ? n : skipBuffer.size();
+    amount = fetch(skipBuffer.data(), amount);
+    n -= amount;
+    currentPhase = (currentPhase - (int64_t)amount * phaseOffset) % INPUT_RATE;
+    if (currentPhase < 0) currentPhase += INPUT_RATE;
+
+    sampleCount += amount;
+    if (sampleCount > INPUT_RATE / N) {
+      theParent->show_Corrector(phaseOffset);
+      sampleCount = 0;
+    }
+  }
+}
+
+//
+//	the clock offset is measured by the dabProcessor, the resampler
+//	is switched on as soon as it makes a difference
+#define CLOCK_MINOFFSET 1.0
+void sampleReader::set_clockOffset(float ppm) {
+  clockOffset = ppm;
+  if (!resampling && (fabs(ppm) >= CLOCK_MINOFFSET)) {
+    resampling = true;
+    resamplePos = 1;
+    inFill = 0;
+  }
+}
+
+//	flush drops the samples the resampler keeps for its next call,
+//	after a retune these are samples of the previous channel.
+//	The clock offset is one of the device, it remains valid
+void sampleReader::flush(void) {
+  resamplePos = 1;
+  inFill = 0;
+  damaged = 0;
+}
+
+//	waitFor waits until the device has n samples, or throws
+void sampleReader::waitFor(int32_t n) {
+  theRig->waitSamples(
+      n, [this] { return !running.load() || interrupted.load(); });
+
+  if (!running.load()) throw READER_STOPPED;
+  if (interrupted.load()) throw READER_INTERRUPTED;
+}
+
+//	fetch delivers n samples, directly from the device, or
+//	through the resampler. The blanker sees the samples as they
+//	come from the device, before mixing and resampling, such that
+//	clipped samples are still recognizable
+int32_t sampleReader::fetch(std::complex<float> *v, int32_t n) {
+  if (resampling) return resample(v, n);
+  waitFor(n);
+  n = theRig->getSamples(v, n);
+  blank(v, n);
+  return n;
+}
+
+//
+//	The cubic (Lagrange) interpolation of n floats, out[i] between
+//	x[i + 2] and x[i + 4] with fraction mu[i]. The floats are the
+//	I and Q values of consecutive samples, so x[i - 2 + ..] are the
+//	neighbours of the same component. All accesses are contiguous,
+//	the loop is vectorized (gcc -O3)
+static void interpolate(const float *x, const float *mu, float *out,
+                        int32_t n) {
+  for (int32_t i = 0; i < n; i++) {
+    float xm1 = x[i];
+    float x0 = x[i + 2];
+    float x1 = x[i + 4];
+    float x2 = x[i + 6];
+    float m = mu[i];
+    float c3 = (x2 - xm1) / 6 + (x0 - x1) / 2;
+    float c2 = (xm1 + x1) / 2 - x0;
+    float c1 = x1 - x0 / 2 - xm1 / 3 - x2 / 6;
+    out[i] = ((c3 * m + c2) * m + c1) * m + x0;
+  }
+}
+
+//
+//	The resampler is a Farrow structure with cubic (Lagrange)
+//	interpolation: output sample j is taken at position
+//	resamplePos + j * step of the input, step being 1 + offset.
+//	The positions are computed first. index[j] - j changes only
+//	once per 1000000 / clockOffset samples, the outputs are
+//	interpolated in runs where it is constant: within a run the
+//	inputs are contiguous, and the interpolation is a single
+//	loop over the floats (with the fraction per float).
+//	inBuffer keeps the samples still needed for the next call,
+//	resamplePos is relative to its start (and at least 1, the
+//	interpolation looks one sample back)
+int32_t sampleReader::resample(std::complex<float> *v, int32_t n) {
+  double step = 1 + clockOffset / 1000000.0;
+  int32_t needed = (int32_t)(resamplePos + (n - 1) * step) + 3;
+
+  if ((int32_t)inBuffer.size() < needed) inBuffer.resize(needed);
+  if ((int32_t)inIndex.size() < n) {
+    inIndex.resize(n);
+    inMu.resize(2 * n);
+  }
+  damaged = 0;
+  if (needed > inFill) {
+    waitFor(needed - inFill);
+    int32_t amount = theRig->getSamples(&inBuffer[inFill], needed - inFill);
+    blank(&inBuffer[inFill], amount);
+    inFill += amount;
+  }
+  if (inFill < needed) {  // should not happen
+    inFill = 0;
+    resamplePos = 1;
+    return 0;
+  }
+
+  int32_t *index = inIndex.data();
+  float *mu = inMu.data();
+  for (int32_t j = 0; j < n; j++) {
+    double p = resamplePos + j * step;
+    index[j] = (int32_t)p;
+    mu[2 * j] = mu[2 * j + 1] = p - index[j];
+  }
+
+  const float *in = reinterpret_cast<const float *>(inBuffer.data());
+  float *out = reinterpret_cast<float *>(v);
+  int32_t j = 0;
+  while (j < n) {
+    int32_t shift = index[j] - j;
+    int32_t end = j + 1;
+    while ((end < n) && (index[end] - end == shift)) end++;
+    interpolate(&in[2 * (j + shift - 1)], &mu[2 * j], &out[2 * j],
+                2 * (end - j));
+    j = end;
+  }
+
+  //	keep what is needed from the next position on
+  double next = resamplePos + n * step;
+  int32_t drop = (int32_t)next - 1;
+  memmove(inBuffer.data(), &inBuffer[drop],
+          (inFill - drop) * sizeof(std::complex<float>));
+  inFill -= drop;
+  resamplePos = next - drop;
+  return n;
+}
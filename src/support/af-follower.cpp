@@ -0,0 +1,336 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#include "af-follower.h"
+#include <unistd.h>
+#include "dab-processor.h"
+#include "ensemble-cache.h"
+#include "fib-decoder.h"
+
+//	the longest frame (Mode I) takes 96 msec
+#define FRAME_MSEC 100
+
+//	the SNR of the dabProcessor is smoothed over frames, after 10
+//	frames what is left of the previous channel is some 3 percent.
+//	Without a signal it still tells some 4 to 7 dB, hence minSnr 8
+static const followParams defaultParams = {60, 8, 1000, 10000, 1000, 10, 3};
+
+static int32_t msecSince(std::chrono::steady_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - t)
+      .count();
+}
+
+afFollower::afFollower(dabProcessor *theRadio, int32_t SId,
+                       const serviceSink *sink, ensembleCache *theCache,
+                       const followParams *params) {
+  this->theRadio = theRadio;
+  this->theCache = theCache;
+  this->params = params != nullptr ? *params : defaultParams;
+  if (sink != nullptr)
+    userSink = *sink;
+  else
+    theRadio->get_defaultSink(&userSink);
+  //	the quality is always needed, the other outputs only
+  //	when the caller wants them
+  ownSink.audioOut_Handler =
+      userSink.audioOut_Handler != nullptr ? audioOut : nullptr;
+  ownSink.dataOut_Handler =
+      userSink.dataOut_Handler != nullptr ? dataOut : nullptr;
+  ownSink.bytesOut_Handler =
+      userSink.bytesOut_Handler != nullptr ? bytesOut : nullptr;
+  ownSink.programQuality_Handler = programQuality;
+  ownSink.motdata_Handler =
+      userSink.motdata_Handler != nullptr ? motdata : nullptr;
+  ownSink.errorReport_Handler =
+      userSink.errorReport_Handler != nullptr ? errorReport : nullptr;
+  ownSink.ctx = this;
+
+  //	the frequency we start on keeps the database of the dabProcessor
+  int32_t frequency = theRadio->get_frequency();
+  channel &c = channels[frequency];
+  c.frequency = frequency;
+  c.database = nullptr;
+  c.haveOffset = false;
+  c.offset = 0;
+  current = &c;
+  currentSId = SId;
+  handle = -1;
+  lastFrames = 0;
+  running.store(false);
+  reportHandler = nullptr;
+  reportCtx = nullptr;
+  quality.store(0);
+  haveQuality.store(false);
+}
+
+//	the dabProcessor may refer to one of the databases, it
+//	should be deleted first
+afFollower::~afFollower(void) {
+  stop();
+  for (auto &c : channels)
+    if (c.second.database != nullptr) delete c.second.database;
+}
+
+//	the frequency tuned to should be known, we have to be able
+//	to return to it
+bool afFollower::start(followReport_t handler, void *ctx) {
+  if (running.load() || (current->frequency == 0)) return false;
+  reportHandler = handler;
+  reportCtx = ctx;
+  running.store(true);
+  threadHandle = std::thread(&afFollower::run, this);
+  return true;
+}
+
+void afFollower::stop(void) {
+  if (!running.load()) return;
+  running.store(false);
+  threadHandle.join();
+}
+
+//
+//	The service is selected as soon as it is known, after that
+//	the reception is watched. Once it is bad for badTime msec, the
+//	candidates are probed, but not more often than once per
+//	probeInterval msec
+void afFollower::run(void) {
+  auto lastProbe = std::chrono::steady_clock::now() -
+                   std::chrono::milliseconds(params.probeInterval);
+  auto badSince = std::chrono::steady_clock::now();
+  bool bad = false;
+
+  lastFrames = theRadio->get_frameCount();
+  lastFrameTime = std::chrono::steady_clock::now();
+  while (running.load()) {
+    usleep(FRAME_MSEC * 1000);
+    if (handle <= 0) select(currentSId, 0);
+    if (!receptionBad()) {
+      bad = false;
+      continue;
+    }
+    if (!bad) {
+      bad = true;
+      badSince = std::chrono::steady_clock::now();
+    }
+    if ((msecSince(badSince) < params.badTime) ||
+        (msecSince(lastProbe) < params.probeInterval))
+      continue;
+    probeAll();
+    lastProbe = std::chrono::steady_clock::now();
+    bad = false;
+  }
+}
+
+bool afFollower::receptionBad(void) {
+  uint32_t frames = theRadio->get_frameCount();
+  if (frames != lastFrames) {
+    lastFrames = frames;
+    lastFrameTime = std::chrono::steady_clock::now();
+  }
+  if (msecSince(lastFrameTime) > params.syncTime) return true;
+  if (theRadio->get_snr() < params.minSnr) return true;
+  return haveQuality.load() && (quality.load() < params.minQuality);
+}
+
+//
+//	The candidates, as told by the FIC of the current ensemble:
+//	the other frequencies of the ensemble, those of other ensembles
+//	carrying the service and those of ensembles carrying a linked
+//	service, in that order. The FIC tells frequencies in KHz
+std::vector<afFollower::candidate> afFollower::candidates(void) {
+  std::vector<candidate> result;
+  bool haveEId;
+  int32_t EId = theRadio->get_EId(&haveEId);
+
+  auto add = [&](int32_t eid, int32_t SId) {
+    for (int32_t kHz : theRadio->frequenciesFor(eid)) {
+      int32_t frequency = kHz * 1000;
+      bool known = frequency == current->frequency;
+      for (auto const &c : result)
+        if (c.frequency == frequency) known = true;
+      if (!known) result.push_back({frequency, SId});
+    }
+  };
+  if (haveEId) add(EId, currentSId);
+  for (int32_t eid : theRadio->ensemblesFor(currentSId)) add(eid, currentSId);
+  for (int32_t linked : theRadio->linkedServices(currentSId))
+    for (int32_t eid : theRadio->ensemblesFor(linked)) add(eid, linked);
+  return result;
+}
+
+//
+//	The first candidate with an SNR better by a margin - or any one
+//	in sync if we lost it here - and with the service selectable is
+//	kept. Otherwise we return, with the offset found before leaving
+void afFollower::probeAll(void) {
+  std::vector<candidate> list = candidates();
+  channel *home = current;
+  int32_t homeSId = currentSId;
+  int16_t homeSnr = theRadio->get_snr();
+  bool homeSynced = msecSince(lastFrameTime) <= params.syncTime;
+
+  if (list.empty()) return;
+  if (homeSynced) {
+    home->haveOffset = true;
+    home->offset = theRadio->get_offset();
+  }
+  for (auto const &c : list) {
+    int16_t snr;
+    if (!running.load()) break;
+    if (!probe(c, &snr)) continue;
+    if (homeSynced && (snr < homeSnr + params.snrMargin)) continue;
+    if (!select(c.SId, params.syncTime)) continue;
+    currentSId = c.SId;
+    if (reportHandler != nullptr)
+      reportHandler(current->frequency, currentSId, snr, reportCtx);
+    return;
+  }
+  visit(home, 1);
+  select(homeSId, params.syncTime);
+}
+
+bool afFollower::probe(const candidate &c, int16_t *snr) {
+  if (!visit(channelFor(c.frequency), params.probeFrames)) return false;
+  *snr = theRadio->get_snr();
+  return true;
+}
+
+//
+//	A visit ends after the number of frames, or - without sync -
+//	after syncTime msec. The service is gone after the switch
+bool afFollower::visit(channel *c, int32_t frames) {
+  int32_t n = 0;
+
+  handle = -1;
+  haveQuality.store(false);
+  theRadio->switch_channel(c->frequency, c->database, c->haveOffset,
+                           c->offset);
+  if (theCache != nullptr) theRadio->set_cache(theCache, c->frequency);
+  current = c;
+  uint32_t firstFrame = theRadio->get_frameCount();
+  auto start = std::chrono::steady_clock::now();
+  while (true) {
+    n = theRadio->get_frameCount() - firstFrame;
+    if (n >= frames) break;
+    int32_t elapsed = msecSince(start);
+    if ((n == 0) && (elapsed > params.syncTime)) break;
+    if (elapsed > params.syncTime + frames * FRAME_MSEC) break;
+    usleep(10000);
+  }
+  if (n > 0) {
+    c->haveOffset = true;
+    c->offset = theRadio->get_offset();
+    lastFrames = theRadio->get_frameCount();
+    lastFrameTime = std::chrono::steady_clock::now();
+  }
+  return n > 0;
+}
+
+//
+//	The service is taken from the database if known there,
+//	otherwise from the cache, otherwise we wait for the FIC
+//	for at most waitMsec msec
+bool afFollower::select(int32_t SId, int32_t waitMsec) {
+  audiodata ad;
+  bool first = true;
+  auto start = std::chrono::steady_clock::now();
+
+  while (true) {
+    theRadio->dataforAudioService(SId, &ad, 0);
+    if (ad.defined) {
+      handle = theRadio->set_audioChannel(&ad, &ownSink);
+      return handle > 0;
+    }
+    if (first && (theCache != nullptr)) {
+      handle = theRadio->preload_audioService(SId, &ownSink);
+      if (handle > 0) return true;
+    }
+    first = false;
+    if (!running.load() || (msecSince(start) >= waitMsec)) return false;
+    usleep(10000);
+  }
+}
+
+afFollower::channel *afFollower::channelFor(int32_t frequency) {
+  auto it = channels.find(frequency);
+  if (it != channels.end()) return &it->second;
+  channel &c = channels[frequency];
+  c.frequency = frequency;
+  c.database = new fib_processor(nullptr, programname, this);
+  c.haveOffset = false;
+  c.offset = 0;
+  return &c;
+}
+
+//	the output of the service goes to the sink of the caller
+void afFollower::audioOut(int16_t *buffer, int size, int rate, bool stereo,
+                          void *ctx) {
+  afFollower *f = (afFollower *)ctx;
+  f->userSink.audioOut_Handler(buffer, size, rate, stereo, f->userSink.ctx);
+}
+
+void afFollower::dataOut(std::string label, void *ctx) {
+  afFollower *f = (afFollower *)ctx;
+  f->userSink.dataOut_Handler(label, f->userSink.ctx);
+}
+
+void afFollower::bytesOut(uint8_t *data, int16_t amount, uint8_t type,
+                          void *ctx) {
+  afFollower *f = (afFollower *)ctx;
+  f->userSink.bytesOut_Handler(data, amount, type, f->userSink.ctx);
+}
+
+//	MP2 passes 0 for rsE and aacE, DAB+ does so until they are
+//	measured; a 0 there does not count
+void afFollower::programQuality(int16_t fe, int16_t rsE, int16_t aacE,
+                                void *ctx) {
+  afFollower *f = (afFollower *)ctx;
+  int16_t q = fe;
+  if ((rsE > 0) && (rsE < q)) q = rsE;
+  if ((aacE > 0) && (aacE < q)) q = aacE;
+  f->quality.store(q);
+  f->haveQuality.store(true);
+  if (f->userSink.programQuality_Handler != nullptr)
+    f->userSink.programQuality_Handler(fe, rsE, aacE, f->userSink.ctx);
+}
+
+void afFollower::motdata(std::string name, int contentType, void *ctx) {
+  afFollower *f = (afFollower *)ctx;
+  f->userSink.motdata_Handler(name, contentType, f->userSink.ctx);
+}
+
+void afFollower::errorReport(int16_t type, int16_t amount, int32_t frames,
+                             void *ctx) {
+  afFollower *f = (afFollower *)ctx;
+  f->userSink.errorReport_Handler(type, amount, frames, f->userSink.ctx);
+}
+
+//	the databases of the other frequencies are only used here
+void afFollower::programname(std::string label, std::string abbr, int32_t SId,
+                             void *ctx) {
+  (void)label;
+  (void)abbr;
+  (void)SId;
+  (void)ctx;
+}
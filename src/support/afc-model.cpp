@@ -0,0 +1,123 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#include "afc-model.h"
+
+//	the offsets reported are averaged over AFC_INTERVAL seconds,
+//	the average is the measurement the tracker works with
+#define AFC_INTERVAL 10.0
+#define AFC_ALPHA 0.3
+#define AFC_BETA 0.02
+//	limits for the drift (ppm per minute) and for the time over
+//	which it is extrapolated (minutes)
+#define AFC_MAXDRIFT 1.0
+#define AFC_MAXMINUTES 10.0
+
+afcModel::afcModel(void) { reset(); }
+
+afcModel::~afcModel(void) {}
+
+void afcModel::reset(void) {
+  std::lock_guard<std::mutex> lock(locker);
+  valid = false;
+  ppm = 0;
+  drift = 0;
+  updates = 0;
+  sum = 0;
+  count = 0;
+  lastUpdate = std::chrono::steady_clock::now();
+}
+
+float afcModel::minutesSince(std::chrono::steady_clock::time_point t) {
+  std::chrono::duration<float> d = std::chrono::steady_clock::now() - t;
+  return d.count() / 60;
+}
+
+//
+//	the offset (in Hz) to expect when tuned to frequency,
+//	0 as long as nothing is known
+float afcModel::predict(int32_t frequency) {
+  std::lock_guard<std::mutex> lock(locker);
+  if (!valid || (frequency <= 0)) return 0;
+  float minutes = minutesSince(lastUpdate);
+  if (minutes > AFC_MAXMINUTES) minutes = AFC_MAXMINUTES;
+  return (ppm + drift * minutes) * (frequency / 1000000.0);
+}
+
+//
+//	update is called - per frame - with the offset (in Hz) that
+//	was found with the receiver locked to frequency.
+//	The first measurement is taken over as is, such that the
+//	next channel profits immediately
+void afcModel::update(int32_t frequency, float offset) {
+  if (frequency <= 0) return;
+  std::lock_guard<std::mutex> lock(locker);
+  sum += offset / (frequency / 1000000.0);
+  count++;
+  if (!valid) {
+    valid = true;
+    ppm = sum / count;
+    drift = 0;
+    updates = 1;
+    sum = 0;
+    count = 0;
+    lastUpdate = std::chrono::steady_clock::now();
+    return;
+  }
+  float minutes = minutesSince(lastUpdate);
+  if (minutes < AFC_INTERVAL / 60) return;
+  float measured = sum / count;
+  sum = 0;
+  count = 0;
+  if (minutes > AFC_MAXMINUTES) minutes = AFC_MAXMINUTES;
+  float predicted = ppm + drift * minutes;
+  float error = measured - predicted;
+  ppm = predicted + AFC_ALPHA * error;
+  drift += AFC_BETA * error / minutes;
+  if (drift > AFC_MAXDRIFT) drift = AFC_MAXDRIFT;
+  if (drift < -AFC_MAXDRIFT) drift = -AFC_MAXDRIFT;
+  updates++;
+  lastUpdate = std::chrono::steady_clock::now();
+}
+
+void afcModel::get_state(afcState *s) {
+  std::lock_guard<std::mutex> lock(locker);
+  s->valid = valid;
+  s->ppm = ppm;
+  s->drift = drift;
+  s->updates = updates;
+}
+
+//
+//	a state that was stored - e.g. by a scanner, or at the end
+//	of an earlier run - is taken over as if it was measured now
+void afcModel::set_state(const afcState *s) {
+  std::lock_guard<std::mutex> lock(locker);
+  valid = s->valid;
+  ppm = s->ppm;
+  drift = s->drift;
+  updates = s->updates;
+  sum = 0;
+  count = 0;
+  lastUpdate = std::chrono::steady_clock::now();
+}
@@ -73,6 +73,13 @@ int32_t bandHandler::Frequency(uint8_t dabBand, std::string Channel) {
   return tunedFrequency;
 }
 
+std::string bandHandler::firstChannel(uint8_t dabBand) {
+  if (dabBand == BAND_III)
+    return bandIII_frequencies[0].key;
+  else
+    return Lband_frequencies[0].key;
+}
+
 std::string bandHandler::nextChannel(uint8_t dabBand, std::string Channel) {
   struct dabFrequencies *finger;
   int i;
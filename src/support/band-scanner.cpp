@@ -0,0 +1,217 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#include "band-scanner.h"
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include "dab-constants.h"
+#include "dab-processor.h"
+#include "device-handler.h"
+
+//	samples after retuning that are skipped, the tuner settles
+#define SETTLE_SAMPLES (INPUT_RATE / 50)
+//	the ensemble is assumed to be complete if no new service
+//	was seen for this many msec
+#define SERVICES_QUIET 1000
+
+bandScanner::bandScanner(deviceHandler *theDevice, uint8_t dabMode)
+    : params(dabMode) {
+  this->theDevice = theDevice;
+  theProcessor = new dabProcessor(
+      theDevice, dabMode, syncsignal, nullptr, ensemblename, programname,
+      nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+      nullptr, this);
+  //	only the FIC is needed here
+  theProcessor->set_ficOnly(true);
+  buffer.resize(SETTLE_SAMPLES + params.get_T_F() + params.get_T_null());
+  noSignal.store(false);
+  ensembleSeen.store(false);
+  ensembleId.store(0);
+}
+
+bandScanner::~bandScanner(void) { delete theProcessor; }
+
+//
+//	scan returns the number of ensembles found. What is learned
+//	of the frequency error is kept over the channels, starting
+//	with - and returned in - afc, if given
+int bandScanner::scan(uint8_t band, int32_t syncTime, int32_t ensembleTime,
+                      afcState *afc, scanResult_t handler, void *ctx) {
+  int found = 0;
+  std::string first = theBand.firstChannel(band);
+  std::string channel = first;
+
+  if ((afc != nullptr) && afc->valid) theProcessor->set_afcState(afc);
+
+  do {
+    scanResult r;
+    memset(&r, 0, sizeof(r));
+    strncpy(r.channel, channel.c_str(), sizeof(r.channel) - 1);
+    r.frequency = theBand.Frequency(band, channel);
+    theDevice->stopReader();
+    theDevice->resetBuffer();
+    if (theDevice->restartReader(r.frequency)) {
+      r.signalPresent = signalPresent(&r.nullDepth);
+      if (r.signalPresent) {
+        theProcessor->set_frequency(r.frequency);
+        collectEnsemble(syncTime, ensembleTime, &r);
+      }
+    }
+    if (r.ensembleFound) found++;
+    if (handler != nullptr) handler(&r, theProcessor, ctx);
+    channel = theBand.nextChannel(band, channel);
+  } while ((channel != first) && (channel != ""));
+
+  theDevice->stopReader();
+  if (afc != nullptr) theProcessor->get_afcState(afc);
+  return found;
+}
+
+//
+//	we read directly from the device, the dabProcessor is not
+//	active during this test
+bool bandScanner::readSamples(int32_t amount) {
+  int32_t got = 0;
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(500 + amount / (INPUT_RATE / 1000));
+
+  while (got < amount) {
+    int32_t avail = theDevice->Samples();
+    if (avail > 0) {
+      if (avail > amount - got) avail = amount - got;
+      got += theDevice->getSamples(&buffer[got], avail);
+      continue;
+    }
+    if (std::chrono::steady_clock::now() > deadline) return false;
+    usleep(1000);
+  }
+  return true;
+}
+
+//
+//	The cheap test: over (a little more than) a frame, the
+//	amplitude is averaged over windows of half a null period,
+//	shifted in steps of a quarter. A DAB signal shows, somewhere,
+//	a window with a level well below the average - the null symbol,
+//	with the same criterion as used by the timeSyncer.
+bool bandScanner::signalPresent(float *nullDepth) {
+  int32_t quarter = params.get_T_null() / 4;
+  std::vector<float> levels;
+  float total = 0;
+  float minWindow;
+
+  *nullDepth = 0;
+  if (!readSamples(buffer.size())) return false;
+  for (int32_t i = SETTLE_SAMPLES; i + quarter <= (int32_t)buffer.size();
+       i += quarter) {
+    float sum = 0;
+    for (int32_t j = 0; j < quarter; j++) sum += jan_abs(buffer[i + j]);
+    levels.push_back(sum);
+    total += sum;
+  }
+  if ((levels.size() < 2) || (total <= 0)) return false;
+
+  float meanWindow = 2 * total / levels.size();
+  minWindow = levels[0] + levels[1];
+  for (uint32_t i = 1; i + 1 < levels.size(); i++)
+    if (levels[i] + levels[i + 1] < minWindow)
+      minWindow = levels[i] + levels[i + 1];
+
+  if (minWindow <= 0) minWindow = 1e-10;
+  *nullDepth = 20 * log10(meanWindow / minWindow);
+  return minWindow < 0.55 * meanWindow;
+}
+
+//
+//	The full treatment, the dabProcessor is started on the channel
+//	and we wait for the ensemble - or give up early when the
+//	dabProcessor tells that there is no sync
+void bandScanner::collectEnsemble(int32_t syncTime, int32_t ensembleTime,
+                                  scanResult *r) {
+  auto start = std::chrono::steady_clock::now();
+  noSignal.store(false);
+  ensembleSeen.store(false);
+  lastNewService = start;
+  theProcessor->start();
+
+  while (!noSignal.load()) {
+    auto now = std::chrono::steady_clock::now();
+    int32_t elapsed =
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - start)
+            .count();
+    if (elapsed > ensembleTime) break;
+    if (!ensembleSeen.load()) {
+      if (elapsed > syncTime) break;
+    } else {
+      std::lock_guard<std::mutex> lock(nameLock);
+      if (std::chrono::duration_cast<std::chrono::milliseconds>(
+              now - lastNewService)
+              .count() > SERVICES_QUIET)
+        break;
+    }
+    usleep(10000);
+  }
+  theProcessor->stop();
+
+  r->ensembleFound = ensembleSeen.load();
+  if (!r->ensembleFound) return;
+  r->EId = ensembleId.load();
+  {
+    std::lock_guard<std::mutex> lock(nameLock);
+    strncpy(r->ensembleName, ensembleName.c_str(),
+            sizeof(r->ensembleName) - 1);
+  }
+  for (int32_t SId : theProcessor->serviceIds()) {
+    if (r->nrServices >= 64) break;
+    r->SId[r->nrServices++] = SId;
+  }
+}
+
+//	Only a "false" means something here: no dip found after
+//	a number of attempts
+void bandScanner::syncsignal(bool b, void *ctx) {
+  bandScanner *scanner = (bandScanner *)ctx;
+  if (!b) scanner->noSignal.store(true);
+}
+
+void bandScanner::ensemblename(std::string label, std::string abbr,
+                               int32_t EId, void *ctx) {
+  bandScanner *scanner = (bandScanner *)ctx;
+  (void)abbr;
+  std::lock_guard<std::mutex> lock(scanner->nameLock);
+  scanner->ensembleName = label;
+  scanner->ensembleId.store(EId);
+  scanner->lastNewService = std::chrono::steady_clock::now();
+  scanner->ensembleSeen.store(true);
+}
+
+void bandScanner::programname(std::string label, std::string abbr,
+                              int32_t SId, void *ctx) {
+  bandScanner *scanner = (bandScanner *)ctx;
+  (void)label;
+  (void)abbr;
+  (void)SId;
+  std::lock_guard<std::mutex> lock(scanner->nameLock);
+  scanner->lastNewService = std::chrono::steady_clock::now();
+}
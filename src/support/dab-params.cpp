@@ -34,6 +34,8 @@ dabParams::dabParams(uint8_t Mode) {
       T_u = 512;     // useful part
       T_g = 126;
       carrierDiff = 4000;
+      ficSymbols = 3;
+      CIFs = 1;
       break;
 
     case 4:
@@ -46,6 +48,8 @@ dabParams::dabParams(uint8_t Mode) {
       T_u = 1024;
       T_g = 252;
       carrierDiff = 2000;
+      ficSymbols = 3;
+      CIFs = 2;
       break;
 
     case 3:
@@ -57,7 +61,9 @@ dabParams::dabParams(uint8_t Mode) {
       T_s = 319;
       T_u = 256;
       T_g = 63;
-      carrierDiff = 2000;
+      carrierDiff = 8000;
+      ficSymbols = 8;  // 4 FIBs in a single codeword
+      CIFs = 1;
       break;
 
     case 1:
@@ -71,6 +77,8 @@ dabParams::dabParams(uint8_t Mode) {
       T_u = 2048;
       T_g = 504;
       carrierDiff = 1000;
+      ficSymbols = 3;
+      CIFs = 4;
       break;
   }
 }
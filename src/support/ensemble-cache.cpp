@@ -0,0 +1,182 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#include "ensemble-cache.h"
+#include <stdio.h>
+#include <string.h>
+
+//	increment when the layout of the file changes
+#define CACHE_VERSION 1
+#define CACHE_STAMP "dab-cmdline-ensemble-cache"
+
+ensembleCache::ensembleCache(const std::string &fileName) {
+  this->fileName = fileName;
+  load();
+}
+
+ensembleCache::~ensembleCache(void) {}
+
+//
+//	The file is small and plain text, one "E" line per ensemble
+//	followed by an "S" line per service
+bool ensembleCache::load(void) {
+  FILE *f = fopen(fileName.c_str(), "r");
+  char line[256];
+  char stamp[64];
+  int version;
+  cachedEnsemble *current = nullptr;
+
+  if (f == nullptr) return false;
+  if ((fgets(line, sizeof(line), f) == nullptr) ||
+      (sscanf(line, "%63s %d", stamp, &version) != 2) ||
+      (strcmp(stamp, CACHE_STAMP) != 0) || (version != CACHE_VERSION)) {
+    fprintf(stderr, "ensemble cache %s ignored (version)\n", fileName.c_str());
+    fclose(f);
+    return false;
+  }
+
+  while (fgets(line, sizeof(line), f) != nullptr) {
+    int frequency, EId;
+    int SId, subchId, startAddr, shortForm, protLevel, length, bitRate;
+    int ASCTy, protIdxOrCase, subChanSize;
+    if (sscanf(line, "E %d %x", &frequency, &EId) == 2) {
+      current = &ensembles[frequency];
+      current->frequency = frequency;
+      current->EId = EId;
+      current->services.clear();
+      continue;
+    }
+    if ((current != nullptr) &&
+        (sscanf(line, "S %x %d %d %d %d %d %d %d %d %d", &SId, &subchId,
+                &startAddr, &shortForm, &protLevel, &length, &bitRate, &ASCTy,
+                &protIdxOrCase, &subChanSize) == 10)) {
+      cachedService s;
+      memset(&s, 0, sizeof(s));
+      s.SId = SId;
+      s.ad.defined = true;
+      s.ad.subchId = subchId;
+      s.ad.startAddr = startAddr;
+      s.ad.shortForm = shortForm != 0;
+      s.ad.protLevel = protLevel;
+      s.ad.length = length;
+      s.ad.bitRate = bitRate;
+      s.ad.ASCTy = ASCTy;
+      s.ad.protIdxOrCase = protIdxOrCase;
+      s.ad.subChanSize = subChanSize;
+      s.ad.language = -1;
+      s.ad.programType = -1;
+      current->services.push_back(s);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+//	called with the locker locked. The file is written under
+//	another name and renamed, a crash does not leave half a file
+bool ensembleCache::save(void) {
+  std::string tmpName = fileName + ".tmp";
+  FILE *f = fopen(tmpName.c_str(), "w");
+
+  if (f == nullptr) return false;
+  fprintf(f, "%s %d\n", CACHE_STAMP, CACHE_VERSION);
+  for (auto const &e : ensembles) {
+    fprintf(f, "E %d %X\n", e.second.frequency, e.second.EId);
+    for (auto const &s : e.second.services)
+      fprintf(f, "S %X %d %d %d %d %d %d %d %d %d\n", s.SId, s.ad.subchId,
+              s.ad.startAddr, s.ad.shortForm ? 1 : 0, s.ad.protLevel,
+              s.ad.length, s.ad.bitRate, s.ad.ASCTy, s.ad.protIdxOrCase,
+              s.ad.subChanSize);
+  }
+  fclose(f);
+  return rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
+
+//
+//	The services are merged with what is known, unless the
+//	ensemble was reconfigured, i.e. the EId is different or a
+//	service is found at another place in the CIF. In that case
+//	the old information is dropped completely
+void ensembleCache::store(int32_t frequency, int32_t EId,
+                          const std::vector<cachedService> &services) {
+  std::lock_guard<std::mutex> lock(locker);
+  auto it = ensembles.find(frequency);
+  if (it != ensembles.end()) {
+    bool reconfigured = it->second.EId != EId;
+    for (auto const &n : services)
+      for (auto const &o : it->second.services)
+        if ((n.SId == o.SId) && !sameSubchannel(&n.ad, &o.ad))
+          reconfigured = true;
+    if (reconfigured) {
+      ensembles.erase(it);
+      it = ensembles.end();
+    }
+  }
+
+  if (it == ensembles.end()) {
+    cachedEnsemble &e = ensembles[frequency];
+    e.frequency = frequency;
+    e.EId = EId;
+    e.services = services;
+  } else {
+    std::vector<cachedService> &known = it->second.services;
+    for (auto const &n : services) {
+      bool found = false;
+      for (auto &o : known)
+        if (o.SId == n.SId) {
+          o = n;
+          found = true;
+        }
+      if (!found) known.push_back(n);
+    }
+  }
+  save();
+}
+
+bool ensembleCache::lookup(int32_t frequency, int32_t SId, audiodata *ad,
+                           int32_t *EId) {
+  std::lock_guard<std::mutex> lock(locker);
+  auto it = ensembles.find(frequency);
+  ad->defined = false;
+  if (it == ensembles.end()) return false;
+  for (auto const &s : it->second.services) {
+    if (s.SId != SId) continue;
+    *ad = s.ad;
+    *EId = it->second.EId;
+    return true;
+  }
+  return false;
+}
+
+void ensembleCache::invalidate(int32_t frequency) {
+  std::lock_guard<std::mutex> lock(locker);
+  if (ensembles.erase(frequency) > 0) save();
+}
+
+//	only the fields that determine the decoding are compared
+bool ensembleCache::sameSubchannel(const audiodata *a, const audiodata *b) {
+  return (a->subchId == b->subchId) && (a->startAddr == b->startAddr) &&
+         (a->length == b->length) && (a->shortForm == b->shortForm) &&
+         (a->protLevel == b->protLevel) && (a->bitRate == b->bitRate) &&
+         (a->ASCTy == b->ASCTy);
+}
@@ -0,0 +1,242 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#include "ensemble-monitor.h"
+#include <string.h>
+#include <unistd.h>
+#include "dab-processor.h"
+#include "device-handler.h"
+#include "fib-decoder.h"
+
+//	the longest frame (Mode I) takes 96 msec
+#define FRAME_MSEC 100
+
+ensembleMonitor::ensembleMonitor(deviceHandler *theDevice, uint8_t dabMode,
+                                 uint8_t band,
+                                 const std::vector<std::string> &names,
+                                 int32_t dwellFrames, int32_t syncTime) {
+  this->theDevice = theDevice;
+  this->dwellFrames = dwellFrames > 0 ? dwellFrames : 1;
+  this->syncTime = syncTime;
+  theProcessor = new dabProcessor(
+      theDevice, dabMode, syncsignal, systemdata, nullptr, programname,
+      nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+      nullptr, this);
+  theProcessor->set_ficOnly(true);
+  //	the TII is collected over (part of) a visit
+  theProcessor->setTII_handler(tiidata, nullptr, this->dwellFrames / 4 + 1,
+                               -1.0F, -1);
+  for (auto const &name : names) {
+    monitoredChannel *c = new monitoredChannel;
+    memset(&c->state, 0, sizeof(c->state));
+    strncpy(c->state.channel, name.c_str(), sizeof(c->state.channel) - 1);
+    c->state.frequency = theBand.Frequency(band, name);
+    c->state.tiiMainId = -1;
+    c->state.tiiSubId = -1;
+    c->parent = this;
+    c->database = new fib_processor(ensemblename, programname, c);
+    c->haveOffset = false;
+    c->everSynced = false;
+    channels.push_back(c);
+  }
+  running.store(false);
+  processorRunning = false;
+  reportHandler = nullptr;
+  reportCtx = nullptr;
+}
+
+//	the dabProcessor may refer to one of the databases, it goes first
+ensembleMonitor::~ensembleMonitor(void) {
+  stop();
+  delete theProcessor;
+  for (auto c : channels) {
+    delete c->database;
+    delete c;
+  }
+}
+
+bool ensembleMonitor::start(monitorReport_t handler, void *ctx) {
+  if (running.load() || channels.empty()) return false;
+  reportHandler = handler;
+  reportCtx = ctx;
+  running.store(true);
+  threadHandle = std::thread(&ensembleMonitor::run, this);
+  return true;
+}
+
+void ensembleMonitor::stop(void) {
+  if (!running.load()) return;
+  running.store(false);
+  threadHandle.join();
+  if (processorRunning) theProcessor->stop();
+  processorRunning = false;
+  theDevice->stopReader();
+}
+
+int32_t ensembleMonitor::channelCount(void) { return channels.size(); }
+
+void ensembleMonitor::run(void) {
+  while (running.load())
+    for (auto c : channels) {
+      if (!running.load()) break;
+      visit(c);
+    }
+}
+
+//
+//	A visit ends after dwellFrames frames, or - without sync - after
+//	syncTime msec or as soon as the dabProcessor gives up
+void ensembleMonitor::visit(monitoredChannel *c) {
+  int32_t frames = 0;
+  monitorState report;
+
+  bool tuned = theProcessor->switch_channel(c->state.frequency, c->database,
+                                           c->haveOffset, c->state.offset);
+  //	the reports of the previous channel may come in until the
+  //	processor is parked, so the state is cleared only now; a
+  //	channel the device could not tune to counts as one without
+  //	signal
+  noSignal.store(!tuned);
+  snr.store(0);
+  tiiMainId.store(-1);
+  tiiSubId.store(-1);
+  if (!processorRunning) {
+    theProcessor->start();
+    processorRunning = true;
+  }
+  uint32_t firstFrame = theProcessor->get_frameCount();
+  auto start = std::chrono::steady_clock::now();
+  while (running.load()) {
+    frames = theProcessor->get_frameCount() - firstFrame;
+    if (frames >= dwellFrames) break;
+    int32_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    if ((frames == 0) && (noSignal.load() || (elapsed > syncTime))) break;
+    if (elapsed > syncTime + dwellFrames * FRAME_MSEC) break;
+    usleep(10000);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(stateLock);
+    monitorState &s = c->state;
+    bool haveEId;
+    s.visits++;
+    if (frames > 0) {
+      s.syncedVisits++;
+      c->everSynced = true;
+      c->lastSync = std::chrono::steady_clock::now();
+      c->haveOffset = true;
+      s.offset = theProcessor->get_offset();
+      s.snr = snr.load();
+      s.tiiMainId = tiiMainId.load();
+      s.tiiSubId = tiiSubId.load();
+    }
+    int32_t EId = c->database->get_EId(&haveEId);
+    if (haveEId) {
+      s.ensembleFound = true;
+      s.EId = EId;
+    }
+    s.generation = c->database->get_generation();
+    s.nrServices = 0;
+    for (int32_t SId : c->database->serviceIds()) {
+      if (s.nrServices >= 64) break;
+      s.SId[s.nrServices++] = SId;
+    }
+    report = s;
+    report.secondsSinceSync =
+        !c->everSynced
+            ? -1
+            : std::chrono::duration_cast<std::chrono::seconds>(
+                  std::chrono::steady_clock::now() - c->lastSync)
+                  .count();
+  }
+  if (reportHandler != nullptr) reportHandler(&report, reportCtx);
+}
+
+bool ensembleMonitor::get_state(int32_t index, monitorState *s) {
+  if ((index < 0) || (index >= (int32_t)channels.size())) return false;
+  monitoredChannel *c = channels[index];
+  std::lock_guard<std::mutex> lock(stateLock);
+  *s = c->state;
+  s->secondsSinceSync =
+      !c->everSynced ? -1
+                     : std::chrono::duration_cast<std::chrono::seconds>(
+                           std::chrono::steady_clock::now() - c->lastSync)
+                           .count();
+  return true;
+}
+
+bool ensembleMonitor::get_serviceName(int32_t index, int32_t SId,
+                                      std::string *name) {
+  if ((index < 0) || (index >= (int32_t)channels.size())) return false;
+  fib_processor *db = channels[index]->database;
+  for (int32_t id : db->serviceIds())
+    if (id == SId) {
+      *name = db->nameFor(SId);
+      return true;
+    }
+  return false;
+}
+
+//	Only a "false" means something here: no dip found after
+//	a number of attempts
+void ensembleMonitor::syncsignal(bool b, void *ctx) {
+  ensembleMonitor *monitor = (ensembleMonitor *)ctx;
+  if (!b) monitor->noSignal.store(true);
+}
+
+void ensembleMonitor::systemdata(bool b, int16_t snr, int32_t offset,
+                                 void *ctx) {
+  ensembleMonitor *monitor = (ensembleMonitor *)ctx;
+  (void)offset;
+  if (b) monitor->snr.store(snr);
+}
+
+void ensembleMonitor::tiidata(int16_t mainId, int16_t subId, unsigned int num,
+                              void *ctx) {
+  ensembleMonitor *monitor = (ensembleMonitor *)ctx;
+  (void)num;
+  monitor->tiiMainId.store(mainId);
+  monitor->tiiSubId.store(subId);
+}
+
+//	the context of the databases is the channel
+void ensembleMonitor::ensemblename(std::string label, std::string abbr,
+                                   int32_t EId, void *ctx) {
+  monitoredChannel *c = (monitoredChannel *)ctx;
+  (void)abbr;
+  std::lock_guard<std::mutex> lock(c->parent->stateLock);
+  strncpy(c->state.ensembleName, label.c_str(),
+          sizeof(c->state.ensembleName) - 1);
+  c->state.EId = EId;
+  c->state.ensembleFound = true;
+}
+
+void ensembleMonitor::programname(std::string label, std::string abbr,
+                                  int32_t SId, void *ctx) {
+  (void)label;
+  (void)abbr;
+  (void)SId;
+  (void)ctx;
+}
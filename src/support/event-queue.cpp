@@ -0,0 +1,278 @@
+#
+/*
+ *    Copyright (C) 2013 .. 2017
+ *    Jan van Katwijk (J.vanKatwijk@gmail.com)
+ *    Lazy Chair Computing
+ *
+ *    This file is part of the DAB library
+ *
+ *    DAB library is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    DAB library is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with DAB library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#
+#include "event-queue.h"
+#include <string.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+//	large enough for a frame of PCM samples (HE-AAC, stereo)
+#define EVENT_BUFSIZE 8192
+
+//
+//	The events and their payload buffers are preallocated, posting
+//	an event is copying the payload into a free buffer and filling
+//	in a slot in the ring. Each event holds at most one buffer, there
+//	are as many buffers as slots.
+//	A full ring - or no free buffer - means that the application
+//	does not keep up, the event is then dropped rather than
+//	blocking the library.
+eventQueue::eventQueue(int poolSize) : ring(poolSize > 0 ? poolSize : 1) {
+  head = 0;
+  count = 0;
+  dropped.store(0);
+  this->poolSize = ring.size();
+  bufferPool = new dabBuffer[this->poolSize];
+  poolData = new uint8_t[this->poolSize * EVENT_BUFSIZE];
+  for (int i = 0; i < this->poolSize; i++) {
+    bufferPool[i].refCount.store(0);
+    bufferPool[i].size = 0;
+    bufferPool[i].capacity = EVENT_BUFSIZE;
+    bufferPool[i].data = &poolData[i * EVENT_BUFSIZE];
+    bufferPool[i].pool = this;
+    freeBuffers.push_back(&bufferPool[i]);
+  }
+#ifdef __linux__
+  fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+  fd = -1;
+#endif
+}
+
+eventQueue::~eventQueue(void) {
+  dabEvent e;
+  while (nextEvent(&e))
+    if (e.buffer != nullptr) releaseBuffer(e.buffer);
+  for (auto s : sources) delete s;
+  delete[] bufferPool;
+  delete[] poolData;
+#ifdef __linux__
+  if (fd >= 0) close(fd);
+#endif
+}
+
+int eventQueue::eventFd(void) { return fd; }
+
+bool eventQueue::nextEvent(dabEvent *e) {
+  std::lock_guard<std::mutex> lock(locker);
+  if (count == 0) return false;
+  *e = ring[head];
+  head = (head + 1) % ring.size();
+  count--;
+  return true;
+}
+
+int eventQueue::droppedEvents(void) { return dropped.exchange(0); }
+
+//
+//	the sources live as long as the queue
+eventSource *eventQueue::newSource(void *tag) {
+  eventSource *s = new eventSource;
+  s->queue = this;
+  s->tag = tag;
+  std::lock_guard<std::mutex> lock(locker);
+  sources.push_back(s);
+  return s;
+}
+
+//
+//	Only a payload that does not fit in a pool buffer is allocated
+//	on the heap. nullptr means that no buffer is free
+dabBuffer *eventQueue::newBuffer(const void *data, int32_t size) {
+  dabBuffer *b = nullptr;
+  if (size > EVENT_BUFSIZE) {
+    b = new dabBuffer;
+    b->capacity = size;
+    b->data = new uint8_t[size];
+    b->pool = nullptr;
+  } else {
+    std::lock_guard<std::mutex> lock(locker);
+    if (freeBuffers.empty()) return nullptr;
+    b = freeBuffers.back();
+    freeBuffers.pop_back();
+  }
+  b->refCount.store(1);
+  b->size = size;
+  if ((data != nullptr) && (size > 0)) memcpy(b->data, data, size);
+  return b;
+}
+
+void eventQueue::recycle(dabBuffer *b) {
+  std::lock_guard<std::mutex> lock(locker);
+  freeBuffers.push_back(b);
+}
+
+void eventQueue::retainBuffer(dabBuffer *b) {
+  if (b != nullptr) b->refCount.fetch_add(1);
+}
+
+void eventQueue::releaseBuffer(dabBuffer *b) {
+  if (b == nullptr) return;
+  if (b->refCount.fetch_sub(1) != 1) return;
+  if (b->pool != nullptr) {
+    b->pool->recycle(b);
+    return;
+  }
+  delete[] b->data;
+  delete b;
+}
+
+void eventQueue::enqueue(eventSource *s, int16_t type, int32_t v0, int32_t v1,
+                         int32_t v2, dabBuffer *b) {
+  {
+    std::lock_guard<std::mutex> lock(locker);
+    if (count < (int32_t)ring.size()) {
+      dabEvent &e = ring[(head + count) % ring.size()];
+      e.type = type;
+      e.tag = s->tag;
+      e.value[0] = v0;
+      e.value[1] = v1;
+      e.value[2] = v2;
+      e.value[3] = 0;
+      e.buffer = b;
+      e.data = b != nullptr ? b->data : nullptr;
+      e.length = b != nullptr ? b->size : 0;
+      count++;
+      b = nullptr;
+    } else
+      dropped.fetch_add(1);
+  }
+  if (b != nullptr) {  // dropped
+    releaseBuffer(b);
+    return;
+  }
+#ifdef __linux__
+  if (fd >= 0) {
+    uint64_t one = 1;
+    ssize_t n = write(fd, &one, sizeof(one));
+    (void)n;
+  }
+#endif
+}
+
+//
+//	The callbacks get an eventSource as context. Some decoders pass
+//	no context at all, nothing is posted then
+void eventQueue::post(void *ctx, int16_t type, int32_t v0, int32_t v1,
+                      int32_t v2) {
+  eventSource *s = (eventSource *)ctx;
+  if (s == nullptr) return;
+  s->queue->enqueue(s, type, v0, v1, v2, nullptr);
+}
+
+void eventQueue::post(void *ctx, int16_t type, int32_t v0, int32_t v1,
+                      int32_t v2, const void *data, int32_t size) {
+  eventSource *s = (eventSource *)ctx;
+  if (s == nullptr) return;
+  dabBuffer *b = s->queue->newBuffer(data, size);
+  if (b == nullptr) {
+    s->queue->dropped.fetch_add(1);
+    return;
+  }
+  s->queue->enqueue(s, type, v0, v1, v2, b);
+}
+
+//	label and abbreviation, both zero terminated
+void eventQueue::postLabel(void *ctx, int16_t type, int32_t id,
+                           const std::string &label, const std::string &abbr) {
+  eventSource *s = (eventSource *)ctx;
+  if (s == nullptr) return;
+  dabBuffer *b = s->queue->newBuffer(nullptr, label.size() + abbr.size() + 2);
+  if (b == nullptr) {
+    s->queue->dropped.fetch_add(1);
+    return;
+  }
+  memcpy(b->data, label.c_str(), label.size() + 1);
+  memcpy(&b->data[label.size() + 1], abbr.c_str(), abbr.size() + 1);
+  s->queue->enqueue(s, type, id, 0, 0, b);
+}
+
+void eventQueue::syncsignal(bool b, void *ctx) {
+  post(ctx, DAB_EVENT_SYNC, b, 0, 0);
+}
+
+void eventQueue::systemdata(bool b, int16_t snr, int32_t offset, void *ctx) {
+  post(ctx, DAB_EVENT_SYSTEMDATA, b, snr, offset);
+}
+
+void eventQueue::fib_quality(int16_t q, void *ctx) {
+  post(ctx, DAB_EVENT_FIB_QUALITY, q, 0, 0);
+}
+
+void eventQueue::ensemblename(std::string label, std::string abbr,
+                              int32_t EId, void *ctx) {
+  postLabel(ctx, DAB_EVENT_ENSEMBLE_NAME, EId, label, abbr);
+}
+
+void eventQueue::programname(std::string label, std::string abbr,
+                             int32_t SId, void *ctx) {
+  postLabel(ctx, DAB_EVENT_PROGRAM_NAME, SId, label, abbr);
+}
+
+//
+//	with a rate of 0, the "size" is the number of bytes of
+//	an encoded (AAC or MP2) frame, otherwise the number of samples
+void eventQueue::audioOut(int16_t *buffer, int size, int rate, bool stereo,
+                          void *ctx) {
+  int32_t bytes = rate == 0 ? size : size * sizeof(int16_t);
+  post(ctx, DAB_EVENT_AUDIO, size, rate, stereo, buffer, bytes);
+}
+
+void eventQueue::dataOut(std::string label, void *ctx) {
+  post(ctx, DAB_EVENT_DYNAMIC_LABEL, 0, 0, 0, label.c_str(),
+       label.size() + 1);
+}
+
+void eventQueue::bytesOut(uint8_t *data, int16_t length, uint8_t type,
+                          void *ctx) {
+  post(ctx, DAB_EVENT_BYTES, length, type, 0, data, length);
+}
+
+void eventQueue::programdata(audiodata *d, void *ctx) {
+  post(ctx, DAB_EVENT_PROGRAM_DATA, 0, 0, 0, d, sizeof(audiodata));
+}
+
+void eventQueue::programQuality(int16_t q1, int16_t q2, int16_t q3,
+                                void *ctx) {
+  post(ctx, DAB_EVENT_PROGRAM_QUALITY, q1, q2, q3);
+}
+
+void eventQueue::motdata(std::string name, int subType, void *ctx) {
+  post(ctx, DAB_EVENT_MOT, subType, 0, 0, name.c_str(), name.size() + 1);
+}
+
+void eventQueue::errorReport(int16_t type, int16_t amount, int32_t total,
+                             void *ctx) {
+  post(ctx, DAB_EVENT_ERROR, type, amount, total);
+}
+
+void eventQueue::fibdata(const uint8_t *fib, int crc_ok, void *ctx) {
+  post(ctx, DAB_EVENT_FIB, crc_ok, 0, 0, fib, 32);
+}
+
+void eventQueue::ensembleChange(uint32_t generation, int16_t kind, int32_t id,
+                                void *ctx) {
+  post(ctx, DAB_EVENT_CHANGE, generation, kind, id);
+}
@@ -121,7 +121,8 @@ void viterbiHandler::computeCostTable(int16_t sym_0, int16_t sym_1,
 
 //      block is the sequence of soft bits
 //      its length = 4 * blockLength + 4 * 6
-void viterbiHandler::deconvolve(int16_t *sym, uint8_t *bitBuffer) {
+//	the result is the metric of the path found
+int viterbiHandler::deconvolve(int16_t *sym, uint8_t *bitBuffer) {
   int prev_0, prev_1;
   int costs_0, costs_1;
   int i;
@@ -208,6 +209,7 @@ void viterbiHandler::deconvolve(int16_t *sym, uint8_t *bitBuffer) {
   for (i = 1; i <= blockLength; i++)
     bitBuffer[i - 1] =
         (uint8_t)((stateSequence[i] >= numofStates / 2) ? 01 : 00);
+  return minimalCosts;
 }
 
 /*